@@ -32,8 +32,19 @@ int orcm_pnp_base_close(void)
         free(orcm_pnp_base.my_string_id);
     }
 
-    OBJ_DESTRUCT(&orcm_pnp_base.recv_process);
-    OBJ_DESTRUCT(&orcm_pnp_base.recv_process_ctl);
+    /* release the recv processing threads */
+    if (NULL != orcm_pnp_base.workers) {
+        for (i=0; i < orcm_pnp_base.num_workers; i++) {
+            OBJ_RELEASE(orcm_pnp_base.workers[i]);
+        }
+        free(orcm_pnp_base.workers);
+        orcm_pnp_base.workers = NULL;
+    }
+
+    /* and the recv executors, dropping whatever they never ran */
+    orcm_pnp_base_stop_executors();
+    OBJ_DESTRUCT(&orcm_pnp_base.req_cond);
+    OBJ_DESTRUCT(&orcm_pnp_base.req_lock);
 
     /* release the array of known channels */
     for (i=0; i < orcm_pnp_base.channels.size; i++) {
@@ -42,6 +53,50 @@ int orcm_pnp_base_close(void)
         }
     }
     OBJ_DESTRUCT(&orcm_pnp_base.channels);
+    OBJ_DESTRUCT(&orcm_pnp_base.index_lock);
+
+    /* the recvs have let go of their executors now */
+    OBJ_DESTRUCT(&orcm_pnp_base.executors);
+    OBJ_DESTRUCT(&orcm_pnp_base.exec_lock);
+
+    /* drop any announcement replies still being held back */
+    orcm_pnp_base_cancel_replies();
+    OBJ_DESTRUCT(&orcm_pnp_base.replies);
+    OBJ_DESTRUCT(&orcm_pnp_base.reply_lock);
+
+    /* and any sends still parked */
+    orcm_pnp_base_release_windows();
+    OBJ_DESTRUCT(&orcm_pnp_base.channel_windows);
+    OBJ_DESTRUCT(&orcm_pnp_base.peer_windows);
+    OBJ_DESTRUCT(&orcm_pnp_base.window_lock);
+
+    /* drop any batched msgs that were never flushed */
+    orcm_pnp_base_release_batches();
+    OBJ_DESTRUCT(&orcm_pnp_base.batches);
+    OBJ_DESTRUCT(&orcm_pnp_base.batch_lock);
+
+    /* drop any partially recvd streams */
+    orcm_pnp_base_release_streams();
+    OBJ_DESTRUCT(&orcm_pnp_base.reassembly);
+    OBJ_DESTRUCT(&orcm_pnp_base.stream_lock);
+
+    if (NULL != orcm_pnp_base.compress_channels) {
+        free(orcm_pnp_base.compress_channels);
+        orcm_pnp_base.compress_channels = NULL;
+    }
+    OBJ_DESTRUCT(&orcm_pnp_base.compress_lock);
+
+    orcm_pnp_base_release_metrics();
+    OBJ_DESTRUCT(&orcm_pnp_base.metrics_table);
+    OBJ_DESTRUCT(&orcm_pnp_base.metrics_lock);
+
+    /* let go of any shared memory */
+    orcm_pnp_base_shm_finalize();
+    OBJ_DESTRUCT(&orcm_pnp_base.shm_peers);
+    OBJ_DESTRUCT(&orcm_pnp_base.shm_lock);
+
+    /* free everything left in the pools */
+    orcm_pnp_base_release_pools();
 
     /* finalize the print buffers */
     orcm_pnp_print_buffer_finalize();
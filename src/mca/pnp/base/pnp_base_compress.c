@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#include <time.h>
+
+#include "opal/dss/dss.h"
+#include "opal/threads/mutex.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "mca/pnp/base/public.h"
+#include "mca/pnp/base/private.h"
+
+/*
+ * Buffer payloads can be sent compressed with a small built-in LZ77
+ * codec - fast enough to keep up with the network and with no external
+ * dependency. The compressed data is a series of sequences, each made
+ * of a token byte, a run of literal bytes and a back-reference:
+ *
+ *   [token][literals][offset (2 bytes, little-endian)]
+ *
+ * The high nibble of the token holds the number of literals and the
+ * low nibble the length of the match less LZ_MIN_MATCH. A nibble of 15
+ * is extended by following bytes that are added on until one is less
+ * than 255 - the literal extension precedes the literals, the match
+ * extension follows the offset. The final sequence has no
+ * back-reference and ends the data.
+ */
+
+#define LZ_MIN_MATCH    4
+#define LZ_MAX_OFFSET   65535
+#define LZ_HASH_BITS    12
+/* matches may not reach into the last few bytes, which keeps the
+ * compressor from reading past the end of its input
+ */
+#define LZ_END_LITERALS 5
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/* write a length that did not fit in its nibble */
+static inline bool put_length(uint8_t **op, uint8_t *oend, size_t len)
+{
+    while (255 <= len) {
+        if (oend <= *op) {
+            return false;
+        }
+        *(*op)++ = 255;
+        len -= 255;
+    }
+    if (oend <= *op) {
+        return false;
+    }
+    *(*op)++ = (uint8_t)len;
+    return true;
+}
+
+static bool put_sequence(uint8_t **op, uint8_t *oend,
+                         const uint8_t *lit, size_t nlit,
+                         size_t offset, size_t mlen)
+{
+    uint8_t *token;
+
+    if (oend <= *op) {
+        return false;
+    }
+    token = (*op)++;
+    *token = (uint8_t)(((15 < nlit) ? 15 : nlit) << 4);
+    if (15 <= nlit && !put_length(op, oend, nlit - 15)) {
+        return false;
+    }
+    if ((size_t)(oend - *op) < nlit) {
+        return false;
+    }
+    memcpy(*op, lit, nlit);
+    *op += nlit;
+    if (0 == offset) {
+        /* final sequence */
+        return true;
+    }
+
+    if (oend - *op < 2) {
+        return false;
+    }
+    *(*op)++ = (uint8_t)(offset & 0xff);
+    *(*op)++ = (uint8_t)(offset >> 8);
+    mlen -= LZ_MIN_MATCH;
+    *token |= (uint8_t)((15 < mlen) ? 15 : mlen);
+    if (15 <= mlen && !put_length(op, oend, mlen - 15)) {
+        return false;
+    }
+    return true;
+}
+
+/* returns the compressed size, or 0 if it would not fit in cap bytes */
+static size_t lz_compress(const uint8_t *src, size_t n, uint8_t *dst, size_t cap)
+{
+    uint32_t table[1 << LZ_HASH_BITS];
+    uint8_t *op=dst, *oend=dst+cap;
+    size_t ip=0, anchor=0, ref, mlen, limit;
+    uint32_t h, v;
+
+    memset(table, 0, sizeof(table));
+    limit = (n < LZ_MIN_MATCH + LZ_END_LITERALS) ? 0 : n - LZ_MIN_MATCH - LZ_END_LITERALS;
+
+    while (ip < limit) {
+        v = read32(src + ip);
+        h = lz_hash(v);
+        /* positions are stored off by one so zero means empty */
+        ref = table[h];
+        table[h] = ip + 1;
+        if (0 == ref) {
+            ip++;
+            continue;
+        }
+        ref--;
+        if (LZ_MAX_OFFSET < ip - ref || v != read32(src + ref)) {
+            ip++;
+            continue;
+        }
+        mlen = LZ_MIN_MATCH;
+        while (ip + mlen < n - LZ_END_LITERALS && src[ref + mlen] == src[ip + mlen]) {
+            mlen++;
+        }
+        if (!put_sequence(&op, oend, src + anchor, ip - anchor, ip - ref, mlen)) {
+            return 0;
+        }
+        ip += mlen;
+        anchor = ip;
+    }
+    if (!put_sequence(&op, oend, src + anchor, n - anchor, 0, 0)) {
+        return 0;
+    }
+    return op - dst;
+}
+
+/* get a length that did not fit in its nibble */
+static inline bool get_length(const uint8_t **ip, const uint8_t *iend, size_t *len)
+{
+    uint8_t b;
+
+    do {
+        if (iend <= *ip) {
+            return false;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (255 == b);
+    return true;
+}
+
+/* the input came off the wire, so trust nothing about it */
+static bool lz_decompress(const uint8_t *src, size_t n, uint8_t *dst, size_t len)
+{
+    const uint8_t *ip=src, *iend=src+n;
+    uint8_t *op=dst, *oend=dst+len, *match;
+    size_t nlit, mlen, offset;
+    uint8_t token;
+
+    while (ip < iend) {
+        token = *ip++;
+        nlit = token >> 4;
+        if (15 == nlit && !get_length(&ip, iend, &nlit)) {
+            return false;
+        }
+        if ((size_t)(iend - ip) < nlit || (size_t)(oend - op) < nlit) {
+            return false;
+        }
+        memcpy(op, ip, nlit);
+        ip += nlit;
+        op += nlit;
+        if (ip == iend) {
+            /* final sequence */
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (0 == offset || (size_t)(op - dst) < offset) {
+            return false;
+        }
+        mlen = token & 15;
+        if (15 == mlen && !get_length(&ip, iend, &mlen)) {
+            return false;
+        }
+        mlen += LZ_MIN_MATCH;
+        if ((size_t)(oend - op) < mlen) {
+            return false;
+        }
+        /* the match may overlap what it is producing */
+        match = op - offset;
+        while (0 < mlen--) {
+            *op++ = *match++;
+        }
+    }
+    return (op == oend);
+}
+
+/* cpu time used by this thread, in usecs */
+static int64_t cpu_usecs(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if (0 == clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)) {
+        return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+#endif
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+}
+
+bool orcm_pnp_base_want_compress(orcm_pnp_channel_t channel,
+                                 orcm_pnp_tag_t tag, size_t len)
+{
+    int i;
+
+    /* announcements must stay readable by everyone */
+    if (0 == orcm_pnp_base.compress_threshold ||
+        len < (size_t)orcm_pnp_base.compress_threshold ||
+        ORCM_PNP_TAG_ANNOUNCE == tag) {
+        return false;
+    }
+    if (0 == orcm_pnp_base.num_compress_channels) {
+        return true;
+    }
+    for (i=0; i < orcm_pnp_base.num_compress_channels; i++) {
+        if (channel == orcm_pnp_base.compress_channels[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int orcm_pnp_base_compress_payload(opal_buffer_t *hdr, orcm_pnp_tag_t tag,
+                                   opal_buffer_t *buffer)
+{
+    uint8_t *src, *dst;
+    size_t n, cap, clen;
+    int32_t sz;
+    int64_t start;
+    int ret;
+
+    src = (uint8_t*)buffer->unpack_ptr;
+    n = buffer->bytes_used - (buffer->unpack_ptr - buffer->base_ptr);
+    /* only worth it if we save at least 1/16th */
+    cap = n - (n >> 4);
+    if (NULL == (dst = (uint8_t*)malloc(cap))) {
+        return ORCM_ERR_OUT_OF_RESOURCE;
+    }
+
+    start = cpu_usecs();
+    clen = lz_compress(src, n, dst, cap);
+    start = cpu_usecs() - start;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.compress_lock);
+    orcm_pnp_base.compress_stats.compress_usecs += start;
+    if (0 == clen) {
+        orcm_pnp_base.compress_stats.msgs_skipped++;
+    } else {
+        orcm_pnp_base.compress_stats.msgs_compressed++;
+        orcm_pnp_base.compress_stats.bytes_in += n;
+        orcm_pnp_base.compress_stats.bytes_out += clen;
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.compress_lock);
+
+    if (0 == clen) {
+        free(dst);
+        return ORCM_ERR_NOT_AVAILABLE;
+    }
+
+    if (ORCM_SUCCESS != (ret = orcm_pnp_base_pack_header(hdr, tag, ORCM_PNP_MSG_COMPRESSED))) {
+        goto cleanup;
+    }
+    sz = n;
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(hdr, &sz, 1, OPAL_INT32))) {
+        goto cleanup;
+    }
+    sz = clen;
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(hdr, &sz, 1, OPAL_INT32))) {
+        goto cleanup;
+    }
+    ret = orcm_pnp_base_append_raw(hdr, dst, clen);
+
+ cleanup:
+    if (ORCM_SUCCESS != ret) {
+        ORTE_ERROR_LOG(ret);
+    }
+    free(dst);
+    return ret;
+}
+
+int orcm_pnp_base_decompress_payload(opal_buffer_t *buf, opal_buffer_t **msg)
+{
+    int32_t len, clen;
+    size_t avail;
+    opal_buffer_t *out;
+    int64_t start;
+    bool ok;
+    int n, ret;
+
+    *msg = NULL;
+    n=1;
+    if (ORCM_SUCCESS != (ret = opal_dss.unpack(buf, &len, &n, OPAL_INT32))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    n=1;
+    if (ORCM_SUCCESS != (ret = opal_dss.unpack(buf, &clen, &n, OPAL_INT32))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    avail = buf->bytes_used - (buf->unpack_ptr - buf->base_ptr);
+    if (len < 0 || clen < 0 || avail < (size_t)clen) {
+        ORTE_ERROR_LOG(ORCM_ERR_UNPACK_READ_PAST_END_OF_BUFFER);
+        return ORCM_ERR_UNPACK_READ_PAST_END_OF_BUFFER;
+    }
+
+    out = OBJ_NEW(opal_buffer_t);
+    if (0 < len) {
+        if (NULL == (out->base_ptr = (char*)malloc(len))) {
+            OBJ_RELEASE(out);
+            return ORCM_ERR_OUT_OF_RESOURCE;
+        }
+        out->bytes_allocated = len;
+        out->unpack_ptr = out->base_ptr;
+    }
+
+    start = cpu_usecs();
+    ok = lz_decompress((uint8_t*)buf->unpack_ptr, clen, (uint8_t*)out->base_ptr, len);
+    start = cpu_usecs() - start;
+    buf->unpack_ptr += clen;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.compress_lock);
+    orcm_pnp_base.compress_stats.decompress_usecs += start;
+    if (ok) {
+        orcm_pnp_base.compress_stats.msgs_decompressed++;
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.compress_lock);
+
+    if (!ok) {
+        ORTE_ERROR_LOG(ORCM_ERR_UNPACK_FAILURE);
+        OBJ_RELEASE(out);
+        return ORCM_ERR_UNPACK_FAILURE;
+    }
+    out->bytes_used = len;
+    out->pack_ptr = out->base_ptr + len;
+    *msg = out;
+    return ORCM_SUCCESS;
+}
+
+void orcm_pnp_get_compress_stats(orcm_pnp_compress_stats_t *stats)
+{
+    OPAL_THREAD_LOCK(&orcm_pnp_base.compress_lock);
+    *stats = orcm_pnp_base.compress_stats;
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.compress_lock);
+}
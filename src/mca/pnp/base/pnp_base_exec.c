@@ -0,0 +1,558 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <limits.h>
+
+#include "opal/sys/atomic.h"
+#include "opal/threads/mutex.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+#include "orte/threads/threads.h"
+
+#include "mca/pnp/base/public.h"
+#include "mca/pnp/base/private.h"
+
+/*
+ * A recv whose callback may block is handed its msgs through an
+ * executor instead of having the callback run on a recv processing
+ * thread. The msg is copied into a job that owns its payload, and the
+ * job is queued on one of the executor's threads - chosen by sender,
+ * so a sender's msgs still reach the callback in the order they came.
+ * When a thread's queue is full, jobs are parked on its lane rather
+ * than holding up the recv processing thread, and the executor thread
+ * takes them once it has emptied its queue.
+ */
+
+typedef struct exec_job_t {
+    struct exec_job_t *next;
+    orcm_pnp_callback_fn_t cbfunc;
+    void *cbdata;
+    orte_process_name_t sender;
+    orcm_pnp_channel_t channel;
+    orcm_pnp_tag_t tag;
+    uint64_t queued;
+    /* holds the payload - handed to the callback itself unless
+     * the msg was sent as iovecs, which then point into it
+     */
+    opal_buffer_t *data;
+    bool is_buffer;
+    struct iovec *iovecs;
+    int count;
+} exec_job_t;
+
+typedef struct orcm_pnp_exec_lane_t {
+    orcm_pnp_executor_t *executor;
+    orcm_pnp_worker_t *worker;
+    opal_mutex_t lock;
+    exec_job_t *parked;
+    exec_job_t *parked_tail;
+} exec_lane_t;
+
+/* queued to wake an idle thread when a job is parked */
+static exec_job_t parked_marker;
+
+static void* exec_thread(opal_object_t *obj);
+
+static void release_job(exec_job_t *job)
+{
+    if (NULL != job->data) {
+        orcm_pnp_base_return_buffer(job->data);
+    }
+    if (NULL != job->iovecs) {
+        free(job->iovecs);
+    }
+    free(job);
+}
+
+static void run_job(exec_job_t *job)
+{
+    uint64_t start;
+
+    start = orcm_pnp_base_metrics_now();
+    if (job->is_buffer) {
+        job->cbfunc(ORCM_SUCCESS, &job->sender, job->tag,
+                    NULL, 0, job->data, job->cbdata);
+    } else {
+        job->cbfunc(ORCM_SUCCESS, &job->sender, job->tag,
+                    job->iovecs, job->count, NULL, job->cbdata);
+    }
+    orcm_pnp_base_metrics_callback(job->channel, job->tag, job->queued, start,
+                                   orcm_pnp_base_metrics_now());
+    release_job(job);
+}
+
+static orcm_pnp_executor_t* new_executor(int num_threads)
+{
+    orcm_pnp_executor_t *executor;
+    orcm_pnp_worker_t *worker;
+    exec_lane_t *lanes;
+    int i, rc;
+
+    executor = OBJ_NEW(orcm_pnp_executor_t);
+    executor->workers = (orcm_pnp_worker_t**)calloc(num_threads, sizeof(orcm_pnp_worker_t*));
+    lanes = (exec_lane_t*)calloc(num_threads, sizeof(exec_lane_t));
+    executor->lanes = lanes;
+    if (NULL == executor->workers || NULL == lanes) {
+        OBJ_RELEASE(executor);
+        return NULL;
+    }
+    for (i=0; i < num_threads; i++) {
+        worker = OBJ_NEW(orcm_pnp_worker_t);
+        worker->idx = i;
+        worker->queue = OBJ_NEW(orcm_pnp_queue_t);
+        if (ORCM_SUCCESS != (rc = orcm_pnp_queue_init(worker->queue,
+                                                      orcm_pnp_base.exec_queue_size))) {
+            ORTE_ERROR_LOG(rc);
+            OBJ_RELEASE(worker);
+            break;
+        }
+        OBJ_CONSTRUCT(&lanes[i].lock, opal_mutex_t);
+        lanes[i].executor = executor;
+        lanes[i].worker = worker;
+        worker->thread.t_run = exec_thread;
+        worker->thread.t_arg = &lanes[i];
+        worker->ctl.running = true;
+        /* the thread lets go of this when it exits */
+        OBJ_RETAIN(executor);
+        if (ORTE_SUCCESS != (rc = opal_thread_start(&worker->thread))) {
+            ORTE_ERROR_LOG(rc);
+            OBJ_RELEASE(executor);
+            OBJ_DESTRUCT(&lanes[i].lock);
+            OBJ_RELEASE(worker);
+            break;
+        }
+        executor->workers[executor->num_workers++] = worker;
+    }
+    if (0 == executor->num_workers) {
+        OBJ_RELEASE(executor);
+        return NULL;
+    }
+
+    /* keep track of it so its threads can be stopped at close */
+    executor->idx = opal_pointer_array_add(&orcm_pnp_base.executors, executor);
+    return executor;
+}
+
+/* take an executor off the list so nothing more is handed to it -
+ * must be called with the exec lock held. Returns false if it
+ * was already retired
+ */
+static bool retire_executor(orcm_pnp_executor_t *executor)
+{
+    if (executor->stopped) {
+        return false;
+    }
+    executor->stopped = true;
+    opal_atomic_wmb();
+    if (0 <= executor->idx) {
+        opal_pointer_array_set_item(&orcm_pnp_base.executors, executor->idx, NULL);
+        executor->idx = -1;
+    }
+    return true;
+}
+
+/* stop the threads of a retired executor. This is done without the
+ * exec lock so a callback still finishing up can cancel recvs of its
+ * own, and a thread stopping its own executor, as when a callback
+ * cancels its recv, just tells itself to exit once the callback is done
+ */
+static void stop_executor(orcm_pnp_executor_t *executor)
+{
+    orcm_pnp_worker_t *worker;
+    int j;
+
+    for (j=0; j < executor->num_workers; j++) {
+        worker = executor->workers[j];
+        if (opal_thread_self_compare(&worker->thread)) {
+            /* it sees the executor is stopped once the callback returns */
+            continue;
+        }
+        ORTE_ACQUIRE_THREAD(&worker->ctl);
+        if (worker->ctl.running) {
+            ORTE_RELEASE_THREAD(&worker->ctl);
+            if (orte_abnormal_term_ordered) {
+                opal_thread_kill(&worker->thread, SIGTERM);
+                worker->ctl.running = false;
+            } else {
+                /* wake it if idle - if the queue is full, it is busy
+                 * and sees the executor is stopped after its next job
+                 */
+                orcm_pnp_queue_push(worker->queue, NULL, false);
+                opal_thread_join(&worker->thread, NULL);
+            }
+            ORTE_ACQUIRE_THREAD(&worker->ctl);
+        }
+        ORTE_RELEASE_THREAD(&worker->ctl);
+    }
+}
+
+orcm_pnp_executor_t* orcm_pnp_base_get_executor(orcm_pnp_exec_t kind)
+{
+    orcm_pnp_executor_t *executor=NULL;
+
+    if (ORCM_PNP_EXEC_SERIAL != kind && ORCM_PNP_EXEC_POOL != kind) {
+        return NULL;
+    }
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.exec_lock);
+    if (ORCM_PNP_EXEC_SERIAL == kind) {
+        executor = new_executor(1);
+    } else {
+        if (NULL == orcm_pnp_base.exec_pool &&
+            NULL != (orcm_pnp_base.exec_pool = new_executor(orcm_pnp_base.exec_pool_threads))) {
+            orcm_pnp_base.exec_pool->shared = true;
+        }
+        if (NULL != (executor = orcm_pnp_base.exec_pool)) {
+            OBJ_RETAIN(executor);
+        }
+    }
+    if (NULL != executor) {
+        executor->users++;
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.exec_lock);
+
+    if (NULL == executor) {
+        opal_output(0, "%s Cannot start a recv executor - callbacks will run inline",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME));
+    }
+    return executor;
+}
+
+void orcm_pnp_base_release_executor(orcm_pnp_executor_t *executor)
+{
+    bool stop=false;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.exec_lock);
+    if (0 == --executor->users && !executor->shared) {
+        /* nobody can hand it any more work */
+        stop = retire_executor(executor);
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.exec_lock);
+    if (stop) {
+        stop_executor(executor);
+    }
+    OBJ_RELEASE(executor);
+}
+
+void orcm_pnp_base_set_executor(orcm_pnp_request_t *req,
+                                orcm_pnp_executor_t *executor)
+{
+    if (req->executor == executor) {
+        return;
+    }
+    if (NULL != executor) {
+        OPAL_THREAD_LOCK(&orcm_pnp_base.exec_lock);
+        executor->users++;
+        OPAL_THREAD_UNLOCK(&orcm_pnp_base.exec_lock);
+        OBJ_RETAIN(executor);
+    }
+    if (NULL != req->executor) {
+        orcm_pnp_base_release_executor(req->executor);
+    }
+    req->executor = executor;
+}
+
+/* copies the payload from the current read position - the caller
+ * rewinds the buffer to the start of the payload for each recv
+ */
+int orcm_pnp_base_exec_submit(orcm_pnp_request_t *req, orcm_pnp_msg_t *msg,
+                              orcm_pnp_tag_t tag,
+                              struct iovec *iovecs, int count,
+                              opal_buffer_t *buf)
+{
+    orcm_pnp_executor_t *executor = req->executor;
+    orcm_pnp_worker_t *worker;
+    exec_lane_t *lane;
+    exec_job_t *job;
+    size_t total;
+    uint32_t hash;
+    uint8_t *ptr;
+    bool wake;
+    int i, rc;
+
+    if (NULL == (job = (exec_job_t*)calloc(1, sizeof(exec_job_t)))) {
+        ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+        return ORCM_ERR_OUT_OF_RESOURCE;
+    }
+    job->cbfunc = req->cbfunc;
+    job->cbdata = req->cbdata;
+    job->sender = msg->sender;
+    job->channel = msg->channel;
+    job->tag = tag;
+    job->queued = msg->queued;
+
+    /* the msg is only ours until delivery is done, so take a copy */
+    if (NULL != buf) {
+        total = buf->bytes_used - (buf->unpack_ptr - buf->base_ptr);
+        job->data = orcm_pnp_base_get_buffer(total);
+        job->is_buffer = true;
+        if (ORCM_SUCCESS != (rc = orcm_pnp_base_append_raw(job->data, buf->unpack_ptr, total))) {
+            release_job(job);
+            return rc;
+        }
+    } else if (0 < count) {
+        for (i=0, total=0; i < count; i++) {
+            total += iovecs[i].iov_len;
+        }
+        job->data = orcm_pnp_base_get_buffer(total);
+        job->iovecs = (struct iovec*)malloc(count * sizeof(struct iovec));
+        if (NULL == job->iovecs) {
+            release_job(job);
+            return ORCM_ERR_OUT_OF_RESOURCE;
+        }
+        for (i=0; i < count; i++) {
+            if (ORCM_SUCCESS != (rc = orcm_pnp_base_append_raw(job->data, iovecs[i].iov_base,
+                                                               iovecs[i].iov_len))) {
+                release_job(job);
+                return rc;
+            }
+        }
+        /* only point the iovecs at the copy once it has stopped growing */
+        ptr = (uint8_t*)job->data->base_ptr;
+        for (i=0; i < count; i++) {
+            job->iovecs[i].iov_len = iovecs[i].iov_len;
+            job->iovecs[i].iov_base = (0 < iovecs[i].iov_len) ? ptr : NULL;
+            ptr += iovecs[i].iov_len;
+        }
+        job->count = count;
+    }
+
+    if (1 == executor->num_workers) {
+        i = 0;
+    } else {
+        hash = (uint32_t)msg->sender.jobid * 2654435761U;
+        hash ^= (uint32_t)msg->sender.vpid + 0x9e3779b9U + (hash << 6) + (hash >> 2);
+        i = hash % executor->num_workers;
+    }
+    worker = executor->workers[i];
+    lane = &executor->lanes[i];
+
+    if (ORCM_PNP_EXEC_DROP == orcm_pnp_base.exec_policy) {
+        if (ORCM_SUCCESS != orcm_pnp_queue_push(worker->queue, job, false)) {
+            /* no room - the slow consumer loses the msg, not everyone else */
+            OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                                 "%s pnp:base:exec queue full - dropping msg from %s tag %s",
+                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                                 ORTE_NAME_PRINT(&msg->sender), orcm_pnp_print_tag(tag)));
+            orcm_pnp_base_metrics_drop(msg->channel, tag, ORCM_PNP_DROP_OVERFLOW);
+            release_job(job);
+            return ORCM_ERR_WOULD_BLOCK;
+        }
+        return ORCM_SUCCESS;
+    }
+
+    /* nothing may jump ahead of jobs that are already parked */
+    OPAL_THREAD_LOCK(&lane->lock);
+    if (NULL == lane->parked &&
+        ORCM_SUCCESS == orcm_pnp_queue_push(worker->queue, job, false)) {
+        OPAL_THREAD_UNLOCK(&lane->lock);
+        return ORCM_SUCCESS;
+    }
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:base:exec queue full - parking msg from %s tag %s",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                         ORTE_NAME_PRINT(&msg->sender), orcm_pnp_print_tag(tag)));
+    wake = (NULL == lane->parked);
+    if (wake) {
+        lane->parked = job;
+    } else {
+        lane->parked_tail->next = job;
+    }
+    lane->parked_tail = job;
+    OPAL_THREAD_UNLOCK(&lane->lock);
+
+    if (wake) {
+        /* the thread may have gone idle since the push failed - if
+         * there is no room for this either, it is still busy and
+         * looks at the lane before it next sleeps
+         */
+        orcm_pnp_queue_push(worker->queue, &parked_marker, false);
+    }
+    return ORCM_SUCCESS;
+}
+
+void orcm_pnp_base_exec_depth(int32_t *depth, int32_t *max_depth)
+{
+    orcm_pnp_executor_t *executor;
+    orcm_pnp_worker_t *worker;
+    int i, j;
+
+    *depth = 0;
+    *max_depth = 0;
+    OPAL_THREAD_LOCK(&orcm_pnp_base.exec_lock);
+    for (i=0; i < orcm_pnp_base.executors.size; i++) {
+        if (NULL == (executor = (orcm_pnp_executor_t*)opal_pointer_array_get_item(&orcm_pnp_base.executors, i))) {
+            continue;
+        }
+        for (j=0; j < executor->num_workers; j++) {
+            worker = executor->workers[j];
+            *depth += orcm_pnp_queue_depth(worker->queue);
+            if (*max_depth < worker->queue->max_depth) {
+                *max_depth = worker->queue->max_depth;
+            }
+        }
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.exec_lock);
+}
+
+/* stop every executor still running - any recvs that still hold
+ * one just let go of it when they are released
+ */
+void orcm_pnp_base_stop_executors(void)
+{
+    orcm_pnp_executor_t *executor, *pool;
+    opal_pointer_array_t running;
+    int i;
+
+    OBJ_CONSTRUCT(&running, opal_pointer_array_t);
+    opal_pointer_array_init(&running, 8, INT_MAX, 8);
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.exec_lock);
+    for (i=0; i < orcm_pnp_base.executors.size; i++) {
+        if (NULL != (executor = (orcm_pnp_executor_t*)opal_pointer_array_get_item(&orcm_pnp_base.executors, i))) {
+            OBJ_RETAIN(executor);
+            retire_executor(executor);
+            opal_pointer_array_add(&running, executor);
+        }
+    }
+    pool = orcm_pnp_base.exec_pool;
+    orcm_pnp_base.exec_pool = NULL;
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.exec_lock);
+
+    for (i=0; i < running.size; i++) {
+        if (NULL != (executor = (orcm_pnp_executor_t*)opal_pointer_array_get_item(&running, i))) {
+            stop_executor(executor);
+            OBJ_RELEASE(executor);
+        }
+    }
+    OBJ_DESTRUCT(&running);
+    if (NULL != pool) {
+        OBJ_RELEASE(pool);
+    }
+}
+
+/* drop whatever an executor never ran - its threads are gone */
+void orcm_pnp_base_exec_release_lanes(orcm_pnp_executor_t *executor)
+{
+    exec_lane_t *lanes = executor->lanes;
+    exec_job_t *jobs[ORCM_PNP_MAX_MSGS], *job;
+    int i, k, n;
+
+    if (NULL == lanes) {
+        return;
+    }
+    for (i=0; i < executor->num_workers; i++) {
+        while (0 < (n = orcm_pnp_queue_pop(executor->workers[i]->queue,
+                                           (void**)jobs, ORCM_PNP_MAX_MSGS))) {
+            for (k=0; k < n; k++) {
+                if (NULL != jobs[k] && &parked_marker != jobs[k]) {
+                    release_job(jobs[k]);
+                }
+            }
+        }
+        while (NULL != (job = lanes[i].parked)) {
+            lanes[i].parked = job->next;
+            release_job(job);
+        }
+    }
+    for (i=0; i < executor->num_workers; i++) {
+        OBJ_DESTRUCT(&lanes[i].lock);
+    }
+    free(lanes);
+    executor->lanes = NULL;
+}
+
+/* run the jobs parked on a lane - returns false if there were none */
+static bool run_parked(exec_lane_t *lane)
+{
+    exec_job_t *job, *next;
+
+    OPAL_THREAD_LOCK(&lane->lock);
+    job = lane->parked;
+    lane->parked = NULL;
+    lane->parked_tail = NULL;
+    OPAL_THREAD_UNLOCK(&lane->lock);
+
+    if (NULL == job) {
+        return false;
+    }
+    for (; NULL != job; job = next) {
+        next = job->next;
+        run_job(job);
+    }
+    return true;
+}
+
+static void* exec_thread(opal_object_t *obj)
+{
+    exec_lane_t *lane = (exec_lane_t*)((opal_thread_t*)obj)->t_arg;
+    orcm_pnp_executor_t *executor = lane->executor;
+    orcm_pnp_worker_t *worker = lane->worker;
+    exec_job_t *jobs[ORCM_PNP_MAX_MSGS];
+    int i, n;
+
+    OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
+                         "%s pnp:base: recv executor thread %d operational",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), worker->idx));
+
+    while (1) {
+        opal_atomic_rmb();
+        if (executor->stopped) {
+            break;
+        }
+        if (0 == (n = orcm_pnp_queue_pop(worker->queue, (void**)jobs, ORCM_PNP_MAX_MSGS))) {
+            /* the queue is empty, so anything parked is next */
+            if (run_parked(lane)) {
+                continue;
+            }
+            /* nothing there - block here until a trigger arrives */
+            if (ORCM_SUCCESS != orcm_pnp_queue_wait(worker->queue)) {
+                opal_output(0, "%s PUNTING EXECUTOR THREAD", ORTE_NAME_PRINT(ORTE_PROC_MY_NAME));
+                break;
+            }
+            continue;
+        }
+        for (i=0; i < n; i++) {
+            opal_atomic_rmb();
+            if (NULL == jobs[i] || executor->stopped) {
+                /* told to stop - nobody wants the rest, and whatever
+                 * is still queued or parked goes with the executor
+                 */
+                for (; i < n; i++) {
+                    if (NULL != jobs[i] && &parked_marker != jobs[i]) {
+                        release_job(jobs[i]);
+                    }
+                }
+                goto done;
+            }
+            if (&parked_marker == jobs[i]) {
+                /* parked jobs run once the queue is empty */
+                continue;
+            }
+            run_job(jobs[i]);
+        }
+    }
+
+ done:
+    ORTE_ACQUIRE_THREAD(&worker->ctl);
+    worker->ctl.running = false;
+    ORTE_RELEASE_THREAD(&worker->ctl);
+    /* may be the last reference if a callback cancelled its own recv */
+    OBJ_RELEASE(executor);
+    return OPAL_THREAD_CANCELLED;
+}
@@ -23,6 +23,9 @@
 #include <unistd.h>
 #endif
 #include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "opal/dss/dss.h"
 #include "opal/class/opal_list.h"
@@ -35,6 +38,7 @@
 #include "orte/mca/errmgr/errmgr.h"
 #include "orte/mca/rml/rml.h"
 #include "orte/mca/routed/routed.h"
+#include "orte/util/name_fns.h"
 #include "orte/runtime/orte_globals.h"
 #include "orte/threads/threads.h"
 
@@ -57,89 +61,169 @@ static void cbfunc(int status,
     OBJ_RELEASE(buffer);
 }
 
-void orcm_pnp_base_process_announcements(orte_process_name_t *sender,
-                                         opal_buffer_t *buf)
-{
-    opal_list_item_t *itm2;
-    orcm_triplet_t *triplet;
-    orcm_triplet_group_t *grp;
-    orcm_source_t *source;
-    char *app=NULL, *version=NULL, *release=NULL, *string_id=NULL, *nodename=NULL;
-    orte_process_name_t originator;
-    opal_buffer_t *ann;
-    int rc, n, i, j;
-    orte_rmcast_channel_t input, output;
-    orcm_pnp_send_t *pkt;
-    orcm_pnp_channel_t chan;
-    orte_job_t *daemons;
-    orte_proc_t *proc;
+/* what one process tells others about itself */
+typedef struct {
+    orte_process_name_t name;
+    char *string_id;
+    orcm_triplet_handle_t handle;
+    orte_rmcast_channel_t input;
+    orte_rmcast_channel_t output;
+    char *nodename;
     uint32_t uid;
-    bool known=true;
-    char *rml_uri=NULL;
+    char *rml_uri;
     pid_t pid;
-    orcm_info_t info;
     int32_t incarnation;
+} announcement_t;
+
+static void clear_announcement(announcement_t *ann)
+{
+    if (NULL != ann->string_id) {
+        free(ann->string_id);
+        ann->string_id = NULL;
+    }
+    if (NULL != ann->nodename) {
+        free(ann->nodename);
+        ann->nodename = NULL;
+    }
+    if (NULL != ann->rml_uri) {
+        free(ann->rml_uri);
+        ann->rml_uri = NULL;
+    }
+}
+
+static int pack_entry(opal_buffer_t *buf, announcement_t *ann)
+{
+    int ret;
+
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &ann->string_id, 1, OPAL_STRING))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    /* pack the handle its msgs will carry */
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &ann->handle, 1, ORCM_TRIPLET_HANDLE_T))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &ann->input, 1, ORTE_RMCAST_CHANNEL_T))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &ann->output, 1, ORTE_RMCAST_CHANNEL_T))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &ann->nodename, 1, OPAL_STRING))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &ann->uid, 1, OPAL_UINT32))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &ann->rml_uri, 1, OPAL_STRING))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    /* pid is useful for debugging */
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &ann->pid, 1, OPAL_PID))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &ann->incarnation, 1, OPAL_INT32))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    return ORCM_SUCCESS;
+}
+
+static int unpack_entry(opal_buffer_t *buf, announcement_t *ann)
+{
+    int rc, n;
 
     /* unpack the sender's triplet */
     n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &string_id, &n, OPAL_STRING))) {
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &ann->string_id, &n, OPAL_STRING))) {
         ORTE_ERROR_LOG(rc);
-        goto cleanup;
+        return rc;
+    }
+
+    /* and the handle its msgs will carry */
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &ann->handle, &n, ORCM_TRIPLET_HANDLE_T))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
     }
 
     /* get its input multicast channel */
     n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &input, &n, ORTE_RMCAST_CHANNEL_T))) {
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &ann->input, &n, ORTE_RMCAST_CHANNEL_T))) {
         ORTE_ERROR_LOG(rc);
-        goto cleanup;
+        return rc;
     }
     
     /* get its output multicast channel */
     n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &output, &n, ORTE_RMCAST_CHANNEL_T))) {
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &ann->output, &n, ORTE_RMCAST_CHANNEL_T))) {
         ORTE_ERROR_LOG(rc);
-        goto cleanup;
+        return rc;
     }
     
     /* get its nodename */
     n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &nodename, &n, OPAL_STRING))) {
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &ann->nodename, &n, OPAL_STRING))) {
         ORTE_ERROR_LOG(rc);
-        goto cleanup;
+        return rc;
     }
     
     /* get its uid */
     n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &uid, &n, OPAL_UINT32))) {
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &ann->uid, &n, OPAL_UINT32))) {
         ORTE_ERROR_LOG(rc);
-        goto cleanup;
+        return rc;
     }
     
     /* unpack the its rml uri */
     n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &rml_uri, &n, OPAL_STRING))) {
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &ann->rml_uri, &n, OPAL_STRING))) {
         ORTE_ERROR_LOG(rc);
-        goto cleanup;
+        return rc;
     }
 
     /* unpack its pid */
     n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &pid, &n, OPAL_PID))) {
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &ann->pid, &n, OPAL_PID))) {
         ORTE_ERROR_LOG(rc);
-        goto cleanup;
+        return rc;
     }
 
     /* unpack its incarnation */
     n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &incarnation, &n, OPAL_INT32))) {
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &ann->incarnation, &n, OPAL_INT32))) {
         ORTE_ERROR_LOG(rc);
-        goto cleanup;
+        return rc;
     }
+    return ORCM_SUCCESS;
+}
+
+/* record what we have been told about a process. An original
+ * announcement always gets the announce callback, a reply only
+ * if we didn't already know the process
+ */
+static int record_announcement(announcement_t *ann, bool original)
+{
+    orcm_triplet_t *triplet;
+    orcm_triplet_group_t *grp;
+    orcm_source_t *source;
+    char *app=NULL, *version=NULL, *release=NULL;
+    orte_process_name_t *sender = &ann->name;
+    orcm_info_t info;
+    bool known=true;
+    int rc;
 
     /* set the contact info - this has to be done even if the source is known
      * as it could be a repeat invocation of the same application
      */
-    if (ORTE_SUCCESS != (rc = orte_rml.set_contact_info(rml_uri))) {
+    if (ORTE_SUCCESS != (rc = orte_rml.set_contact_info(ann->rml_uri))) {
         ORTE_ERROR_LOG(rc);
         goto cleanup;
     }
@@ -155,29 +239,31 @@ void orcm_pnp_base_process_announcements(orte_process_name_t *sender,
         }
     }
 
-    /* who are they responding to? */
-    n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &originator, &n, ORTE_NAME))) {
-        ORTE_ERROR_LOG(rc);
-        goto cleanup;
-    }
-    
     OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
-                         "%s pnp:base:received announcement from app %s channel %s on node %s uid %u",
-                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
-                         string_id, orcm_pnp_print_channel(output), nodename, uid));
+                         "%s pnp:base:received announcement for %s from app %s channel %s on node %s uid %u",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), ORTE_NAME_PRINT(sender),
+                         ann->string_id, orcm_pnp_print_channel(ann->output),
+                         ann->nodename, ann->uid));
     
     /* break the stringid into its elements */
-    ORCM_DECOMPOSE_STRING_ID(string_id, app, version, release);
+    ORCM_DECOMPOSE_STRING_ID(ann->string_id, app, version, release);
 
     /* find this triplet - create if not found */
     triplet = orcm_get_triplet(app, version, release, true);
+    /* we derive the same handle from the stringid, so this only
+     * fails if the sender hashes stringids differently
+     */
+    if (ann->handle != triplet->handle) {
+        opal_output(0, "%s pnp:base: triplet %s announced by %s with handle %u - expected %u",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), ann->string_id,
+                    ORTE_NAME_PRINT(sender), ann->handle, triplet->handle);
+    }
     /* get the sender's group - create if not found */
     grp = orcm_get_triplet_group(triplet, sender->jobid, true);
 
     /* record the multicast channels it is on */
-    grp->input = input;
-    grp->output = output;
+    grp->input = ann->input;
+    grp->output = ann->output;
     /* check for any pending recvs */
     orcm_pnp_base_check_pending_recvs(triplet, grp);
 
@@ -212,15 +298,28 @@ void orcm_pnp_base_process_announcements(orte_process_name_t *sender,
         /* the source returns locked, so release it */
         ORTE_RELEASE_THREAD(&source->ctl);
     }
+    /* keep its contact info so we can pass it along */
+    if (NULL != source->nodename) {
+        free(source->nodename);
+    }
+    source->nodename = strdup(ann->nodename);
+    if (NULL != source->rml_uri) {
+        free(source->rml_uri);
+    }
+    source->rml_uri = strdup(ann->rml_uri);
+    source->uid = ann->uid;
+    source->pid = ann->pid;
+    source->incarnation = ann->incarnation;
     /* release the triplet thread */
     ORTE_RELEASE_THREAD(&triplet->ctl);
 
     /* if this is an original announcement, then we
      * always allow for the announce callback
      */
-    if (originator.jobid == ORTE_JOBID_INVALID &&
-        originator.vpid == ORTE_VPID_INVALID) {
+    if (original) {
         known = false;
+        /* a restarted proc will never finish what it was streaming */
+        orcm_pnp_base_drop_streams(sender);
     }
 
     /* notify the user, if requested - be sure to do
@@ -231,12 +330,11 @@ void orcm_pnp_base_process_announcements(orte_process_name_t *sender,
         /* if the user requested a callback, they probably intend to send
          * something to this triplet - so ensure the channel to its input is open
          */
-        if (ORTE_SUCCESS != (rc = orte_rmcast.open_channel(input, string_id, NULL, -1, NULL, ORTE_RMCAST_XMIT))) {
+        if (ORTE_SUCCESS != (rc = orte_rmcast.open_channel(ann->input, ann->string_id, NULL, -1, NULL, ORTE_RMCAST_XMIT))) {
             ORTE_ERROR_LOG(rc);
-            ORTE_RELEASE_THREAD(&triplet->ctl);
             goto cleanup;
         }
-        grp->pnp_cbfunc(app, version, release, input);
+        grp->pnp_cbfunc(app, version, release, ann->input);
         /* flag that the callback for this jobid/grp has been done */
         grp->pnp_cb_done = true;
         grp->pnp_cbfunc = NULL;
@@ -251,39 +349,234 @@ void orcm_pnp_base_process_announcements(orte_process_name_t *sender,
         info.version = version;
         info.release = release;
         info.name = sender;
-        info.nodename = nodename;
-        info.rml_uri = rml_uri;
-        info.uid = uid;
-        info.pid = pid;
-        info.incarnation = incarnation;
+        info.nodename = ann->nodename;
+        info.rml_uri = ann->rml_uri;
+        info.uid = ann->uid;
+        info.pid = ann->pid;
+        info.incarnation = ann->incarnation;
         orcm_pnp_base.my_announce_cbfunc(&info);
     }
 
-    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
-                         "%s pnp:base: announcement sent in response to originator %s",
-                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
-                         ORTE_NAME_PRINT(&originator)));
-    
-    /* if they were responding to an announcement by someone,
-     * then don't respond or else we'll go into an infinite
-     * loop of announcements
-     */
-    if (originator.jobid != ORTE_JOBID_INVALID &&
-        originator.vpid != ORTE_VPID_INVALID) {
-        /* nothing more to do */
-        OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
-                             "%s pnp:base:recvd_ann response to another announce - ignoring",
-                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+ cleanup:
+    if (NULL != app) {
+        free(app);
+    }
+    if (NULL != version) {
+        free(version);
+    }
+    if (NULL != release) {
+        free(release);
+    }
+    return rc;
+}
+
+static int my_announcement(announcement_t *ann)
+{
+    /* if we haven't registered an app-triplet yet, then we can't announce */
+    if (NULL == orcm_pnp_base.my_string_id || !orcm_pnp_base.comm_enabled) {
+        return ORCM_ERR_NOT_AVAILABLE;
+    }
+
+    ann->name = *ORTE_PROC_MY_NAME;
+    ann->string_id = strdup(orcm_pnp_base.my_string_id);
+    ann->handle = orcm_pnp_base.my_handle;
+    if (NULL != orcm_pnp_base.my_input_channel) {
+        ann->input = orcm_pnp_base.my_input_channel->channel;
+    } else {
+        ann->input = ORCM_PNP_INVALID_CHANNEL;
+    }
+    if (NULL != orcm_pnp_base.my_output_channel) {
+        ann->output = orcm_pnp_base.my_output_channel->channel;
+    } else {
+        ann->output = ORCM_PNP_INVALID_CHANNEL;
+    }
+    ann->nodename = strdup(orte_process_info.nodename);
+    ann->uid = orcm_pnp_base.my_uid;
+    ann->rml_uri = orte_rml.get_contact_info();
+    ann->pid = orte_process_info.pid;
+    ann->incarnation = orte_process_info.num_restarts;
+    return ORCM_SUCCESS;
+}
+
+/* in roster mode, the scheduler answers for everyone on the
+ * system channel, and the lowest live rank of each job
+ * answers for its own triplet on the app channel
+ */
+static bool is_responder(void)
+{
+    orcm_source_t *src;
+    orte_vpid_t v;
+    bool responder=true;
+
+    if (ORCM_PROC_IS_SCHEDULER) {
+        return true;
+    }
+    if (!ORCM_PROC_IS_APP || NULL == orcm_pnp_base.my_group) {
+        return false;
+    }
+
+    ORTE_ACQUIRE_THREAD(&orcm_pnp_base.my_triplet->ctl);
+    for (v=0; v < ORTE_PROC_MY_NAME->vpid; v++) {
+        src = (orcm_source_t*)opal_pointer_array_get_item(&orcm_pnp_base.my_group->members, v);
+        if (NULL != src && src->alive) {
+            responder = false;
+            break;
+        }
+    }
+    ORTE_RELEASE_THREAD(&orcm_pnp_base.my_triplet->ctl);
+    return responder;
+}
+
+/* add every live member of the triplet we can vouch for to the
+ * roster. The triplet must be locked by the caller
+ */
+static int pack_roster_triplet(opal_buffer_t *buf, orcm_triplet_t *triplet,
+                               orte_process_name_t *announcer, int32_t *count)
+{
+    orcm_triplet_group_t *grp;
+    orcm_source_t *src;
+    announcement_t ann;
+    int i, j, rc;
+
+    for (i=0; i < triplet->groups.size; i++) {
+        if (NULL == (grp = (orcm_triplet_group_t*)opal_pointer_array_get_item(&triplet->groups, i))) {
+            continue;
+        }
+        for (j=0; j < grp->members.size; j++) {
+            if (NULL == (src = (orcm_source_t*)opal_pointer_array_get_item(&grp->members, j))) {
+                continue;
+            }
+            /* only pass along what we heard from it directly */
+            if (!src->alive || NULL == src->rml_uri ||
+                OPAL_EQUAL == orte_util_compare_name_fields(ORTE_NS_CMP_ALL, &src->name, announcer) ||
+                OPAL_EQUAL == orte_util_compare_name_fields(ORTE_NS_CMP_ALL, &src->name, ORTE_PROC_MY_NAME)) {
+                continue;
+            }
+            /* the strings are only borrowed - don't clear this */
+            ann.name = src->name;
+            ann.string_id = triplet->string_id;
+            ann.handle = triplet->handle;
+            ann.input = grp->input;
+            ann.output = grp->output;
+            ann.nodename = src->nodename;
+            ann.uid = src->uid;
+            ann.rml_uri = src->rml_uri;
+            ann.pid = src->pid;
+            ann.incarnation = src->incarnation;
+            if (ORCM_SUCCESS != (rc = opal_dss.pack(buf, &ann.name, 1, ORTE_NAME)) ||
+                ORCM_SUCCESS != (rc = pack_entry(buf, &ann))) {
+                ORTE_ERROR_LOG(rc);
+                return rc;
+            }
+            (*count)++;
+        }
+    }
+    return ORCM_SUCCESS;
+}
+
+static void send_roster(orcm_pnp_channel_t chan, orte_process_name_t *announcer)
+{
+    opal_buffer_t *ann, entries;
+    opal_pointer_array_t snapshot;
+    orcm_pnp_announce_kind_t kind=ORCM_PNP_ANNOUNCE_ROSTER;
+    announcement_t me;
+    orcm_triplet_t *triplet;
+    int32_t count=0;
+    int i, rc;
+
+    memset(&me, 0, sizeof(me));
+    OBJ_CONSTRUCT(&entries, opal_buffer_t);
+    ann = OBJ_NEW(opal_buffer_t);
+
+    /* we always lead the roster */
+    if (ORCM_SUCCESS != (rc = my_announcement(&me))) {
+        /* not-avail => have not announced ourselves yet */
+        if (ORCM_ERR_NOT_AVAILABLE != rc) {
+            ORTE_ERROR_LOG(rc);
+        }
         goto cleanup;
     }
-    
-    /* if we get here, then this is an original announcement */
-    if (ORCM_PROC_IS_APP) {
-        chan = ORTE_RMCAST_APP_PUBLIC_CHANNEL;
+    if (ORCM_SUCCESS != (rc = opal_dss.pack(&entries, &me.name, 1, ORTE_NAME)) ||
+        ORCM_SUCCESS != (rc = pack_entry(&entries, &me))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    count++;
+
+    if (ORCM_PROC_IS_SCHEDULER) {
+        /* everyone else locks a triplet before the global array, so
+         * only snapshot the array under its lock - triplets persist
+         * until finalize, so they can be visited after releasing it
+         */
+        OBJ_CONSTRUCT(&snapshot, opal_pointer_array_t);
+        opal_pointer_array_init(&snapshot, 8, INT_MAX, 8);
+        ORTE_ACQUIRE_THREAD(&orcm_triplets->ctl);
+        for (i=0; i < orcm_triplets->array.size; i++) {
+            if (NULL != (triplet = (orcm_triplet_t*)opal_pointer_array_get_item(&orcm_triplets->array, i))) {
+                opal_pointer_array_add(&snapshot, triplet);
+            }
+        }
+        ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
+        for (i=0; i < snapshot.size; i++) {
+            if (NULL == (triplet = (orcm_triplet_t*)opal_pointer_array_get_item(&snapshot, i))) {
+                continue;
+            }
+            ORTE_ACQUIRE_THREAD(&triplet->ctl);
+            rc = pack_roster_triplet(&entries, triplet, announcer, &count);
+            ORTE_RELEASE_THREAD(&triplet->ctl);
+            if (ORCM_SUCCESS != rc) {
+                break;
+            }
+        }
+        OBJ_DESTRUCT(&snapshot);
     } else {
-        chan = ORTE_RMCAST_SYS_CHANNEL;
+        triplet = orcm_pnp_base.my_triplet;
+        ORTE_ACQUIRE_THREAD(&triplet->ctl);
+        rc = pack_roster_triplet(&entries, triplet, announcer, &count);
+        ORTE_RELEASE_THREAD(&triplet->ctl);
     }
-    
+    if (ORCM_SUCCESS != rc) {
+        goto cleanup;
+    }
+
+    if (ORCM_SUCCESS != (rc = opal_dss.pack(ann, &kind, 1, ORCM_PNP_ANNOUNCE_KIND_T)) ||
+        ORCM_SUCCESS != (rc = opal_dss.pack(ann, announcer, 1, ORTE_NAME)) ||
+        ORCM_SUCCESS != (rc = opal_dss.pack(ann, &count, 1, OPAL_INT32)) ||
+        ORCM_SUCCESS != (rc = opal_dss.copy_payload(ann, &entries))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:base: sending roster of %d procs in response to %s",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), count,
+                         ORTE_NAME_PRINT(announcer)));
+
+    /* send it - the callback releases the buffer */
+    if (ORCM_SUCCESS != (rc = orcm_pnp.output_nb(chan, NULL,
+                                                 ORCM_PNP_TAG_ANNOUNCE,
+                                                 NULL, 0, ann, cbfunc, NULL))) {
+        /* protect against a race condition */
+        if (ORTE_ERR_COMM_DISABLED != rc) {
+            ORTE_ERROR_LOG(rc);
+        }
+        goto cleanup;
+    }
+    ann = NULL;
+
+ cleanup:
+    if (NULL != ann) {
+        OBJ_RELEASE(ann);
+    }
+    OBJ_DESTRUCT(&entries);
+    clear_announcement(&me);
+}
+
+static void send_reply(orcm_pnp_channel_t chan, orte_process_name_t *announcer)
+{
+    opal_buffer_t *ann;
+    int rc;
+
     OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
                          "%s pnp:base:received announcement sending response",
                          ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
@@ -292,13 +585,13 @@ void orcm_pnp_base_process_announcements(orte_process_name_t *sender,
     ann = OBJ_NEW(opal_buffer_t);
     
     /* pack the common elements */
-    if (ORCM_SUCCESS != (rc = orcm_pnp_base_pack_announcement(ann, sender))) {
+    if (ORCM_SUCCESS != (rc = orcm_pnp_base_pack_announcement(ann, announcer))) {
         if (ORCM_ERR_NOT_AVAILABLE != rc) {
             /* not-avail => have not announced ourselves yet */
             ORTE_ERROR_LOG(rc);
         }
         OBJ_RELEASE(ann);
-        goto cleanup;
+        return;
     }
     
     /* send it */
@@ -310,98 +603,230 @@ void orcm_pnp_base_process_announcements(orte_process_name_t *sender,
             ORTE_ERROR_LOG(rc);
         }
     }
-    
- cleanup:
-    if (NULL != app) {
-        free(app);
+}
+
+static void delayed_reply(int fd, short args, void *cbdata)
+{
+    orcm_pnp_reply_t *reply = (orcm_pnp_reply_t*)cbdata;
+    bool cancelled;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.reply_lock);
+    opal_list_remove_item(&orcm_pnp_base.replies, &reply->super);
+    cancelled = reply->cancelled;
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.reply_lock);
+
+    if (!cancelled) {
+        /* nobody answered for us - do it ourselves */
+        send_reply(reply->channel, &reply->announcer);
     }
-    if (NULL != version) {
-        free(version);
+    OBJ_RELEASE(reply);
+}
+
+/* hold our reply for a random part of the delay so we
+ * only send it if no roster naming us shows up first
+ */
+static void hold_reply(orcm_pnp_channel_t chan, orte_process_name_t *announcer)
+{
+    orcm_pnp_reply_t *reply;
+    struct timeval delay;
+    int msecs;
+
+    reply = OBJ_NEW(orcm_pnp_reply_t);
+    reply->announcer = *announcer;
+    reply->channel = chan;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.reply_lock);
+    msecs = rand_r(&orcm_pnp_base.reply_seed) % (orcm_pnp_base.reply_delay + 1);
+    delay.tv_sec = msecs / 1000;
+    delay.tv_usec = (msecs % 1000) * 1000;
+    opal_list_append(&orcm_pnp_base.replies, &reply->super);
+    opal_event_evtimer_set(opal_event_base, &reply->ev, delayed_reply, reply);
+    opal_event_evtimer_add(&reply->ev, &delay);
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.reply_lock);
+}
+
+/* the reply stays queued until its timer fires so there
+ * is only ever one owner - just flag it
+ */
+static void cancel_reply(orte_process_name_t *announcer)
+{
+    opal_list_item_t *item;
+    orcm_pnp_reply_t *reply;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.reply_lock);
+    for (item = opal_list_get_first(&orcm_pnp_base.replies);
+         item != opal_list_get_end(&orcm_pnp_base.replies);
+         item = opal_list_get_next(item)) {
+        reply = (orcm_pnp_reply_t*)item;
+        if (OPAL_EQUAL == orte_util_compare_name_fields(ORTE_NS_CMP_ALL, &reply->announcer, announcer)) {
+            OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                                 "%s pnp:base: roster seen for %s - suppressing response",
+                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                                 ORTE_NAME_PRINT(announcer)));
+            reply->cancelled = true;
+        }
     }
-    if (NULL != release) {
-        free(release);
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.reply_lock);
+}
+
+void orcm_pnp_base_cancel_replies(void)
+{
+    orcm_pnp_reply_t *reply;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.reply_lock);
+    while (NULL != (reply = (orcm_pnp_reply_t*)opal_list_remove_first(&orcm_pnp_base.replies))) {
+        opal_event_evtimer_del(&reply->ev);
+        OBJ_RELEASE(reply);
     }
-    if (NULL != string_id) {
-        free(string_id);
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.reply_lock);
+}
+
+static void process_roster(opal_buffer_t *buf)
+{
+    orte_process_name_t announcer;
+    announcement_t ann;
+    int32_t count, i;
+    int rc, n;
+    bool named=false;
+
+    memset(&ann, 0, sizeof(ann));
+
+    /* who is this roster for? */
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &announcer, &n, ORTE_NAME))) {
+        ORTE_ERROR_LOG(rc);
+        return;
+    }
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &count, &n, OPAL_INT32))) {
+        ORTE_ERROR_LOG(rc);
+        return;
     }
-    if (NULL != rml_uri) {
-        free(rml_uri);
+
+    for (i=0; i < count; i++) {
+        n=1;
+        if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &ann.name, &n, ORTE_NAME))) {
+            ORTE_ERROR_LOG(rc);
+            goto cleanup;
+        }
+        if (ORCM_SUCCESS != (rc = unpack_entry(buf, &ann))) {
+            goto cleanup;
+        }
+        if (OPAL_EQUAL == orte_util_compare_name_fields(ORTE_NS_CMP_ALL, &ann.name, ORTE_PROC_MY_NAME)) {
+            named = true;
+        } else {
+            record_announcement(&ann, false);
+        }
+        clear_announcement(&ann);
     }
-    if (NULL != nodename) {
-        free(nodename);
+
+    /* the announcer has been told about us, so we can stay quiet */
+    if (named) {
+        cancel_reply(&announcer);
     }
-    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
-                         "%s pnp:base:recvd_announce complete",
-                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
-    return;
+
+ cleanup:
+    clear_announcement(&ann);
 }
 
-/* pack the common elements of an announcement message */
-int orcm_pnp_base_pack_announcement(opal_buffer_t *buf, orte_process_name_t *sender)
+void orcm_pnp_base_process_announcements(orte_process_name_t *sender,
+                                         opal_buffer_t *buf)
 {
-    int ret;
-    char *rml_uri;
+    orcm_pnp_announce_kind_t kind;
+    announcement_t ann;
+    orte_process_name_t originator;
     orcm_pnp_channel_t chan;
+    int rc, n;
 
-    /* if we haven't registered an app-triplet yet, then we can't announce */
-    if (NULL == orcm_pnp_base.my_string_id || !orcm_pnp_base.comm_enabled) {
-        return ORCM_ERR_NOT_AVAILABLE;
-    }
-    
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &orcm_pnp_base.my_string_id, 1, OPAL_STRING))) {
-        ORTE_ERROR_LOG(ret);
-        return ret;
+    memset(&ann, 0, sizeof(ann));
+
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &kind, &n, ORCM_PNP_ANNOUNCE_KIND_T))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
     }
-    /* pack my input channel */
-    if (NULL != orcm_pnp_base.my_input_channel) {
-        chan = orcm_pnp_base.my_input_channel->channel;
-    } else {
-        chan = ORCM_PNP_INVALID_CHANNEL;
+    if (ORCM_PNP_ANNOUNCE_ROSTER == kind) {
+        process_roster(buf);
+        goto cleanup;
     }
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &chan, 1, ORTE_RMCAST_CHANNEL_T))) {
-        ORTE_ERROR_LOG(ret);
-        return ret;
+
+    ann.name = *sender;
+    if (ORCM_SUCCESS != (rc = unpack_entry(buf, &ann))) {
+        goto cleanup;
     }
 
-    /* pack my output channel */
-    if (NULL != orcm_pnp_base.my_output_channel) {
-        chan = orcm_pnp_base.my_output_channel->channel;
-    } else {
-        chan = ORCM_PNP_INVALID_CHANNEL;
+    /* who are they responding to? */
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &originator, &n, ORTE_NAME))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
     }
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &chan, 1, ORTE_RMCAST_CHANNEL_T))) {
-        ORTE_ERROR_LOG(ret);
-        return ret;
+    
+    if (ORCM_SUCCESS != record_announcement(&ann, (originator.jobid == ORTE_JOBID_INVALID &&
+                                                   originator.vpid == ORTE_VPID_INVALID))) {
+        goto cleanup;
     }
 
-    /* pack my node */
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &orte_process_info.nodename, 1, OPAL_STRING))) {
-        ORTE_ERROR_LOG(ret);
-        return ret;
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:base: announcement sent in response to originator %s",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                         ORTE_NAME_PRINT(&originator)));
+    
+    /* if they were responding to an announcement by someone,
+     * then don't respond or else we'll go into an infinite
+     * loop of announcements
+     */
+    if (originator.jobid != ORTE_JOBID_INVALID &&
+        originator.vpid != ORTE_VPID_INVALID) {
+        /* nothing more to do */
+        OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                             "%s pnp:base:recvd_ann response to another announce - ignoring",
+                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+        goto cleanup;
     }
-    /* pack my userid */
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &orcm_pnp_base.my_uid, 1, OPAL_UINT32))) {
-        ORTE_ERROR_LOG(ret);
-        return ret;
+    
+    /* if we get here, then this is an original announcement */
+    if (ORCM_PROC_IS_APP) {
+        chan = ORTE_RMCAST_APP_PUBLIC_CHANNEL;
+    } else {
+        chan = ORTE_RMCAST_SYS_CHANNEL;
     }
-    /* pack my uri */
-    rml_uri = orte_rml.get_contact_info();
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &rml_uri, 1, OPAL_STRING))) {
-        ORTE_ERROR_LOG(ret);
-        return ret;
+    
+    if (!orcm_pnp_base.roster) {
+        /* everyone answers */
+        send_reply(chan, sender);
+    } else if (is_responder()) {
+        send_roster(chan, sender);
+    } else if (0 < orcm_pnp_base.reply_delay) {
+        hold_reply(chan, sender);
     }
-    free(rml_uri);
     
-    /* pack my pid - useful for debugging */
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &orte_process_info.pid, 1, OPAL_PID))) {
-        ORTE_ERROR_LOG(ret);
+ cleanup:
+    clear_announcement(&ann);
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:base:recvd_announce complete",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+    return;
+}
+
+/* pack the common elements of an announcement message */
+int orcm_pnp_base_pack_announcement(opal_buffer_t *buf, orte_process_name_t *sender)
+{
+    int ret;
+    orcm_pnp_announce_kind_t kind=ORCM_PNP_ANNOUNCE_SINGLE;
+    announcement_t me;
+
+    memset(&me, 0, sizeof(me));
+    if (ORCM_SUCCESS != (ret = my_announcement(&me))) {
         return ret;
     }
 
-    /* pack my incarnation number */
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &orte_process_info.num_restarts, 1, OPAL_INT32))) {
+    if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, &kind, 1, ORCM_PNP_ANNOUNCE_KIND_T))) {
         ORTE_ERROR_LOG(ret);
-        return ret;
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (ret = pack_entry(buf, &me))) {
+        goto cleanup;
     }
 
     /* tell everyone we are responding to an announcement
@@ -409,7 +834,7 @@ int orcm_pnp_base_pack_announcement(opal_buffer_t *buf, orte_process_name_t *sen
      */
     if (ORCM_SUCCESS != (ret = opal_dss.pack(buf, sender, 1, ORTE_NAME))) {
         ORTE_ERROR_LOG(ret);
-        return ret;
+        goto cleanup;
     }        
     
     if (ORCM_PROC_IS_DAEMON || ORCM_PROC_IS_MASTER) {
@@ -450,11 +875,23 @@ int orcm_pnp_base_pack_announcement(opal_buffer_t *buf, orte_process_name_t *sen
         OBJ_DESTRUCT(&resources);
     }
     
-    return ORCM_SUCCESS;
+ cleanup:
+    clear_announcement(&me);
+    return ret;
+}
+
+void orcm_pnp_base_set_request_id(orcm_pnp_request_t *req,
+                                  const char *string_id)
+{
+    if (NULL != req->string_id) {
+        free(req->string_id);
+    }
+    req->string_id = strdup(string_id);
+    orcm_triplet_key_init(&req->key, string_id);
 }
 
 orcm_pnp_request_t* orcm_pnp_base_find_request(opal_list_t *list,
-                                               char *string_id,
+                                               const orcm_triplet_key_t *key,
                                                orcm_pnp_tag_t tag)
 {
     orcm_pnp_request_t *req;
@@ -470,10 +907,10 @@ orcm_pnp_request_t* orcm_pnp_base_find_request(opal_list_t *list,
             continue;
         }
         /* tags match - check the string_id's */
-        if (orcm_triplet_cmp(string_id, req->string_id)) {
+        if (orcm_triplet_key_cmp(key, &req->key)) {
             OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
                                  "%s MATCHED RECV %s TO %s TAG %s:%s",
-                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), string_id,
+                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), key->str,
                                  req->string_id, orcm_pnp_print_tag(tag),
                                  orcm_pnp_print_tag(req->tag)));
             return req;
@@ -483,76 +920,90 @@ orcm_pnp_request_t* orcm_pnp_base_find_request(opal_list_t *list,
     return NULL;
 }
 
+/* move the contents of one buffer to another without copying the
+ * data - the src is left empty, so whoever owns it can release it
+ * as usual. Whatever memory dest had goes back to the buffer pool
+ * rather than being freed, as dest is usually a pooled msg
+ */
+void orcm_pnp_base_transfer_payload(opal_buffer_t *dest, opal_buffer_t *src)
+{
+    orcm_pnp_base_stash_storage(dest);
+    dest->type = src->type;
+    dest->base_ptr = src->base_ptr;
+    dest->pack_ptr = src->pack_ptr;
+    dest->unpack_ptr = src->unpack_ptr;
+    dest->bytes_allocated = src->bytes_allocated;
+    dest->bytes_used = src->bytes_used;
+
+    src->base_ptr = NULL;
+    src->pack_ptr = NULL;
+    src->unpack_ptr = NULL;
+    src->bytes_allocated = 0;
+    src->bytes_used = 0;
+}
+
+opal_buffer_t* orcm_pnp_retain_buffer(opal_buffer_t *buf)
+{
+    opal_buffer_t *keep;
+
+    keep = OBJ_NEW(opal_buffer_t);
+    if (1 < ((opal_object_t*)buf)->obj_reference_count) {
+        /* other recvs still need the msg - copy what is left */
+        if (ORCM_SUCCESS != orcm_pnp_base_append_raw(keep, buf->unpack_ptr,
+                                                     buf->bytes_used - (buf->unpack_ptr - buf->base_ptr))) {
+            OBJ_RELEASE(keep);
+        }
+        return keep;
+    }
+    orcm_pnp_base_transfer_payload(keep, buf);
+    return keep;
+}
+
 int orcm_pnp_base_construct_msg(opal_buffer_t **buf, opal_buffer_t *buffer,
-                                orcm_pnp_tag_t tag, struct iovec *msg, int count)
+                                orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                                struct iovec *msg, int count)
 {
     int ret;
-    int8_t flag;
-    int sz;
-    int32_t cnt;
 
-    *buf = OBJ_NEW(opal_buffer_t);
+    *buf = orcm_pnp_base_get_buffer((NULL == buffer) ? 0 : buffer->bytes_used + 64);
     
-    /* insert our string_id */
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(*buf, &orcm_pnp_base.my_string_id, 1, OPAL_STRING))) {
-        ORTE_ERROR_LOG(ret);
-        OBJ_RELEASE(*buf);
-        return ret;
-    }
-
-    /* pack the tag - we don't actually need the tag for messages sent
-     * via multicast as we get it directly passed to the callback function.
-     * However, we don't get the right tag passed to us for direct
-     * messages, so we need it there. Since it costs next to nothing to
-     * include it, we do so for all cases
+    /* the header carries our triplet handle - receivers learned the
+     * stringid it stands for from our announcement - and the tag. We
+     * don't actually need the tag for messages sent via multicast as
+     * we get it directly passed to the callback function. However, we
+     * don't get the right tag passed to us for direct messages, so we
+     * need it there. Since it costs next to nothing to include it, we
+     * do so for all cases
      */
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(*buf, &tag, 1, ORCM_PNP_TAG_T))) {
-        ORTE_ERROR_LOG(ret);
-        OBJ_RELEASE(*buf);
-        return ret;
-    }
     if (NULL != msg) {
-        /* flag the buffer as containing iovecs */
-        flag = 0;
-        if (ORCM_SUCCESS != (ret = opal_dss.pack(*buf, &flag, 1, OPAL_INT8))) {
-            ORTE_ERROR_LOG(ret);
-            OBJ_RELEASE(*buf);
-            return ret;
-        }    
-        /* pack the number of iovecs */
-        cnt = count;
-        if (ORCM_SUCCESS != (ret = opal_dss.pack(*buf, &cnt, 1, OPAL_INT32))) {
+        /* flag the buffer as containing iovecs, and include the size
+         * of each iovec so we can recreate the array at the other end.
+         * The bytes themselves are NOT packed - the caller hands them
+         * to the transport behind this header
+         */
+        if (ORCM_SUCCESS != (ret = orcm_pnp_base_pack_header(*buf, tag, ORCM_PNP_MSG_IOVECS)) ||
+            ORCM_SUCCESS != (ret = orcm_pnp_base_pack_sizes(*buf, msg, count))) {
             ORTE_ERROR_LOG(ret);
             OBJ_RELEASE(*buf);
             return ret;
         }
-        
-        /* pack each iovec into a buffer in prep for sending
-         * so we can recreate the array at the other end
-         */
-        for (sz=0; sz < count; sz++) {
-            /* pack the size */
-            cnt = msg[sz].iov_len;
-            if (ORCM_SUCCESS != (ret = opal_dss.pack(*buf, &cnt, 1, OPAL_INT32))) {
-                ORTE_ERROR_LOG(ret);
-                OBJ_RELEASE(*buf);
-                return ret;
-            }        
-            if (0 < cnt) {
-                /* pack the bytes */
-                if (ORCM_SUCCESS != (ret = opal_dss.pack(*buf, msg[sz].iov_base, cnt, OPAL_UINT8))) {
-                    ORTE_ERROR_LOG(ret);
-                    OBJ_RELEASE(*buf);
-                    return ret;
-                }            
-            }
-        }
         return ORCM_SUCCESS;
     }
     
+    /* send the payload compressed if it is worth it */
+    if (orcm_pnp_base_want_compress(channel, tag, buffer->bytes_used -
+                                    (size_t)(buffer->unpack_ptr - buffer->base_ptr))) {
+        if (ORCM_SUCCESS == (ret = orcm_pnp_base_compress_payload(*buf, tag, buffer))) {
+            return ORCM_SUCCESS;
+        }
+        if (ORCM_ERR_NOT_AVAILABLE != ret) {
+            OBJ_RELEASE(*buf);
+            return ret;
+        }
+    }
+
     /* flag that we sent a buffer */
-    flag = 1;
-    if (ORCM_SUCCESS != (ret = opal_dss.pack(*buf, &flag, 1, OPAL_INT8))) {
+    if (ORCM_SUCCESS != (ret = orcm_pnp_base_pack_header(*buf, tag, ORCM_PNP_MSG_BUFFER))) {
         ORTE_ERROR_LOG(ret);
         OBJ_RELEASE(*buf);
         return ret;
@@ -565,6 +1016,259 @@ int orcm_pnp_base_construct_msg(opal_buffer_t **buf, opal_buffer_t *buffer,
     return ret;
 }
 
+/* build the iovec array for a scatter-gather send of a msg - the
+ * header goes first, followed by the caller's iovecs untouched
+ */
+struct iovec* orcm_pnp_base_gather_msg(opal_buffer_t *hdr,
+                                       struct iovec *msg, int count)
+{
+    struct iovec *iovs;
+    int i;
+
+    iovs = (struct iovec*)malloc((count+1) * sizeof(struct iovec));
+    if (NULL == iovs) {
+        return NULL;
+    }
+    iovs[0].iov_base = hdr->base_ptr;
+    iovs[0].iov_len = hdr->bytes_used;
+    for (i=0; i < count; i++) {
+        iovs[i+1].iov_base = msg[i].iov_base;
+        iovs[i+1].iov_len = msg[i].iov_len;
+    }
+    return iovs;
+}
+
+/* the multicast transport only takes a buffer, so append the raw
+ * iovec bytes to the header in one contiguous block
+ */
+int orcm_pnp_base_flatten_msg(opal_buffer_t *hdr,
+                              struct iovec *msg, int count)
+{
+    int ret, i;
+    void *payload;
+    int32_t hdrsz;
+    size_t sz;
+    uint8_t *ptr;
+
+    if (ORCM_SUCCESS != (ret = opal_dss.unload(hdr, &payload, &hdrsz))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    sz = hdrsz;
+    for (i=0; i < count; i++) {
+        sz += msg[i].iov_len;
+    }
+    if (NULL == (ptr = (uint8_t*)realloc(payload, sz))) {
+        free(payload);
+        ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+        return ORCM_ERR_OUT_OF_RESOURCE;
+    }
+    payload = ptr;
+    ptr += hdrsz;
+    for (i=0; i < count; i++) {
+        if (0 < msg[i].iov_len) {
+            memcpy(ptr, msg[i].iov_base, msg[i].iov_len);
+            ptr += msg[i].iov_len;
+        }
+    }
+    if (ORCM_SUCCESS != (ret = opal_dss.load(hdr, payload, (int32_t)sz))) {
+        ORTE_ERROR_LOG(ret);
+        free(payload);
+    }
+    return ret;
+}
+
+/* append raw bytes behind whatever has been packed into the buffer,
+ * growing it geometrically so repeated appends stay cheap
+ */
+int orcm_pnp_base_append_raw(opal_buffer_t *buf, const void *data, size_t len)
+{
+    size_t need, sz, off;
+    char *ptr;
+
+    need = buf->bytes_used + len;
+    if (buf->bytes_allocated < need) {
+        sz = (0 == buf->bytes_allocated) ? 256 : buf->bytes_allocated;
+        while (sz < need) {
+            sz <<= 1;
+        }
+        off = (NULL == buf->base_ptr) ? 0 : (size_t)(buf->unpack_ptr - buf->base_ptr);
+        if (NULL == (ptr = (char*)realloc(buf->base_ptr, sz))) {
+            ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+            return ORCM_ERR_OUT_OF_RESOURCE;
+        }
+        buf->base_ptr = ptr;
+        buf->unpack_ptr = ptr + off;
+        buf->bytes_allocated = sz;
+    }
+    if (0 < len) {
+        memcpy(buf->base_ptr + buf->bytes_used, data, len);
+    }
+    buf->bytes_used = need;
+    buf->pack_ptr = buf->base_ptr + need;
+    return ORCM_SUCCESS;
+}
+
+/* the msg header, the entry headers of batched msgs and the sizes
+ * that let the receiver find its way around a msg have a fixed layout
+ * both ends agree on, so they are laid down raw in network byte order
+ * instead of going through the DSS with its counts and type descriptions
+ */
+int orcm_pnp_base_pack_header(opal_buffer_t *buf, orcm_pnp_tag_t tag, int8_t flag)
+{
+    uint8_t hdr[ORCM_PNP_HDR_SIZE];
+    uint32_t val;
+
+    val = htonl((uint32_t)orcm_pnp_base.my_handle);
+    memcpy(hdr, &val, 4);
+    val = htonl((uint32_t)tag);
+    memcpy(hdr+4, &val, 4);
+    hdr[8] = (uint8_t)flag;
+    return orcm_pnp_base_append_raw(buf, hdr, ORCM_PNP_HDR_SIZE);
+}
+
+int orcm_pnp_base_unpack_header(opal_buffer_t *buf, orcm_triplet_handle_t *handle,
+                                orcm_pnp_tag_t *tag, int8_t *flag)
+{
+    uint32_t val;
+    int rc;
+
+    if (ORCM_SUCCESS != (rc = orcm_pnp_base_unpack_raw32(buf, &val))) {
+        return rc;
+    }
+    *handle = (orcm_triplet_handle_t)val;
+    return orcm_pnp_base_unpack_entry(buf, tag, flag);
+}
+
+int orcm_pnp_base_pack_entry(opal_buffer_t *buf, orcm_pnp_tag_t tag, int8_t flag)
+{
+    uint8_t entry[5];
+    uint32_t val;
+
+    val = htonl((uint32_t)tag);
+    memcpy(entry, &val, 4);
+    entry[4] = (uint8_t)flag;
+    return orcm_pnp_base_append_raw(buf, entry, 5);
+}
+
+int orcm_pnp_base_unpack_entry(opal_buffer_t *buf, orcm_pnp_tag_t *tag, int8_t *flag)
+{
+    uint32_t val;
+    int rc;
+
+    if (ORCM_SUCCESS != (rc = orcm_pnp_base_unpack_raw32(buf, &val))) {
+        return rc;
+    }
+    if (buf->bytes_used < (size_t)(buf->unpack_ptr - buf->base_ptr) + 1) {
+        return ORCM_ERR_UNPACK_READ_PAST_END_OF_BUFFER;
+    }
+    *tag = (orcm_pnp_tag_t)val;
+    *flag = (int8_t)*buf->unpack_ptr;
+    buf->unpack_ptr++;
+    return ORCM_SUCCESS;
+}
+
+int orcm_pnp_base_pack_raw32(opal_buffer_t *buf, uint32_t val)
+{
+    val = htonl(val);
+    return orcm_pnp_base_append_raw(buf, &val, 4);
+}
+
+int orcm_pnp_base_unpack_raw32(opal_buffer_t *buf, uint32_t *val)
+{
+    if (NULL == buf->base_ptr ||
+        buf->bytes_used < (size_t)(buf->unpack_ptr - buf->base_ptr) + 4) {
+        return ORCM_ERR_UNPACK_READ_PAST_END_OF_BUFFER;
+    }
+    memcpy(val, buf->unpack_ptr, 4);
+    *val = ntohl(*val);
+    buf->unpack_ptr += 4;
+    return ORCM_SUCCESS;
+}
+
+/* the number of iovecs followed by the size of each */
+int orcm_pnp_base_pack_sizes(opal_buffer_t *buf, struct iovec *msg, int count)
+{
+    int ret, i;
+
+    if (ORCM_SUCCESS != (ret = orcm_pnp_base_pack_raw32(buf, (uint32_t)count))) {
+        return ret;
+    }
+    for (i=0; i < count; i++) {
+        if (ORCM_SUCCESS != (ret = orcm_pnp_base_pack_raw32(buf, (uint32_t)msg[i].iov_len))) {
+            return ret;
+        }
+    }
+    return ORCM_SUCCESS;
+}
+
+/* start a frame of batched msgs - the tag only serves the
+ * transport, as each msg in the frame carries its own
+ */
+int orcm_pnp_base_start_batch(opal_buffer_t **frame, orcm_pnp_tag_t tag)
+{
+    int ret;
+
+    *frame = orcm_pnp_base_get_buffer(orcm_pnp_base.batch_size);
+    if (ORCM_SUCCESS != (ret = orcm_pnp_base_pack_header(*frame, tag, ORCM_PNP_MSG_BATCH))) {
+        ORTE_ERROR_LOG(ret);
+        OBJ_RELEASE(*frame);
+    }
+    return ret;
+}
+
+/* add a msg to a frame - laid out as a regular msg minus the
+ * triplet handle, except that a buffer is preceded by its size
+ * so the receiver can tell where the next msg starts
+ */
+int orcm_pnp_base_batch_msg(opal_buffer_t *frame, orcm_pnp_tag_t tag,
+                            struct iovec *msg, int count,
+                            opal_buffer_t *buffer)
+{
+    int ret, i;
+    uint32_t cnt;
+
+    if (NULL != msg) {
+        if (ORCM_SUCCESS != (ret = orcm_pnp_base_pack_entry(frame, tag, ORCM_PNP_MSG_IOVECS)) ||
+            ORCM_SUCCESS != (ret = orcm_pnp_base_pack_sizes(frame, msg, count))) {
+            ORTE_ERROR_LOG(ret);
+            return ret;
+        }
+        for (i=0; i < count; i++) {
+            if (ORCM_SUCCESS != (ret = orcm_pnp_base_append_raw(frame, msg[i].iov_base, msg[i].iov_len))) {
+                return ret;
+            }
+        }
+        return ORCM_SUCCESS;
+    }
+
+    cnt = buffer->bytes_used - (uint32_t)(buffer->unpack_ptr - buffer->base_ptr);
+    if (ORCM_SUCCESS != (ret = orcm_pnp_base_pack_entry(frame, tag, ORCM_PNP_MSG_BUFFER)) ||
+        ORCM_SUCCESS != (ret = orcm_pnp_base_pack_raw32(frame, cnt))) {
+        ORTE_ERROR_LOG(ret);
+        return ret;
+    }
+    return orcm_pnp_base_append_raw(frame, buffer->unpack_ptr, cnt);
+}
+
+void orcm_pnp_base_release_batches(void)
+{
+    uint32_t chan;
+    void *ptr, *node, *next;
+    int rc;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.batch_lock);
+    rc = opal_hash_table_get_first_key_uint32(&orcm_pnp_base.batches,
+                                              &chan, &ptr, &node);
+    while (OPAL_SUCCESS == rc) {
+        OBJ_RELEASE(ptr);
+        rc = opal_hash_table_get_next_key_uint32(&orcm_pnp_base.batches,
+                                                 &chan, &ptr, node, &next);
+        node = next;
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.batch_lock);
+}
+
 /* given a triplet_group, check logged recvs to see if any need to be moved
  * to the channel array for the group's channels. This includes looking at
  * recvs placed against the specified triplet, AND recvs placed against
@@ -598,10 +1302,10 @@ void orcm_pnp_base_check_trip_recvs(char *stringid,
                 }
             }
             /* see if this recv is already present */
-            if (NULL == (reqcp = orcm_pnp_base_find_request(&recvr->recvs, req->string_id, req->tag))) {
+            if (NULL == (reqcp = orcm_pnp_base_find_request(&recvr->recvs, &req->key, req->tag))) {
                 /* not already present - create it */
                 reqcp = OBJ_NEW(orcm_pnp_request_t);
-                reqcp->string_id = strdup(req->string_id);
+                orcm_pnp_base_set_request_id(reqcp, req->string_id);
                 reqcp->tag = req->tag;
                 opal_list_append(&recvr->recvs, &reqcp->super);
             }
@@ -613,12 +1317,13 @@ void orcm_pnp_base_check_trip_recvs(char *stringid,
             if (NULL != orcm_pnp_base.my_string_id &&
                 recvr == orcm_pnp_base.my_input_channel &&
                 0 == strcasecmp(orcm_pnp_base.my_string_id, req->string_id)) {
-                free(reqcp->string_id);
-                reqcp->string_id = strdup(ORCM_WILDCARD_STRING_ID);
+                orcm_pnp_base_set_request_id(reqcp, ORCM_WILDCARD_STRING_ID);
             }
             /* update the cbfunc */
             reqcp->cbfunc = req->cbfunc;
+            reqcp->stream_cbfunc = req->stream_cbfunc;
             reqcp->cbdata = req->cbdata;
+            orcm_pnp_base_set_executor(reqcp, req->executor);
 
             OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
                                  "%s pnp:base:check_trip_recvs putting recv for %s:%s on channel %s",
@@ -626,6 +1331,9 @@ void orcm_pnp_base_check_trip_recvs(char *stringid,
                                  orcm_pnp_print_tag(reqcp->tag),
                                  orcm_pnp_print_channel(recvr->channel)));
         }
+        if (NULL != recvr) {
+            orcm_pnp_base_update_index(recvr);
+        }
         /* if we have any recvs now, ensure the channel is open */
         if (NULL != recvr && 0 < opal_list_get_size(&recvr->recvs)) {
             /* open the channel */
@@ -652,31 +1360,35 @@ void orcm_pnp_base_check_pending_recvs(orcm_triplet_t *trp,
 {
     int i;
     orcm_triplet_t *triplet;
+    opal_pointer_array_t matches;
+
+    OBJ_CONSTRUCT(&matches, opal_pointer_array_t);
+    opal_pointer_array_init(&matches, 8, INT_MAX, 8);
 
-    /* check the wildcard triplets and see if any match */
+    /* check the wildcard triplets that span this one */
     /* lock the global triplet arrays for our use */
     ORTE_ACQUIRE_THREAD(&orcm_triplets->ctl);
-    for (i=0; i < orcm_triplets->wildcards.size; i++) {
-        if (NULL == (triplet = (orcm_triplet_t*)opal_pointer_array_get_item(&orcm_triplets->wildcards, i))) {
+    orcm_triplet_get_matches(&trp->key, true, &matches);
+    for (i=0; i < matches.size; i++) {
+        if (NULL == (triplet = (orcm_triplet_t*)opal_pointer_array_get_item(&matches, i))) {
             continue;
         }
-        if (orcm_triplet_cmp(trp->string_id, triplet->string_id)) {
-            /* match found - copy the recvs to the appropriate list */
-            if (ORCM_PNP_INVALID_CHANNEL != grp->input) {
-                orcm_pnp_base_check_trip_recvs(triplet->string_id, &triplet->input_recvs, grp->input);
-            }
-            if (ORCM_PNP_INVALID_CHANNEL != grp->output) {
-                orcm_pnp_base_check_trip_recvs(triplet->string_id, &triplet->output_recvs, grp->output);
-            }
-            /* copy notification policies, if not already set */
-            if (ORCM_NOTIFY_NONE == trp->notify) {
-                trp->notify = triplet->notify;
-                trp->leader_cbfunc = triplet->leader_cbfunc;
-            }
+        /* copy the recvs to the appropriate list */
+        if (ORCM_PNP_INVALID_CHANNEL != grp->input) {
+            orcm_pnp_base_check_trip_recvs(triplet->string_id, &triplet->input_recvs, grp->input);
+        }
+        if (ORCM_PNP_INVALID_CHANNEL != grp->output) {
+            orcm_pnp_base_check_trip_recvs(triplet->string_id, &triplet->output_recvs, grp->output);
+        }
+        /* copy notification policies, if not already set */
+        if (ORCM_NOTIFY_NONE == trp->notify) {
+            trp->notify = triplet->notify;
+            trp->leader_cbfunc = triplet->leader_cbfunc;
         }
     }
     /* release the global arrays */
     ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
+    OBJ_DESTRUCT(&matches);
            
 
     /* check the triplet input_recv list */
@@ -726,7 +1438,9 @@ int orcm_pnp_base_record_recv(orcm_triplet_t *triplet,
                               orcm_pnp_channel_t channel,
                               orcm_pnp_tag_t tag,
                               orcm_pnp_callback_fn_t cbfunc,
-                              void *cbdata)
+                              orcm_pnp_stream_fn_t stream_cbfunc,
+                              void *cbdata,
+                              orcm_pnp_executor_t *executor)
 {
     orcm_pnp_request_t *req;
     orcm_pnp_channel_obj_t *chan;
@@ -739,29 +1453,33 @@ int orcm_pnp_base_record_recv(orcm_triplet_t *triplet,
          * wildcard string id
          */
         if (triplet == orcm_pnp_base.my_triplet) {
-            if (NULL != orcm_pnp_base_find_request(&triplet->input_recvs, ORCM_WILDCARD_STRING_ID, tag)) {
+            if (NULL != orcm_pnp_base_find_request(&triplet->input_recvs, &orcm_triplet_wildcard_key, tag)) {
                 /* already exists - nothing to do */
                 goto cleanup;
             }
             /* create it */
             req = OBJ_NEW(orcm_pnp_request_t);
-            req->string_id = strdup(ORCM_WILDCARD_STRING_ID);
+            orcm_pnp_base_set_request_id(req, ORCM_WILDCARD_STRING_ID);
             req->tag = tag;
             req->cbfunc = cbfunc;
+            req->stream_cbfunc = stream_cbfunc;
             req->cbdata = cbdata;
+            orcm_pnp_base_set_executor(req, executor);
             opal_list_append(&triplet->input_recvs, &req->super);
         } else {
             /* want the input from another triplet */
-            if (NULL != orcm_pnp_base_find_request(&triplet->input_recvs, triplet->string_id, tag)) {
+            if (NULL != orcm_pnp_base_find_request(&triplet->input_recvs, &triplet->key, tag)) {
                 /* already exists - nothing to do */
                 goto cleanup;
             }
             /* create it */
             req = OBJ_NEW(orcm_pnp_request_t);
-            req->string_id = strdup(triplet->string_id);
+            orcm_pnp_base_set_request_id(req, triplet->string_id);
             req->tag = tag;
             req->cbfunc = cbfunc;
+            req->stream_cbfunc = stream_cbfunc;
             req->cbdata = cbdata;
+            orcm_pnp_base_set_executor(req, executor);
             opal_list_append(&triplet->input_recvs, &req->super);
         }
         /* update channel recv info for all triplet-groups already known */
@@ -769,16 +1487,18 @@ int orcm_pnp_base_record_recv(orcm_triplet_t *triplet,
         goto cleanup;
     } else if (ORCM_PNP_GROUP_OUTPUT_CHANNEL == channel) {
         /* see if the request already exists on the triplet's output queue */
-        if (NULL != orcm_pnp_base_find_request(&triplet->output_recvs, triplet->string_id, tag)) {
+        if (NULL != orcm_pnp_base_find_request(&triplet->output_recvs, &triplet->key, tag)) {
             /* already exists - nothing to do */
             goto cleanup;
         }
         /* create it */
         req = OBJ_NEW(orcm_pnp_request_t);
-        req->string_id = strdup(triplet->string_id);
+        orcm_pnp_base_set_request_id(req, triplet->string_id);
         req->tag = tag;
         req->cbfunc = cbfunc;
+        req->stream_cbfunc = stream_cbfunc;
         req->cbdata = cbdata;
+        orcm_pnp_base_set_executor(req, executor);
         opal_list_append(&triplet->output_recvs, &req->super);
         /* update channel recv info for all triplet-groups already known */
         orcm_pnp_base_update_pending_recvs(triplet);
@@ -806,15 +1526,20 @@ int orcm_pnp_base_record_recv(orcm_triplet_t *triplet,
             }
             /* we have an exact match - update the cbfunc */
             req->cbfunc = cbfunc;
+            req->stream_cbfunc = stream_cbfunc;
+            orcm_pnp_base_set_executor(req, executor);
             goto proceed;
         }
         /* if we get here, then no exact match was found, so create a new entry */
         req = OBJ_NEW(orcm_pnp_request_t);
-        req->string_id = strdup(triplet->string_id);
+        orcm_pnp_base_set_request_id(req, triplet->string_id);
         req->tag = tag;
         req->cbfunc = cbfunc;
+        req->stream_cbfunc = stream_cbfunc;
         req->cbdata = cbdata;
+        orcm_pnp_base_set_executor(req, executor);
         opal_list_append(&chan->recvs, &req->super);
+        orcm_pnp_base_update_index(chan);
     }
 
  proceed:
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "opal/class/opal_list.h"
+#include "opal/sys/atomic.h"
+#include "opal/threads/mutex.h"
+#include "opal/util/output.h"
+
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "util/triplets.h"
+
+#include "mca/pnp/base/public.h"
+#include "mca/pnp/base/private.h"
+
+/*
+ * Each channel publishes an immutable snapshot of its recvs for use
+ * by the recv processing threads. Recvs against a specific triplet
+ * and tag are found by hashing on that pair, while the (usually few)
+ * recvs that involve a wildcard in either one are kept on a separate
+ * short list. Readers never lock - a writer builds a complete new
+ * snapshot and swaps it in. Snapshots that have been swapped out are
+ * retired instead of freed, so a reader still using one is never left
+ * dangling. Recvs change rarely, so the retired snapshots are simply
+ * held until the channel itself is released.
+ */
+struct orcm_pnp_recv_index_t {
+    struct orcm_pnp_recv_index_t *retired;
+    /* all recvs in the order they were registered - each is retained */
+    int num_recvs;
+    orcm_pnp_request_t **recvs;
+    orcm_triplet_handle_t *handles;
+    /* exact recvs, chained in registration order */
+    uint32_t mask;
+    int *buckets;
+    int *next;
+    /* positions of the wildcard recvs, in registration order */
+    int num_wildcards;
+    int *wildcards;
+};
+
+static inline uint32_t bucket_of(orcm_pnp_recv_index_t *idx,
+                                 orcm_triplet_handle_t handle,
+                                 orcm_pnp_tag_t tag)
+{
+    return (handle ^ ((uint32_t)tag * 2654435761U)) & idx->mask;
+}
+
+static bool is_wildcard(orcm_pnp_request_t *req)
+{
+    return (ORCM_PNP_TAG_WILDCARD == req->tag || 0 != req->key.wildcards);
+}
+
+static void release_index(orcm_pnp_recv_index_t *idx)
+{
+    int i;
+
+    for (i=0; i < idx->num_recvs; i++) {
+        OBJ_RELEASE(idx->recvs[i]);
+    }
+    if (NULL != idx->recvs) {
+        free(idx->recvs);
+    }
+    if (NULL != idx->handles) {
+        free(idx->handles);
+    }
+    if (NULL != idx->buckets) {
+        free(idx->buckets);
+    }
+    if (NULL != idx->next) {
+        free(idx->next);
+    }
+    if (NULL != idx->wildcards) {
+        free(idx->wildcards);
+    }
+    free(idx);
+}
+
+int orcm_pnp_base_update_index(orcm_pnp_channel_obj_t *chan)
+{
+    orcm_pnp_recv_index_t *idx, *old;
+    opal_list_item_t *item;
+    orcm_pnp_request_t *req;
+    uint32_t nbuckets, b;
+    int i, n;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.index_lock);
+
+    if (NULL == (idx = (orcm_pnp_recv_index_t*)calloc(1, sizeof(orcm_pnp_recv_index_t)))) {
+        goto error;
+    }
+    n = opal_list_get_size(&chan->recvs);
+
+    /* keep the load factor at or below 1/2 */
+    nbuckets = 8;
+    while (nbuckets < (uint32_t)(2*n)) {
+        nbuckets <<= 1;
+    }
+    idx->mask = nbuckets - 1;
+    idx->buckets = (int*)malloc(nbuckets * sizeof(int));
+    idx->recvs = (orcm_pnp_request_t**)malloc((n+1) * sizeof(orcm_pnp_request_t*));
+    idx->handles = (orcm_triplet_handle_t*)malloc((n+1) * sizeof(orcm_triplet_handle_t));
+    idx->next = (int*)malloc((n+1) * sizeof(int));
+    idx->wildcards = (int*)malloc((n+1) * sizeof(int));
+    if (NULL == idx->buckets || NULL == idx->recvs || NULL == idx->handles ||
+        NULL == idx->next || NULL == idx->wildcards) {
+        release_index(idx);
+        goto error;
+    }
+    for (b=0; b < nbuckets; b++) {
+        idx->buckets[b] = -1;
+    }
+
+    for (item = opal_list_get_first(&chan->recvs);
+         item != opal_list_get_end(&chan->recvs);
+         item = opal_list_get_next(item)) {
+        req = (orcm_pnp_request_t*)item;
+        OBJ_RETAIN(req);
+        i = idx->num_recvs++;
+        idx->recvs[i] = req;
+        idx->handles[i] = orcm_triplet_hash(req->string_id);
+        idx->next[i] = -1;
+        if (is_wildcard(req)) {
+            idx->wildcards[idx->num_wildcards++] = i;
+        }
+    }
+    /* chain the exact recvs - walk backwards so each chain
+     * ends up in registration order
+     */
+    for (i=idx->num_recvs-1; 0 <= i; i--) {
+        if (is_wildcard(idx->recvs[i])) {
+            continue;
+        }
+        b = bucket_of(idx, idx->handles[i], idx->recvs[i]->tag);
+        idx->next[i] = idx->buckets[b];
+        idx->buckets[b] = i;
+    }
+
+    /* make sure the snapshot is complete before anyone can see it */
+    opal_atomic_wmb();
+    old = chan->index;
+    chan->index = idx;
+    if (NULL != old) {
+        old->retired = chan->retired;
+        chan->retired = old;
+    }
+
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.index_lock);
+    return ORCM_SUCCESS;
+
+ error:
+    /* leave the old snapshot in place */
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.index_lock);
+    ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+    return ORCM_ERR_OUT_OF_RESOURCE;
+}
+
+/* add a recv to the caller's array of matches, growing it as needed */
+static int add_match(orcm_pnp_request_t ***recvs, int *size, int n,
+                     orcm_pnp_request_t *req)
+{
+    orcm_pnp_request_t **tmp;
+    int sz;
+
+    if (*size <= n) {
+        sz = (0 == *size) ? 4 : 2 * (*size);
+        if (NULL == (tmp = (orcm_pnp_request_t**)realloc(*recvs, sz * sizeof(orcm_pnp_request_t*)))) {
+            ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+            return n;
+        }
+        *recvs = tmp;
+        *size = sz;
+    }
+    (*recvs)[n] = req;
+    return n+1;
+}
+
+static inline bool wildcard_matches(orcm_pnp_request_t *req,
+                                    const orcm_triplet_key_t *key,
+                                    orcm_pnp_tag_t tag)
+{
+    return ((tag == req->tag || ORCM_PNP_TAG_WILDCARD == req->tag) &&
+            orcm_triplet_key_cmp(key, &req->key));
+}
+
+int orcm_pnp_base_lookup_requests(orcm_pnp_channel_obj_t *chan,
+                                  const orcm_triplet_key_t *key,
+                                  orcm_triplet_handle_t handle,
+                                  orcm_pnp_tag_t tag,
+                                  orcm_pnp_request_t ***recvs,
+                                  int *size)
+{
+    orcm_pnp_recv_index_t *idx;
+    orcm_pnp_request_t *req;
+    int i, w, n=0;
+
+    if (NULL == (idx = chan->index)) {
+        return 0;
+    }
+    opal_atomic_rmb();
+
+    if (0 != key->wildcards) {
+        /* the sender's triplet has a wildcard, so it could match
+         * any recv - check them all in order
+         */
+        for (i=0; i < idx->num_recvs; i++) {
+            if (wildcard_matches(idx->recvs[i], key, tag)) {
+                n = add_match(recvs, size, n, idx->recvs[i]);
+            }
+        }
+        return n;
+    }
+
+    /* merge the exact recvs for this triplet and tag with the
+     * wildcard recvs that match - both are already in the order
+     * they were registered
+     */
+    i = idx->buckets[bucket_of(idx, handle, tag)];
+    w = 0;
+    while (0 <= i || w < idx->num_wildcards) {
+        if (0 <= i && (idx->num_wildcards <= w || i < idx->wildcards[w])) {
+            req = idx->recvs[i];
+            if (handle == idx->handles[i] && tag == req->tag &&
+                orcm_triplet_key_cmp(key, &req->key)) {
+                n = add_match(recvs, size, n, req);
+            }
+            i = idx->next[i];
+        } else {
+            req = idx->recvs[idx->wildcards[w++]];
+            if (wildcard_matches(req, key, tag)) {
+                n = add_match(recvs, size, n, req);
+            }
+        }
+    }
+
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s MATCHED %d RECVS TO %s TAG %s",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), n, key->str,
+                         orcm_pnp_print_tag(tag)));
+    return n;
+}
+
+void orcm_pnp_base_release_index(orcm_pnp_channel_obj_t *chan)
+{
+    orcm_pnp_recv_index_t *idx;
+
+    if (NULL != chan->index) {
+        release_index(chan->index);
+        chan->index = NULL;
+    }
+    while (NULL != (idx = chan->retired)) {
+        chan->retired = idx->retired;
+        release_index(idx);
+    }
+}
@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#include "opal/class/opal_hash_table.h"
+#include "opal/dss/dss.h"
+#include "opal/sys/atomic.h"
+#include "opal/threads/mutex.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "mca/pnp/base/public.h"
+#include "mca/pnp/base/private.h"
+
+/*
+ * Metrics are kept per channel and tag in a table that only grows
+ * until close. Entries are found through a small direct-mapped cache
+ * without taking any lock - the table lock is only taken the first
+ * time a channel and tag are seen on a cache slot - and the counts in
+ * them are bumped atomically, so recording a msg never serializes the
+ * recv processing threads. A snapshot taken while msgs are flowing may
+ * be a msg or two out between fields.
+ */
+
+#define ORCM_PNP_METRICS_CACHE  256
+
+static orcm_pnp_metric_t * volatile cache[ORCM_PNP_METRICS_CACHE];
+
+static inline uint64_t metric_key(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag)
+{
+    return ((uint64_t)channel << 32) | (uint64_t)(uint32_t)tag;
+}
+
+static orcm_pnp_metric_t* get_metric(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag)
+{
+    orcm_pnp_metric_t *m;
+    uint32_t slot;
+    void *ptr;
+
+    slot = ((uint32_t)channel * 2654435761U ^ (uint32_t)tag) % ORCM_PNP_METRICS_CACHE;
+    if (NULL != (m = cache[slot])) {
+        opal_atomic_rmb();
+        if (m->data.channel == channel && m->data.tag == tag) {
+            return m;
+        }
+    }
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.metrics_lock);
+    if (OPAL_SUCCESS == opal_hash_table_get_value_uint64(&orcm_pnp_base.metrics_table,
+                                                         metric_key(channel, tag), &ptr)) {
+        m = (orcm_pnp_metric_t*)ptr;
+    } else {
+        m = OBJ_NEW(orcm_pnp_metric_t);
+        m->data.channel = channel;
+        m->data.tag = tag;
+        opal_hash_table_set_value_uint64(&orcm_pnp_base.metrics_table,
+                                         metric_key(channel, tag), m);
+    }
+    /* the entry stays put until close, so it can be handed out freely */
+    opal_atomic_wmb();
+    cache[slot] = m;
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.metrics_lock);
+    return m;
+}
+
+static int hist_bucket(uint64_t val)
+{
+    int e;
+
+    if (val < (1 << (ORCM_PNP_HIST_SUB_BITS+1))) {
+        return (int)val;
+    }
+    if (0xffffffffULL < val) {
+        val = 0xffffffffULL;
+    }
+    for (e=ORCM_PNP_HIST_SUB_BITS+1; (val >> (e+1)) != 0; e++);
+    return ((e - ORCM_PNP_HIST_SUB_BITS + 1) << ORCM_PNP_HIST_SUB_BITS) +
+        (int)((val >> (e - ORCM_PNP_HIST_SUB_BITS)) & ((1 << ORCM_PNP_HIST_SUB_BITS) - 1));
+}
+
+/* smallest value counted in a bucket, and the number of values it covers */
+static int64_t bucket_floor(int b, int64_t *width)
+{
+    int e;
+
+    if (b < (1 << (ORCM_PNP_HIST_SUB_BITS+1))) {
+        *width = 1;
+        return b;
+    }
+    e = (b >> ORCM_PNP_HIST_SUB_BITS) + ORCM_PNP_HIST_SUB_BITS - 1;
+    *width = (int64_t)1 << (e - ORCM_PNP_HIST_SUB_BITS);
+    return (int64_t)((1 << ORCM_PNP_HIST_SUB_BITS) + (b & ((1 << ORCM_PNP_HIST_SUB_BITS) - 1)))
+        << (e - ORCM_PNP_HIST_SUB_BITS);
+}
+
+static void hist_record(orcm_pnp_histogram_t *hist, uint64_t val)
+{
+    int64_t max;
+
+    opal_atomic_add_64(&hist->count, 1);
+    opal_atomic_add_64(&hist->sum, (int64_t)val);
+    while ((int64_t)val > (max = hist->max) &&
+           !opal_atomic_cmpset_64(&hist->max, max, (int64_t)val));
+    opal_atomic_add_64(&hist->buckets[hist_bucket(val)], 1);
+}
+
+int64_t orcm_pnp_histogram_percentile(const orcm_pnp_histogram_t *hist, double pct)
+{
+    int64_t target, seen=0, floor, width;
+    int b;
+
+    if (0 == hist->count) {
+        return 0;
+    }
+    target = (int64_t)((pct / 100.0) * (double)hist->count + 0.5);
+    if (target < 1) {
+        target = 1;
+    }
+    for (b=0; b < ORCM_PNP_HIST_BUCKETS; b++) {
+        seen += hist->buckets[b];
+        if (target <= seen) {
+            floor = bucket_floor(b, &width);
+            /* report the top of the bucket, but never beyond
+             * what was actually seen
+             */
+            return (hist->max < floor + width - 1) ? hist->max : floor + width - 1;
+        }
+    }
+    return hist->max;
+}
+
+uint64_t orcm_pnp_base_metrics_now(void)
+{
+    struct timeval tv;
+
+    if (!orcm_pnp_base.metrics) {
+        return 0;
+    }
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+}
+
+void orcm_pnp_base_metrics_in(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                              size_t bytes)
+{
+    orcm_pnp_metric_t *m;
+
+    if (!orcm_pnp_base.metrics) {
+        return;
+    }
+    m = get_metric(channel, tag);
+    opal_atomic_add_64(&m->data.msgs_in, 1);
+    opal_atomic_add_64(&m->data.bytes_in, (int64_t)bytes);
+}
+
+void orcm_pnp_base_metrics_out(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                               size_t bytes)
+{
+    orcm_pnp_metric_t *m;
+
+    if (!orcm_pnp_base.metrics) {
+        return;
+    }
+    m = get_metric(channel, tag);
+    opal_atomic_add_64(&m->data.msgs_out, 1);
+    opal_atomic_add_64(&m->data.bytes_out, (int64_t)bytes);
+}
+
+void orcm_pnp_base_metrics_drop(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                                int reason)
+{
+    orcm_pnp_metric_t *m;
+
+    if (!orcm_pnp_base.metrics) {
+        return;
+    }
+    m = get_metric(channel, tag);
+    if (ORCM_PNP_DROP_NOT_LEADER == reason) {
+        opal_atomic_add_64(&m->data.drops_not_leader, 1);
+    } else if (ORCM_PNP_DROP_OVERFLOW == reason) {
+        opal_atomic_add_64(&m->data.drops_overflow, 1);
+    } else {
+        opal_atomic_add_64(&m->data.drops_no_recv, 1);
+    }
+}
+
+void orcm_pnp_base_metrics_callback(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                                    uint64_t queued, uint64_t start, uint64_t end)
+{
+    orcm_pnp_metric_t *m;
+
+    if (!orcm_pnp_base.metrics || 0 == start) {
+        return;
+    }
+    m = get_metric(channel, tag);
+    if (0 != queued) {
+        hist_record(&m->data.latency, (queued < start) ? start - queued : 0);
+    }
+    hist_record(&m->data.callback, (start < end) ? end - start : 0);
+}
+
+static void get_depth(int32_t *depth, int32_t *max_depth)
+{
+    orcm_pnp_worker_t *worker;
+    int i;
+
+    *depth = 0;
+    *max_depth = 0;
+    if (NULL == orcm_pnp_base.workers) {
+        return;
+    }
+    for (i=0; i < orcm_pnp_base.num_workers; i++) {
+        worker = orcm_pnp_base.workers[i];
+        *depth += orcm_pnp_queue_depth(worker->queue);
+        if (*max_depth < worker->queue->max_depth) {
+            *max_depth = worker->queue->max_depth;
+        }
+        if (NULL != worker->control) {
+            *depth += orcm_pnp_queue_depth(worker->control);
+            if (*max_depth < worker->control->max_depth) {
+                *max_depth = worker->control->max_depth;
+            }
+        }
+    }
+}
+
+int orcm_pnp_get_metrics(orcm_pnp_metrics_t **metrics, int32_t *num,
+                         int32_t *depth, int32_t *max_depth,
+                         int32_t *exec_depth, int32_t *exec_max_depth)
+{
+    orcm_pnp_metric_t *m;
+    uint64_t key;
+    void *ptr, *node, *next;
+    int32_t n=0;
+    int rc;
+
+    *metrics = NULL;
+    *num = 0;
+    get_depth(depth, max_depth);
+    orcm_pnp_base_exec_depth(exec_depth, exec_max_depth);
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.metrics_lock);
+    if (0 == opal_hash_table_get_size(&orcm_pnp_base.metrics_table)) {
+        OPAL_THREAD_UNLOCK(&orcm_pnp_base.metrics_lock);
+        return ORCM_SUCCESS;
+    }
+    *metrics = (orcm_pnp_metrics_t*)malloc(opal_hash_table_get_size(&orcm_pnp_base.metrics_table) *
+                                           sizeof(orcm_pnp_metrics_t));
+    if (NULL == *metrics) {
+        OPAL_THREAD_UNLOCK(&orcm_pnp_base.metrics_lock);
+        return ORCM_ERR_OUT_OF_RESOURCE;
+    }
+    rc = opal_hash_table_get_first_key_uint64(&orcm_pnp_base.metrics_table,
+                                              &key, &ptr, &node);
+    while (OPAL_SUCCESS == rc) {
+        m = (orcm_pnp_metric_t*)ptr;
+        memcpy(&(*metrics)[n++], &m->data, sizeof(orcm_pnp_metrics_t));
+        rc = opal_hash_table_get_next_key_uint64(&orcm_pnp_base.metrics_table,
+                                                 &key, &ptr, node, &next);
+        node = next;
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.metrics_lock);
+    *num = n;
+    return ORCM_SUCCESS;
+}
+
+/* histograms are mostly empty, so only the used buckets are sent */
+static int pack_hist(opal_buffer_t *buf, orcm_pnp_histogram_t *hist)
+{
+    int32_t b, used=0;
+    int rc;
+
+    for (b=0; b < ORCM_PNP_HIST_BUCKETS; b++) {
+        if (0 < hist->buckets[b]) {
+            used++;
+        }
+    }
+    if (ORCM_SUCCESS != (rc = opal_dss.pack(buf, &hist->count, 1, OPAL_INT64)) ||
+        ORCM_SUCCESS != (rc = opal_dss.pack(buf, &hist->sum, 1, OPAL_INT64)) ||
+        ORCM_SUCCESS != (rc = opal_dss.pack(buf, &hist->max, 1, OPAL_INT64)) ||
+        ORCM_SUCCESS != (rc = opal_dss.pack(buf, &used, 1, OPAL_INT32))) {
+        return rc;
+    }
+    for (b=0; b < ORCM_PNP_HIST_BUCKETS; b++) {
+        if (0 == hist->buckets[b]) {
+            continue;
+        }
+        if (ORCM_SUCCESS != (rc = opal_dss.pack(buf, &b, 1, OPAL_INT32)) ||
+            ORCM_SUCCESS != (rc = opal_dss.pack(buf, &hist->buckets[b], 1, OPAL_INT64))) {
+            return rc;
+        }
+    }
+    return ORCM_SUCCESS;
+}
+
+static int unpack_hist(opal_buffer_t *buf, orcm_pnp_histogram_t *hist)
+{
+    int32_t b, i, used;
+    int n, rc;
+
+    memset(hist, 0, sizeof(orcm_pnp_histogram_t));
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &hist->count, &n, OPAL_INT64))) {
+        return rc;
+    }
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &hist->sum, &n, OPAL_INT64))) {
+        return rc;
+    }
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &hist->max, &n, OPAL_INT64))) {
+        return rc;
+    }
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &used, &n, OPAL_INT32))) {
+        return rc;
+    }
+    for (i=0; i < used; i++) {
+        n=1;
+        if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &b, &n, OPAL_INT32))) {
+            return rc;
+        }
+        if (b < 0 || ORCM_PNP_HIST_BUCKETS <= b) {
+            return ORCM_ERR_UNPACK_FAILURE;
+        }
+        n=1;
+        if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &hist->buckets[b], &n, OPAL_INT64))) {
+            return rc;
+        }
+    }
+    return ORCM_SUCCESS;
+}
+
+static int pack_metrics(opal_buffer_t *buf)
+{
+    orcm_pnp_metrics_t *metrics;
+    int32_t i, num, depth, max_depth, exec_depth, exec_max_depth;
+    int rc;
+
+    if (ORCM_SUCCESS != (rc = orcm_pnp_get_metrics(&metrics, &num, &depth, &max_depth,
+                                                   &exec_depth, &exec_max_depth))) {
+        return rc;
+    }
+    if (ORCM_SUCCESS != (rc = opal_dss.pack(buf, &depth, 1, OPAL_INT32)) ||
+        ORCM_SUCCESS != (rc = opal_dss.pack(buf, &max_depth, 1, OPAL_INT32)) ||
+        ORCM_SUCCESS != (rc = opal_dss.pack(buf, &exec_depth, 1, OPAL_INT32)) ||
+        ORCM_SUCCESS != (rc = opal_dss.pack(buf, &exec_max_depth, 1, OPAL_INT32)) ||
+        ORCM_SUCCESS != (rc = opal_dss.pack(buf, &num, 1, OPAL_INT32))) {
+        goto cleanup;
+    }
+    for (i=0; i < num; i++) {
+        if (ORCM_SUCCESS != (rc = opal_dss.pack(buf, &metrics[i].channel, 1, OPAL_UINT32)) ||
+            ORCM_SUCCESS != (rc = opal_dss.pack(buf, &metrics[i].tag, 1, ORCM_PNP_TAG_T)) ||
+            ORCM_SUCCESS != (rc = opal_dss.pack(buf, &metrics[i].msgs_in, 1, OPAL_INT64)) ||
+            ORCM_SUCCESS != (rc = opal_dss.pack(buf, &metrics[i].bytes_in, 1, OPAL_INT64)) ||
+            ORCM_SUCCESS != (rc = opal_dss.pack(buf, &metrics[i].msgs_out, 1, OPAL_INT64)) ||
+            ORCM_SUCCESS != (rc = opal_dss.pack(buf, &metrics[i].bytes_out, 1, OPAL_INT64)) ||
+            ORCM_SUCCESS != (rc = opal_dss.pack(buf, &metrics[i].drops_no_recv, 1, OPAL_INT64)) ||
+            ORCM_SUCCESS != (rc = opal_dss.pack(buf, &metrics[i].drops_not_leader, 1, OPAL_INT64)) ||
+            ORCM_SUCCESS != (rc = opal_dss.pack(buf, &metrics[i].drops_overflow, 1, OPAL_INT64)) ||
+            ORCM_SUCCESS != (rc = pack_hist(buf, &metrics[i].latency)) ||
+            ORCM_SUCCESS != (rc = pack_hist(buf, &metrics[i].callback))) {
+            goto cleanup;
+        }
+    }
+
+ cleanup:
+    if (NULL != metrics) {
+        free(metrics);
+    }
+    return rc;
+}
+
+int orcm_pnp_unpack_metrics(opal_buffer_t *buf,
+                            orcm_pnp_metrics_t **metrics, int32_t *num,
+                            int32_t *depth, int32_t *max_depth,
+                            int32_t *exec_depth, int32_t *exec_max_depth)
+{
+    orcm_pnp_metrics_t *m=NULL;
+    int64_t *counts[7];
+    int32_t i, cnt;
+    int j, n, rc;
+
+    *metrics = NULL;
+    *num = 0;
+
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, depth, &n, OPAL_INT32))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, max_depth, &n, OPAL_INT32))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, exec_depth, &n, OPAL_INT32))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, exec_max_depth, &n, OPAL_INT32))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    n=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &cnt, &n, OPAL_INT32))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    if (cnt <= 0) {
+        return ORCM_SUCCESS;
+    }
+    if (NULL == (m = (orcm_pnp_metrics_t*)calloc(cnt, sizeof(orcm_pnp_metrics_t)))) {
+        return ORCM_ERR_OUT_OF_RESOURCE;
+    }
+    for (i=0; i < cnt; i++) {
+        n=1;
+        if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &m[i].channel, &n, OPAL_UINT32))) {
+            goto error;
+        }
+        n=1;
+        if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &m[i].tag, &n, ORCM_PNP_TAG_T))) {
+            goto error;
+        }
+        counts[0] = &m[i].msgs_in;
+        counts[1] = &m[i].bytes_in;
+        counts[2] = &m[i].msgs_out;
+        counts[3] = &m[i].bytes_out;
+        counts[4] = &m[i].drops_no_recv;
+        counts[5] = &m[i].drops_not_leader;
+        counts[6] = &m[i].drops_overflow;
+        for (j=0; j < 7; j++) {
+            n=1;
+            if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, counts[j], &n, OPAL_INT64))) {
+                goto error;
+            }
+        }
+        if (ORCM_SUCCESS != (rc = unpack_hist(buf, &m[i].latency)) ||
+            ORCM_SUCCESS != (rc = unpack_hist(buf, &m[i].callback))) {
+            goto error;
+        }
+    }
+    *metrics = m;
+    *num = cnt;
+    return ORCM_SUCCESS;
+
+ error:
+    ORTE_ERROR_LOG(rc);
+    free(m);
+    return rc;
+}
+
+static void reply_cbfunc(int status,
+                         orte_process_name_t *sender,
+                         orcm_pnp_tag_t tag,
+                         struct iovec *msg,
+                         int count,
+                         opal_buffer_t *buffer,
+                         void *cbdata)
+{
+    OBJ_RELEASE(buffer);
+}
+
+void orcm_pnp_base_answer_metrics(orte_process_name_t *requestor)
+{
+    opal_buffer_t *buf;
+    int rc;
+
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:base:sending metrics to %s",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                         ORTE_NAME_PRINT(requestor)));
+
+    buf = OBJ_NEW(opal_buffer_t);
+    if (ORCM_SUCCESS != (rc = pack_metrics(buf))) {
+        ORTE_ERROR_LOG(rc);
+        OBJ_RELEASE(buf);
+        return;
+    }
+    /* the callback releases the buffer */
+    if (ORCM_SUCCESS != (rc = orcm_pnp.output_nb(ORCM_PNP_DIRECT_CHANNEL, requestor,
+                                                 ORCM_PNP_TAG_METRICS_REPLY,
+                                                 NULL, 0, buf, reply_cbfunc, NULL))) {
+        if (ORTE_ERR_COMM_DISABLED != rc) {
+            ORTE_ERROR_LOG(rc);
+        }
+        OBJ_RELEASE(buf);
+    }
+}
+
+void orcm_pnp_base_release_metrics(void)
+{
+    uint64_t key;
+    void *ptr, *node, *next;
+    int rc;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.metrics_lock);
+    memset((void*)cache, 0, sizeof(cache));
+    rc = opal_hash_table_get_first_key_uint64(&orcm_pnp_base.metrics_table,
+                                              &key, &ptr, &node);
+    while (OPAL_SUCCESS == rc) {
+        OBJ_RELEASE(ptr);
+        rc = opal_hash_table_get_next_key_uint64(&orcm_pnp_base.metrics_table,
+                                                 &key, &ptr, node, &next);
+        node = next;
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.metrics_lock);
+}
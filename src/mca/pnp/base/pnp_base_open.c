@@ -10,8 +10,18 @@
 #include "openrcm_config_private.h"
 #include "include/constants.h"
 
+#include <string.h>
+#include <stdlib.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 #include "opal/class/opal_list.h"
 #include "opal/class/opal_pointer_array.h"
+#include "opal/util/argv.h"
 #include "opal/util/output.h"
 #include "opal/mca/mca.h"
 #include "opal/mca/base/base.h"
@@ -20,12 +30,22 @@
 #include "orte/mca/rml/rml_types.h"
 #include "orte/mca/rmcast/rmcast_types.h"
 
+#include "util/triplets.h"
+
 #include "mca/pnp/pnp.h"
 #include "mca/pnp/base/public.h"
 #include "mca/pnp/base/private.h"
 
 /* instantiate the module */
 orcm_pnp_base_module_t orcm_pnp = {
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
     NULL,
     NULL,
     NULL,
@@ -43,7 +63,8 @@ orcm_pnp_base_t orcm_pnp_base;
 
 int orcm_pnp_base_open(void)
 {
-    int tmp;
+    int tmp, i;
+    char *str, **channels;
 
     /* Debugging / verbose output.  Always have stream open, with
      * verbose set by the mca open system...
@@ -51,17 +72,241 @@ int orcm_pnp_base_open(void)
     orcm_pnp_base.output = opal_output_open(NULL);
     
     /* initialize globals */
-    OBJ_CONSTRUCT(&orcm_pnp_base.recv_process, opal_thread_t);
-    OBJ_CONSTRUCT(&orcm_pnp_base.recv_process_ctl, orte_thread_ctl_t);
     orcm_pnp_base.my_string_id = NULL;
+    orcm_pnp_base.my_handle = ORCM_TRIPLET_HANDLE_INVALID;
     orcm_pnp_base.my_announce_cbfunc = NULL;
     orcm_pnp_base.my_input_channel = NULL;
     orcm_pnp_base.my_output_channel = NULL;
     /* init the array of channels */
     OBJ_CONSTRUCT(&orcm_pnp_base.channels, opal_pointer_array_t);
     opal_pointer_array_init(&orcm_pnp_base.channels, 8, INT_MAX, 8);
+    OBJ_CONSTRUCT(&orcm_pnp_base.index_lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&orcm_pnp_base.reply_lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&orcm_pnp_base.replies, opal_list_t);
+    orcm_pnp_base.reply_seed = (unsigned int)getpid();
+    OBJ_CONSTRUCT(&orcm_pnp_base.window_lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&orcm_pnp_base.channel_windows, opal_hash_table_t);
+    opal_hash_table_init(&orcm_pnp_base.channel_windows, 32);
+    OBJ_CONSTRUCT(&orcm_pnp_base.peer_windows, opal_hash_table_t);
+    opal_hash_table_init(&orcm_pnp_base.peer_windows, 128);
+    OBJ_CONSTRUCT(&orcm_pnp_base.batch_lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&orcm_pnp_base.batches, opal_hash_table_t);
+    opal_hash_table_init(&orcm_pnp_base.batches, 32);
+    orcm_pnp_base.next_stream = 0;
+    OBJ_CONSTRUCT(&orcm_pnp_base.stream_lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&orcm_pnp_base.reassembly, opal_list_t);
+    OBJ_CONSTRUCT(&orcm_pnp_base.compress_lock, opal_mutex_t);
+    memset(&orcm_pnp_base.compress_stats, 0, sizeof(orcm_pnp_compress_stats_t));
+    orcm_pnp_base.num_compress_channels = 0;
+    orcm_pnp_base.compress_channels = NULL;
+    OBJ_CONSTRUCT(&orcm_pnp_base.metrics_lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&orcm_pnp_base.metrics_table, opal_hash_table_t);
+    opal_hash_table_init(&orcm_pnp_base.metrics_table, 64);
+    OBJ_CONSTRUCT(&orcm_pnp_base.shm_lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&orcm_pnp_base.shm_peers, opal_hash_table_t);
+    opal_hash_table_init(&orcm_pnp_base.shm_peers, 128);
     orcm_pnp_base.comm_enabled = false;
+    orcm_pnp_base.workers = NULL;
+    OBJ_CONSTRUCT(&orcm_pnp_base.exec_lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&orcm_pnp_base.executors, opal_pointer_array_t);
+    opal_pointer_array_init(&orcm_pnp_base.executors, 8, INT_MAX, 8);
+    orcm_pnp_base.exec_pool = NULL;
+    OBJ_CONSTRUCT(&orcm_pnp_base.req_lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&orcm_pnp_base.req_cond, opal_condition_t);
+    orcm_pnp_base.req_waiters = 0;
+
+    /* size of the queue holding recvd msgs for the processing thread */
+    mca_base_param_reg_int_name("pnp", "base_recv_queue_size",
+                                "Max number of recvd messages that can be waiting for processing (rounded up to a power of two)",
+                                false, false, ORCM_PNP_QUEUE_SIZE, &tmp);
+    if (tmp < 2) {
+        tmp = ORCM_PNP_QUEUE_SIZE;
+    }
+    orcm_pnp_base.recv_queue_size = tmp;
+
+    /* number of msgs to drain from the queue in one pass */
+    mca_base_param_reg_int_name("pnp", "base_recv_batch_size",
+                                "Max number of recvd messages the processing thread pulls from its queue in one pass",
+                                false, false, ORCM_PNP_MAX_MSGS, &tmp);
+    if (tmp < 1) {
+        tmp = ORCM_PNP_MAX_MSGS;
+    }
+    orcm_pnp_base.recv_batch_size = tmp;
+
+    /* number of recv processing threads */
+    mca_base_param_reg_int_name("pnp", "base_recv_threads",
+                                "Number of threads processing recvd messages - messages from any one sender are always processed in order (default: 1)",
+                                false, false, 1, &tmp);
+    if (tmp < 1) {
+        tmp = 1;
+    }
+    orcm_pnp_base.num_workers = tmp;
+
+    /* whether the app or a thread of our own processes recvd msgs */
+    mca_base_param_reg_int_name("pnp", "base_recv_progress",
+                                "Leave recvd messages for the app to process by calling progress when the fd it is given becomes readable, instead of starting processing threads (default: no)",
+                                false, false, (int)false, &tmp);
+    orcm_pnp_base.recv_progress = OPAL_INT_TO_BOOL(tmp);
+    if (orcm_pnp_base.recv_progress) {
+        /* there is only the one caller to drain the queue */
+        orcm_pnp_base.num_workers = 1;
+    }
+
+    /* whether or not to deliver control msgs ahead of data */
+    mca_base_param_reg_int_name("pnp", "base_recv_priority",
+                                "Deliver heartbeat, errmgr, announce and other control messages ahead of data messages waiting to be processed (default: yes)",
+                                false, false, (int)true, &tmp);
+    orcm_pnp_base.recv_priority = OPAL_INT_TO_BOOL(tmp);
+    mca_base_param_reg_int_name("pnp", "base_recv_priority_weight",
+                                "Number of consecutive passes over waiting control messages after which one pass is made over waiting data messages (0 => control messages are always taken first, default: 4)",
+                                false, false, 4, &tmp);
+    orcm_pnp_base.recv_priority_weight = (tmp < 0) ? 0 : tmp;
+
+    /* whether or not to take over recvd buffers instead of copying them */
+    mca_base_param_reg_int_name("pnp", "base_zero_copy",
+                                "Take ownership of recvd message buffers instead of copying them (default: yes)",
+                                false, false, (int)true, &tmp);
+    orcm_pnp_base.zero_copy = OPAL_INT_TO_BOOL(tmp);
+
+    /* whether or not to answer announcements with a roster */
+    mca_base_param_reg_int_name("pnp", "base_announce_roster",
+                                "Answer each announcement with a single roster from the scheduler or the lowest live rank of each job instead of a reply from every peer (default: no)",
+                                false, false, (int)false, &tmp);
+    orcm_pnp_base.roster = OPAL_INT_TO_BOOL(tmp);
+
+    /* how long everyone else waits for that roster */
+    mca_base_param_reg_int_name("pnp", "base_announce_delay",
+                                "Max msecs a peer waits, when rosters are in use, for a roster naming it before answering an announcement itself - the actual delay is randomized (0 => never answer, default: 250)",
+                                false, false, 250, &tmp);
+    if (tmp < 0) {
+        tmp = 0;
+    }
+    orcm_pnp_base.reply_delay = tmp;
+
+    /* limits on non-blocking sends in flight */
+    mca_base_param_reg_int_name("pnp", "base_send_window_msgs",
+                                "Max number of non-blocking sends in flight to any one channel or peer (0 => no limit, default: 0)",
+                                false, false, 0, &tmp);
+    orcm_pnp_base.window_msgs = (tmp < 0) ? 0 : tmp;
+    mca_base_param_reg_int_name("pnp", "base_send_window_bytes",
+                                "Max number of bytes of non-blocking sends in flight to any one channel or peer (0 => no limit, default: 0)",
+                                false, false, 0, &tmp);
+    orcm_pnp_base.window_bytes = (tmp < 0) ? 0 : tmp;
+    orcm_pnp_base.send_window = (0 < orcm_pnp_base.window_msgs || 0 < orcm_pnp_base.window_bytes);
+
+    mca_base_param_reg_int_name("pnp", "base_send_window_policy",
+                                "What to do with a non-blocking send that would overflow its window: 0 => wait for room, 1 => park it and drop the oldest parked send when the backlog is full, 2 => hand it back through its callback with ORCM_ERR_WOULD_BLOCK (default: 0)",
+                                false, false, ORCM_PNP_WINDOW_BLOCK, &tmp);
+    if (tmp < ORCM_PNP_WINDOW_BLOCK || ORCM_PNP_WINDOW_EAGAIN < tmp) {
+        tmp = ORCM_PNP_WINDOW_BLOCK;
+    }
+    orcm_pnp_base.window_policy = tmp;
+
+    mca_base_param_reg_int_name("pnp", "base_send_window_backlog",
+                                "Max number of sends parked per channel or peer under the drop-oldest policy (default: 64)",
+                                false, false, 64, &tmp);
+    orcm_pnp_base.window_backlog = (tmp < 1) ? 1 : tmp;
+
+    /* coalescing of msgs sent with output_batch */
+    mca_base_param_reg_int_name("pnp", "base_batch_size",
+                                "Max number of bytes of batched msgs packed into one frame (default: 8192)",
+                                false, false, 8192, &tmp);
+    orcm_pnp_base.batch_size = (tmp < 1) ? 1 : tmp;
+    mca_base_param_reg_int_name("pnp", "base_batch_timeout",
+                                "Max usecs a batched msg waits for its frame to fill (0 => until the frame fills or is flushed, default: 1000)",
+                                false, false, 1000, &tmp);
+    orcm_pnp_base.batch_timeout = (tmp < 0) ? 0 : tmp;
+
+    /* streaming of large msgs */
+    mca_base_param_reg_int_name("pnp", "base_fragment_size",
+                                "Max number of bytes of a streamed msg carried by each fragment (default: 65536)",
+                                false, false, 65536, &tmp);
+    orcm_pnp_base.fragment_size = (tmp < 1024) ? 1024 : tmp;
+    mca_base_param_reg_int_name("pnp", "base_stream_depth",
+                                "Max number of fragments of a streamed msg in flight at once (default: 4)",
+                                false, false, 4, &tmp);
+    orcm_pnp_base.stream_depth = (tmp < 1) ? 1 : tmp;
+    mca_base_param_reg_int_name("pnp", "base_stream_max_size",
+                                "Max size in MB of a streamed msg that will be reassembled for a regular recv - larger ones are dropped (default: 1024)",
+                                false, false, 1024, &tmp);
+    orcm_pnp_base.stream_max_size = (int64_t)((tmp < 1) ? 1 : tmp) << 20;
+    mca_base_param_reg_int_name("pnp", "base_stream_timeout",
+                                "Secs a partly reassembled streamed msg may go without a fragment before it is dropped (0 => never, default: 60)",
+                                false, false, 60, &tmp);
+    orcm_pnp_base.stream_timeout = (tmp < 0) ? 0 : tmp;
+
+    /* payload compression */
+    mca_base_param_reg_int_name("pnp", "base_compress_threshold",
+                                "Compress buffer payloads of at least this many bytes (0 => never, default: 0)",
+                                false, false, 0, &tmp);
+    orcm_pnp_base.compress_threshold = (tmp < 0) ? 0 : tmp;
+    mca_base_param_reg_string_name("pnp", "base_compress_channels",
+                                   "Comma-separated list of channels whose payloads are compressed (default: all)",
+                                   false, false, NULL, &str);
+    if (NULL != str) {
+        channels = opal_argv_split(str, ',');
+        orcm_pnp_base.num_compress_channels = opal_argv_count(channels);
+        if (0 < orcm_pnp_base.num_compress_channels) {
+            orcm_pnp_base.compress_channels = (orcm_pnp_channel_t*)malloc(orcm_pnp_base.num_compress_channels *
+                                                                          sizeof(orcm_pnp_channel_t));
+            for (i=0; i < orcm_pnp_base.num_compress_channels; i++) {
+                orcm_pnp_base.compress_channels[i] = strtoul(channels[i], NULL, 10);
+            }
+        }
+        opal_argv_free(channels);
+        free(str);
+    }
+
+    /* traffic metrics */
+    mca_base_param_reg_int_name("pnp", "base_metrics",
+                                "Keep counts of the msgs and bytes sent and recvd on each channel and tag, along with histograms of recv latency and callback time - costs a clock read per msg and callback (default: no)",
+                                false, false, (int)false, &tmp);
+    orcm_pnp_base.metrics = OPAL_INT_TO_BOOL(tmp);
+
+    /* shared memory transport for direct msgs */
+    mca_base_param_reg_int_name("pnp", "base_shm",
+                                "Send direct msgs to procs on the same node through shared memory instead of RML - the callback of such a msg then fires before output_nb returns (default: no)",
+                                false, false, (int)false, &tmp);
+    orcm_pnp_base.shm = OPAL_INT_TO_BOOL(tmp);
+    mca_base_param_reg_int_name("pnp", "base_shm_size",
+                                "Number of bytes in each proc's shared memory ring, rounded up to a power of two - larger msgs pass through it in pieces (default: 1048576)",
+                                false, false, 1048576, &tmp);
+    if (tmp < 65536) {
+        tmp = 65536;
+    }
+    orcm_pnp_base.shm_size = 65536;
+    while (orcm_pnp_base.shm_size < tmp && orcm_pnp_base.shm_size < (1 << 30)) {
+        orcm_pnp_base.shm_size <<= 1;
+    }
+
+    /* object pools */
+    mca_base_param_reg_int_name("pnp", "base_pool_size",
+                                "Max number of send and recv objects, and of msg buffers of each size, kept for reuse instead of being freed - 0 => no pooling (default: 256)",
+                                false, false, 256, &tmp);
+    orcm_pnp_base.pool_size = (tmp < 0) ? 0 : tmp;
+    orcm_pnp_base_init_pools();
 
+    /* recv executors */
+    mca_base_param_reg_int_name("pnp", "base_exec_queue_size",
+                                "Max number of msgs that can be waiting on each recv executor thread (rounded up to a power of two)",
+                                false, false, ORCM_PNP_QUEUE_SIZE, &tmp);
+    if (tmp < 2) {
+        tmp = ORCM_PNP_QUEUE_SIZE;
+    }
+    orcm_pnp_base.exec_queue_size = tmp;
+
+    mca_base_param_reg_int_name("pnp", "base_exec_policy",
+                                "What to do with a msg for a recv whose executor queue is full - 0 => hold it until there is room, 1 => drop the msg (default: 0)",
+                                false, false, ORCM_PNP_EXEC_BLOCK, &tmp);
+    orcm_pnp_base.exec_policy = (ORCM_PNP_EXEC_DROP == tmp) ? ORCM_PNP_EXEC_DROP : ORCM_PNP_EXEC_BLOCK;
+
+    mca_base_param_reg_int_name("pnp", "base_exec_pool_threads",
+                                "Number of threads in the executor shared by recvs registered for pooled callbacks (default: 4)",
+                                false, false, 4, &tmp);
+    if (tmp < 1) {
+        tmp = 1;
+    }
+    orcm_pnp_base.exec_pool_threads = tmp;
 
     /* Open up all available components */
     if (ORCM_SUCCESS != 
@@ -79,11 +324,15 @@ static void channel_constructor(orcm_pnp_channel_obj_t *ptr)
 {
     ptr->channel = ORCM_PNP_INVALID_CHANNEL;
     OBJ_CONSTRUCT(&ptr->recvs, opal_list_t);
+    ptr->index = NULL;
+    ptr->retired = NULL;
 }
 static void channel_destructor(orcm_pnp_channel_obj_t *ptr)
 {
     opal_list_item_t *item;
 
+    orcm_pnp_base_release_index(ptr);
+
     while (NULL != (item = opal_list_remove_first(&ptr->recvs))) {
         OBJ_RELEASE(item);
     }
@@ -97,15 +346,21 @@ OBJ_CLASS_INSTANCE(orcm_pnp_channel_obj_t,
 static void request_constructor(orcm_pnp_request_t *ptr)
 {
     ptr->string_id = NULL;
+    ptr->key.str = NULL;
+    ptr->key.wildcards = 0;
     ptr->tag = ORCM_PNP_TAG_WILDCARD;
     ptr->cbfunc = NULL;
+    ptr->stream_cbfunc = NULL;
     ptr->cbdata = NULL;
+    ptr->executor = NULL;
 }
 static void request_destructor(orcm_pnp_request_t *ptr)
 {
     if (NULL != ptr->string_id) {
         free(ptr->string_id);
     }
+    orcm_pnp_base_set_executor(ptr, NULL);
+    orcm_triplet_key_release(&ptr->key);
 }
 /* no destruct required here */
 OBJ_CLASS_INSTANCE(orcm_pnp_request_t,
@@ -127,32 +382,262 @@ static void send_constructor(orcm_pnp_send_t *ptr)
     ptr->cbfunc = NULL;
     ptr->buffer = NULL;
     ptr->cbdata = NULL;
+    ptr->hdr = NULL;
+    ptr->iovs = NULL;
+    ptr->multicast = false;
+    ptr->bytes = 0;
+    ptr->window = NULL;
+    ptr->req = NULL;
 }
 static void send_destructor(orcm_pnp_send_t *ptr)
 {
     OBJ_DESTRUCT(&ptr->lock);
     OBJ_DESTRUCT(&ptr->cond);
+    if (NULL != ptr->hdr) {
+        OBJ_RELEASE(ptr->hdr);
+    }
+    if (NULL != ptr->iovs) {
+        free(ptr->iovs);
+    }
+    if (NULL != ptr->req) {
+        OBJ_RELEASE(ptr->req);
+    }
 }
 OBJ_CLASS_INSTANCE(orcm_pnp_send_t,
                    opal_list_item_t,
                    send_constructor,
                    send_destructor);
 
+static void send_req_constructor(orcm_pnp_send_req_t *ptr)
+{
+    ptr->complete = false;
+    ptr->status = ORCM_SUCCESS;
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_send_req_t,
+                   opal_object_t,
+                   send_req_constructor,
+                   NULL);
+
+static void worker_constructor(orcm_pnp_worker_t *ptr)
+{
+    ptr->idx = -1;
+    OBJ_CONSTRUCT(&ptr->thread, opal_thread_t);
+    OBJ_CONSTRUCT(&ptr->ctl, orte_thread_ctl_t);
+    ptr->queue = NULL;
+    ptr->control = NULL;
+}
+static void worker_destructor(orcm_pnp_worker_t *ptr)
+{
+    OBJ_DESTRUCT(&ptr->thread);
+    OBJ_DESTRUCT(&ptr->ctl);
+    /* the control queue wakes the thread through the data queue */
+    if (NULL != ptr->control) {
+        OBJ_RELEASE(ptr->control);
+    }
+    if (NULL != ptr->queue) {
+        OBJ_RELEASE(ptr->queue);
+    }
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_worker_t,
+                   opal_object_t,
+                   worker_constructor,
+                   worker_destructor);
+
+static void executor_constructor(orcm_pnp_executor_t *ptr)
+{
+    ptr->num_workers = 0;
+    ptr->workers = NULL;
+    ptr->lanes = NULL;
+    ptr->users = 0;
+    ptr->shared = false;
+    ptr->stopped = false;
+    ptr->idx = -1;
+}
+static void executor_destructor(orcm_pnp_executor_t *ptr)
+{
+    int i;
+
+    /* its threads have all exited by now */
+    orcm_pnp_base_exec_release_lanes(ptr);
+    for (i=0; i < ptr->num_workers; i++) {
+        OBJ_RELEASE(ptr->workers[i]);
+    }
+    if (NULL != ptr->workers) {
+        free(ptr->workers);
+    }
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_executor_t,
+                   opal_object_t,
+                   executor_constructor,
+                   executor_destructor);
+
 static void msg_constructor(orcm_pnp_msg_t *ptr)
 {
     ptr->sender.jobid = ORTE_JOBID_INVALID;
     ptr->sender.vpid = ORTE_VPID_INVALID;
+    ptr->queued = 0;
     OBJ_CONSTRUCT(&ptr->buf, opal_buffer_t);
+    ptr->recvs = NULL;
+    ptr->max_recvs = 0;
 }
 static void msg_destructor(orcm_pnp_msg_t *ptr)
 {
     OBJ_DESTRUCT(&ptr->buf);
+    if (NULL != ptr->recvs) {
+        free(ptr->recvs);
+    }
 }
 OBJ_CLASS_INSTANCE(orcm_pnp_msg_t,
                    opal_list_item_t,
                    msg_constructor,
                    msg_destructor);
 
+static void window_constructor(orcm_pnp_window_t *ptr)
+{
+    OBJ_CONSTRUCT(&ptr->lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&ptr->cond, opal_condition_t);
+    ptr->msgs = 0;
+    ptr->bytes = 0;
+    OBJ_CONSTRUCT(&ptr->backlog, opal_list_t);
+}
+static void window_destructor(orcm_pnp_window_t *ptr)
+{
+    opal_list_item_t *item;
+
+    OBJ_DESTRUCT(&ptr->lock);
+    OBJ_DESTRUCT(&ptr->cond);
+    while (NULL != (item = opal_list_remove_first(&ptr->backlog))) {
+        OBJ_RELEASE(item);
+    }
+    OBJ_DESTRUCT(&ptr->backlog);
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_window_t,
+                   opal_object_t,
+                   window_constructor,
+                   window_destructor);
+
+static void stream_constructor(orcm_pnp_stream_t *ptr)
+{
+    OBJ_CONSTRUCT(&ptr->lock, opal_mutex_t);
+    ptr->id = 0;
+    ptr->multicast = false;
+    ptr->channel = ORCM_PNP_INVALID_CHANNEL;
+    ptr->target.jobid = ORTE_JOBID_INVALID;
+    ptr->target.vpid = ORTE_VPID_INVALID;
+    ptr->tag = ORCM_PNP_TAG_INVALID;
+    ptr->msg = NULL;
+    ptr->count = 0;
+    ptr->buffer = NULL;
+    ptr->cbfunc = NULL;
+    ptr->cbdata = NULL;
+    ptr->iov = NULL;
+    ptr->niov = 0;
+    ptr->cur = 0;
+    ptr->off = 0;
+    ptr->total = 0;
+    ptr->sent = 0;
+    ptr->inflight = 0;
+    ptr->status = ORCM_SUCCESS;
+    ptr->pumping = false;
+    ptr->complete = false;
+}
+static void stream_destructor(orcm_pnp_stream_t *ptr)
+{
+    OBJ_DESTRUCT(&ptr->lock);
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_stream_t,
+                   opal_object_t,
+                   stream_constructor,
+                   stream_destructor);
+
+static void reassembly_constructor(orcm_pnp_reassembly_t *ptr)
+{
+    ptr->sender.jobid = ORTE_JOBID_INVALID;
+    ptr->sender.vpid = ORTE_VPID_INVALID;
+    ptr->id = 0;
+    ptr->total = 0;
+    ptr->buf = OBJ_NEW(opal_buffer_t);
+    ptr->last = 0;
+}
+static void reassembly_destructor(orcm_pnp_reassembly_t *ptr)
+{
+    if (NULL != ptr->buf) {
+        OBJ_RELEASE(ptr->buf);
+    }
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_reassembly_t,
+                   opal_list_item_t,
+                   reassembly_constructor,
+                   reassembly_destructor);
+
+static void batch_constructor(orcm_pnp_batch_t *ptr)
+{
+    OBJ_CONSTRUCT(&ptr->lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&ptr->send_lock, opal_mutex_t);
+    ptr->channel = ORCM_PNP_INVALID_CHANNEL;
+    ptr->frame = NULL;
+    ptr->tag = ORCM_PNP_TAG_INVALID;
+    ptr->timer_active = false;
+}
+static void batch_destructor(orcm_pnp_batch_t *ptr)
+{
+    if (ptr->timer_active) {
+        opal_event_evtimer_del(&ptr->ev);
+    }
+    OBJ_DESTRUCT(&ptr->lock);
+    OBJ_DESTRUCT(&ptr->send_lock);
+    if (NULL != ptr->frame) {
+        OBJ_RELEASE(ptr->frame);
+    }
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_batch_t,
+                   opal_object_t,
+                   batch_constructor,
+                   batch_destructor);
+
+static void metric_constructor(orcm_pnp_metric_t *ptr)
+{
+    memset(&ptr->data, 0, sizeof(orcm_pnp_metrics_t));
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_metric_t,
+                   opal_object_t,
+                   metric_constructor,
+                   NULL);
+
+static void shm_peer_constructor(orcm_pnp_shm_peer_t *ptr)
+{
+    ptr->seg = NULL;
+    ptr->len = 0;
+    ptr->fifo = -1;
+}
+static void shm_peer_destructor(orcm_pnp_shm_peer_t *ptr)
+{
+#ifdef HAVE_SYS_MMAN_H
+    if (NULL != ptr->seg) {
+        munmap(ptr->seg, ptr->len);
+    }
+#endif
+    if (0 <= ptr->fifo) {
+        close(ptr->fifo);
+    }
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_shm_peer_t,
+                   opal_object_t,
+                   shm_peer_constructor,
+                   shm_peer_destructor);
+
+static void reply_constructor(orcm_pnp_reply_t *ptr)
+{
+    ptr->announcer.jobid = ORTE_JOBID_INVALID;
+    ptr->announcer.vpid = ORTE_VPID_INVALID;
+    ptr->channel = ORCM_PNP_INVALID_CHANNEL;
+    ptr->cancelled = false;
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_reply_t,
+                   opal_list_item_t,
+                   reply_constructor,
+                   NULL);
+
 static void info_constructor(orcm_info_t *ptr)
 {
     ptr->app = NULL;
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "opal/dss/dss.h"
+#include "opal/threads/mutex.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/rml/rml_types.h"
+#include "orte/mca/rmcast/rmcast_types.h"
+
+#include "mca/pnp/base/public.h"
+#include "mca/pnp/base/private.h"
+
+/*
+ * Sends and recvd msgs are allocated on one thread and released on
+ * another - sends by the caller and the transport, recvs by the
+ * transport and the processing threads - so each pool is shared by
+ * all threads. The lock is only held to push or pop a pointer.
+ */
+
+/* most memory a pooled buffer of each class may hold */
+static const size_t buffer_class_size[ORCM_PNP_POOL_BUF_CLASSES] = {
+    1024,
+    16384,
+    262144
+};
+
+static void init_pool(orcm_pnp_pool_t *pool)
+{
+    OBJ_CONSTRUCT(&pool->lock, opal_mutex_t);
+    pool->num = 0;
+    pool->items = NULL;
+    if (0 < orcm_pnp_base.pool_size) {
+        pool->items = (void**)malloc(orcm_pnp_base.pool_size * sizeof(void*));
+    }
+}
+
+static void* pool_get(orcm_pnp_pool_t *pool)
+{
+    void *item=NULL;
+
+    if (NULL == pool->items) {
+        return NULL;
+    }
+    OPAL_THREAD_LOCK(&pool->lock);
+    if (0 < pool->num) {
+        item = pool->items[--pool->num];
+    }
+    OPAL_THREAD_UNLOCK(&pool->lock);
+    return item;
+}
+
+static bool pool_put(orcm_pnp_pool_t *pool, void *item)
+{
+    bool kept=false;
+
+    /* only keep objects nobody else holds */
+    if (NULL == pool->items ||
+        1 != ((opal_object_t*)item)->obj_reference_count) {
+        return false;
+    }
+    OPAL_THREAD_LOCK(&pool->lock);
+    if (pool->num < orcm_pnp_base.pool_size) {
+        pool->items[pool->num++] = item;
+        kept = true;
+    }
+    OPAL_THREAD_UNLOCK(&pool->lock);
+    return kept;
+}
+
+static void release_pool(orcm_pnp_pool_t *pool)
+{
+    while (0 < pool->num) {
+        OBJ_RELEASE(pool->items[--pool->num]);
+    }
+    if (NULL != pool->items) {
+        free(pool->items);
+        pool->items = NULL;
+    }
+    OBJ_DESTRUCT(&pool->lock);
+}
+
+/* empty a buffer but keep its memory */
+static void reset_buffer(opal_buffer_t *buf)
+{
+    buf->pack_ptr = buf->base_ptr;
+    buf->unpack_ptr = buf->base_ptr;
+    buf->bytes_used = 0;
+}
+
+void orcm_pnp_base_init_pools(void)
+{
+    int i;
+
+    init_pool(&orcm_pnp_base.send_pool);
+    init_pool(&orcm_pnp_base.msg_pool);
+    for (i=0; i < ORCM_PNP_POOL_BUF_CLASSES; i++) {
+        init_pool(&orcm_pnp_base.buffer_pools[i]);
+    }
+}
+
+orcm_pnp_send_t* orcm_pnp_base_get_send(void)
+{
+    orcm_pnp_send_t *send;
+
+    if (NULL == (send = (orcm_pnp_send_t*)pool_get(&orcm_pnp_base.send_pool))) {
+        send = OBJ_NEW(orcm_pnp_send_t);
+    }
+    return send;
+}
+
+void orcm_pnp_base_return_send(orcm_pnp_send_t *send)
+{
+    if (1 != ((opal_object_t*)send)->obj_reference_count) {
+        OBJ_RELEASE(send);
+        return;
+    }
+
+    /* the msg is ours, so it can be recycled too */
+    if (NULL != send->hdr) {
+        orcm_pnp_base_return_buffer(send->hdr);
+        send->hdr = NULL;
+    }
+    if (NULL != send->iovs) {
+        free(send->iovs);
+        send->iovs = NULL;
+    }
+    if (NULL != send->req) {
+        OBJ_RELEASE(send->req);
+        send->req = NULL;
+    }
+
+    /* everything but the lock and condition goes back to how
+     * the constructor left it
+     */
+    send->target.jobid = ORTE_JOBID_INVALID;
+    send->target.vpid = ORTE_VPID_INVALID;
+    send->pending = false;
+    send->channel = ORTE_RMCAST_INVALID_CHANNEL;
+    send->tag = ORTE_RML_TAG_INVALID;
+    send->msg = NULL;
+    send->count = 0;
+    send->cbfunc = NULL;
+    send->buffer = NULL;
+    send->cbdata = NULL;
+    send->multicast = false;
+    send->bytes = 0;
+    send->window = NULL;
+
+    if (!pool_put(&orcm_pnp_base.send_pool, send)) {
+        OBJ_RELEASE(send);
+    }
+}
+
+orcm_pnp_msg_t* orcm_pnp_base_get_msg(void)
+{
+    orcm_pnp_msg_t *msg;
+
+    if (NULL == (msg = (orcm_pnp_msg_t*)pool_get(&orcm_pnp_base.msg_pool))) {
+        msg = OBJ_NEW(orcm_pnp_msg_t);
+    }
+    return msg;
+}
+
+void orcm_pnp_base_return_msg(orcm_pnp_msg_t *msg)
+{
+    if (1 != ((opal_object_t*)msg)->obj_reference_count) {
+        OBJ_RELEASE(msg);
+        return;
+    }
+
+    msg->channel = ORCM_PNP_INVALID_CHANNEL;
+    msg->sender.jobid = ORTE_JOBID_INVALID;
+    msg->sender.vpid = ORTE_VPID_INVALID;
+    msg->queued = 0;
+    /* don't hang onto the memory of an unusually large msg */
+    if (buffer_class_size[ORCM_PNP_POOL_BUF_CLASSES-1] < msg->buf.bytes_allocated) {
+        OBJ_DESTRUCT(&msg->buf);
+        OBJ_CONSTRUCT(&msg->buf, opal_buffer_t);
+    } else {
+        reset_buffer(&msg->buf);
+    }
+
+    if (!pool_put(&orcm_pnp_base.msg_pool, msg)) {
+        OBJ_RELEASE(msg);
+    }
+}
+
+opal_buffer_t* orcm_pnp_base_get_buffer(size_t hint)
+{
+    opal_buffer_t *buf;
+    int i;
+
+    /* start with the smallest class that might hold the hint */
+    for (i=0; i < ORCM_PNP_POOL_BUF_CLASSES-1 && buffer_class_size[i] < hint; i++);
+    for (; i < ORCM_PNP_POOL_BUF_CLASSES; i++) {
+        if (NULL != (buf = (opal_buffer_t*)pool_get(&orcm_pnp_base.buffer_pools[i]))) {
+            return buf;
+        }
+    }
+    return OBJ_NEW(opal_buffer_t);
+}
+
+void orcm_pnp_base_return_buffer(opal_buffer_t *buf)
+{
+    int i;
+
+    for (i=0; i < ORCM_PNP_POOL_BUF_CLASSES; i++) {
+        if (buf->bytes_allocated <= buffer_class_size[i]) {
+            break;
+        }
+    }
+    if (ORCM_PNP_POOL_BUF_CLASSES == i ||
+        1 != ((opal_object_t*)buf)->obj_reference_count) {
+        /* too big to keep, or still in use elsewhere */
+        OBJ_RELEASE(buf);
+        return;
+    }
+    reset_buffer(buf);
+    if (!pool_put(&orcm_pnp_base.buffer_pools[i], buf)) {
+        OBJ_RELEASE(buf);
+    }
+}
+
+void orcm_pnp_base_stash_storage(opal_buffer_t *buf)
+{
+    opal_buffer_t *spare;
+    int i;
+
+    if (NULL == buf->base_ptr) {
+        return;
+    }
+    for (i=0; i < ORCM_PNP_POOL_BUF_CLASSES; i++) {
+        if (buf->bytes_allocated <= buffer_class_size[i]) {
+            break;
+        }
+    }
+    if (ORCM_PNP_POOL_BUF_CLASSES == i || NULL == orcm_pnp_base.buffer_pools[i].items) {
+        free(buf->base_ptr);
+    } else {
+        /* a pooled buffer is just a holder for the memory */
+        spare = OBJ_NEW(opal_buffer_t);
+        spare->base_ptr = buf->base_ptr;
+        spare->bytes_allocated = buf->bytes_allocated;
+        reset_buffer(spare);
+        if (!pool_put(&orcm_pnp_base.buffer_pools[i], spare)) {
+            OBJ_RELEASE(spare);
+        }
+    }
+    buf->base_ptr = NULL;
+    buf->pack_ptr = NULL;
+    buf->unpack_ptr = NULL;
+    buf->bytes_allocated = 0;
+    buf->bytes_used = 0;
+}
+
+void orcm_pnp_base_release_pools(void)
+{
+    int i;
+
+    release_pool(&orcm_pnp_base.send_pool);
+    release_pool(&orcm_pnp_base.msg_pool);
+    for (i=0; i < ORCM_PNP_POOL_BUF_CLASSES; i++) {
+        release_pool(&orcm_pnp_base.buffer_pools[i]);
+    }
+}
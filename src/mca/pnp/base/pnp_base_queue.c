@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include <stdio.h>
+#include <errno.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+#include <sched.h>
+
+#include "opal/sys/atomic.h"
+#include "opal/util/fd.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/base/public.h"
+#include "mca/pnp/base/private.h"
+
+/*
+ * Bounded multi-producer/single-consumer ring. Each slot carries a
+ * sequence number that tells producers when the slot is free and the
+ * consumer when it has been filled, so producers only contend on the
+ * tail index and the consumer never takes a lock. The consumer blocks
+ * on the wakeup fd only when the ring is empty - producers check the
+ * sleeping flag after publishing and only signal when it is set, so
+ * a busy consumer costs no syscalls at all.
+ */
+
+static int32_t ring_size(int32_t requested)
+{
+    int32_t sz=2;
+
+    while (sz < requested && sz < (1 << 30)) {
+        sz <<= 1;
+    }
+    return sz;
+}
+
+static int init_ring(orcm_pnp_queue_t *q, int32_t size)
+{
+    int32_t i;
+
+    q->size = ring_size(size);
+    q->mask = q->size - 1;
+    q->slots = (orcm_pnp_queue_slot_t*)malloc(q->size * sizeof(orcm_pnp_queue_slot_t));
+    if (NULL == q->slots) {
+        return ORCM_ERR_OUT_OF_RESOURCE;
+    }
+    for (i=0; i < q->size; i++) {
+        q->slots[i].seq = i;
+        q->slots[i].item = NULL;
+    }
+    q->head = 0;
+    q->tail = 0;
+    q->depth = 0;
+    q->max_depth = 0;
+    q->sleeping = 0;
+    return ORCM_SUCCESS;
+}
+
+int orcm_pnp_queue_init(orcm_pnp_queue_t *q, int32_t size)
+{
+    int rc;
+
+    if (ORCM_SUCCESS != (rc = init_ring(q, size))) {
+        return rc;
+    }
+
+#ifdef HAVE_SYS_EVENTFD_H
+    if (0 <= (q->wakeup[0] = eventfd(0, 0))) {
+        q->wakeup[1] = q->wakeup[0];
+        q->use_eventfd = true;
+        return ORCM_SUCCESS;
+    }
+#endif
+    /* fall back to a pipe */
+    if (pipe(q->wakeup) < 0) {
+        opal_output(0, "%s Cannot open pnp recv queue wakeup pipe",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME));
+        q->wakeup[0] = q->wakeup[1] = -1;
+        return ORCM_ERR_SYS_LIMITS_PIPES;
+    }
+    q->use_eventfd = false;
+    return ORCM_SUCCESS;
+}
+
+/* setup a ring drained by the same consumer as the owner - producers
+ * wake that consumer through the owner, and the owner checks this
+ * ring before letting its consumer sleep
+ */
+int orcm_pnp_queue_init_lane(orcm_pnp_queue_t *q, int32_t size,
+                             orcm_pnp_queue_t *owner)
+{
+    int rc;
+
+    if (ORCM_SUCCESS != (rc = init_ring(q, size))) {
+        return rc;
+    }
+    q->wake = owner;
+    q->lane = owner->lane;
+    owner->lane = q;
+    return ORCM_SUCCESS;
+}
+
+static bool ring_empty(orcm_pnp_queue_t *q)
+{
+    orcm_pnp_queue_slot_t *slot;
+    int32_t diff;
+
+    slot = &q->slots[q->head & q->mask];
+    diff = (int32_t)((uint32_t)slot->seq - (uint32_t)(q->head + 1));
+    return (diff < 0);
+}
+
+static void signal_consumer(orcm_pnp_queue_t *q)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t val=1;
+
+    if (q->use_eventfd) {
+        opal_fd_write(q->wakeup[1], sizeof(val), &val);
+        return;
+    }
+#endif
+    {
+        char c=0;
+        opal_fd_write(q->wakeup[1], sizeof(c), &c);
+    }
+}
+
+static int absorb_signal(orcm_pnp_queue_t *q)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t val;
+
+    if (q->use_eventfd) {
+        return opal_fd_read(q->wakeup[0], sizeof(val), &val);
+    }
+#endif
+    {
+        char c;
+        return opal_fd_read(q->wakeup[0], sizeof(c), &c);
+    }
+}
+
+int orcm_pnp_queue_push(orcm_pnp_queue_t *q, void *item, bool block)
+{
+    orcm_pnp_queue_slot_t *slot;
+    int32_t pos, seq, diff, depth, max;
+
+    pos = q->tail;
+    while (1) {
+        slot = &q->slots[pos & q->mask];
+        seq = slot->seq;
+        opal_atomic_rmb();
+        diff = (int32_t)((uint32_t)seq - (uint32_t)pos);
+        if (0 == diff) {
+            /* slot is free - try to claim it */
+            if (opal_atomic_cmpset_32(&q->tail, pos, pos+1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* ring is full - the consumer is busy, so let it run */
+            if (!block) {
+                return ORCM_ERR_WOULD_BLOCK;
+            }
+            sched_yield();
+        }
+        pos = q->tail;
+    }
+
+    /* publish the item */
+    slot->item = item;
+    opal_atomic_wmb();
+    slot->seq = pos + 1;
+
+    /* several producers may race to raise the high-water mark */
+    depth = opal_atomic_add_32(&q->depth, 1);
+    max = q->max_depth;
+    while (depth > max && !opal_atomic_cmpset_32(&q->max_depth, max, depth)) {
+        max = q->max_depth;
+    }
+
+    /* only pay for a wakeup if the consumer is idle */
+    opal_atomic_mb();
+    q = q->wake;
+    if (q->sleeping && opal_atomic_cmpset_32(&q->sleeping, 1, 0)) {
+        signal_consumer(q);
+    }
+    return ORCM_SUCCESS;
+}
+
+int orcm_pnp_queue_pop(orcm_pnp_queue_t *q, void **items, int max)
+{
+    orcm_pnp_queue_slot_t *slot;
+    int32_t seq, diff;
+    int n=0;
+
+    while (n < max) {
+        slot = &q->slots[q->head & q->mask];
+        seq = slot->seq;
+        opal_atomic_rmb();
+        diff = (int32_t)((uint32_t)seq - (uint32_t)(q->head + 1));
+        if (diff < 0) {
+            /* nothing more published yet */
+            break;
+        }
+        items[n++] = slot->item;
+        slot->item = NULL;
+        opal_atomic_mb();
+        /* hand the slot back to the producers */
+        slot->seq = q->head + q->size;
+        q->head++;
+    }
+    if (0 < n) {
+        opal_atomic_add_32(&q->depth, -n);
+    }
+    return n;
+}
+
+int orcm_pnp_queue_wait(orcm_pnp_queue_t *q)
+{
+    orcm_pnp_queue_t *ln;
+    bool ready;
+
+    q->sleeping = 1;
+    opal_atomic_mb();
+
+    /* recheck the rings now that producers can see we are idle */
+    ready = !ring_empty(q);
+    for (ln=q->lane; !ready && NULL != ln; ln=ln->lane) {
+        ready = !ring_empty(ln);
+    }
+    if (ready) {
+        if (opal_atomic_cmpset_32(&q->sleeping, 1, 0)) {
+            /* nobody signalled us - just go drain */
+            return ORCM_SUCCESS;
+        }
+        /* a producer beat us to it - absorb its signal */
+    }
+
+    if (0 > absorb_signal(q)) {
+        return ORCM_ERROR;
+    }
+    return ORCM_SUCCESS;
+}
+
+/* the same handshake as wait, for a consumer that blocks on the
+ * wakeup fd itself - returns true if the rings are empty and a
+ * producer will now signal the fd, or false if there is more to
+ * drain. A consumer that armed the queue must disarm it before
+ * draining again
+ */
+bool orcm_pnp_queue_arm(orcm_pnp_queue_t *q)
+{
+    orcm_pnp_queue_t *ln;
+    bool ready;
+
+    q->sleeping = 1;
+    opal_atomic_mb();
+
+    ready = !ring_empty(q);
+    for (ln=q->lane; !ready && NULL != ln; ln=ln->lane) {
+        ready = !ring_empty(ln);
+    }
+    if (!ready) {
+        return true;
+    }
+    if (!opal_atomic_cmpset_32(&q->sleeping, 1, 0)) {
+        /* a producer beat us to it - absorb its signal */
+        absorb_signal(q);
+    }
+    return false;
+}
+
+int orcm_pnp_queue_disarm(orcm_pnp_queue_t *q)
+{
+    if (opal_atomic_cmpset_32(&q->sleeping, 1, 0)) {
+        /* nobody signalled us */
+        return ORCM_SUCCESS;
+    }
+    if (0 > absorb_signal(q)) {
+        return ORCM_ERROR;
+    }
+    return ORCM_SUCCESS;
+}
+
+int32_t orcm_pnp_queue_depth(orcm_pnp_queue_t *q)
+{
+    return q->depth;
+}
+
+static void queue_constructor(orcm_pnp_queue_t *ptr)
+{
+    ptr->slots = NULL;
+    ptr->size = 0;
+    ptr->mask = 0;
+    ptr->head = 0;
+    ptr->tail = 0;
+    ptr->depth = 0;
+    ptr->max_depth = 0;
+    ptr->sleeping = 0;
+    ptr->wakeup[0] = -1;
+    ptr->wakeup[1] = -1;
+    ptr->use_eventfd = false;
+    ptr->wake = ptr;
+    ptr->lane = NULL;
+}
+static void queue_destructor(orcm_pnp_queue_t *ptr)
+{
+    if (NULL != ptr->slots) {
+        free(ptr->slots);
+    }
+    if (0 <= ptr->wakeup[0]) {
+        close(ptr->wakeup[0]);
+    }
+    if (0 <= ptr->wakeup[1] && ptr->wakeup[1] != ptr->wakeup[0]) {
+        close(ptr->wakeup[1]);
+    }
+}
+OBJ_CLASS_INSTANCE(orcm_pnp_queue_t,
+                   opal_object_t,
+                   queue_constructor,
+                   queue_destructor);
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include "opal/sys/atomic.h"
+#include "opal/threads/condition.h"
+#include "opal/threads/mutex.h"
+
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/base/public.h"
+#include "mca/pnp/base/private.h"
+
+/*
+ * Send requests are completed by whichever thread the transport calls
+ * back on, and nothing is locked to do so unless someone is actually
+ * blocked in a wait. Waiters all share one lock and condition, so a
+ * caller with a deep pipeline of sends pays for one wakeup per
+ * completion it is waiting on rather than a lock per msg.
+ */
+
+static bool req_done(orcm_pnp_send_req_t *req)
+{
+    bool done;
+
+    done = req->complete;
+    opal_atomic_rmb();
+    return done;
+}
+
+/* hand back the status of a completed request and let go of it */
+static int req_finish(orcm_pnp_send_req_t **req)
+{
+    int status;
+
+    status = (*req)->status;
+    OBJ_RELEASE(*req);
+    *req = NULL;
+    return status;
+}
+
+void orcm_pnp_base_report_send(orcm_pnp_send_t *send, int status)
+{
+    orcm_pnp_send_req_t *req;
+
+    if (NULL != send->cbfunc) {
+        send->cbfunc(status, ORTE_PROC_MY_NAME, send->tag, send->msg,
+                     send->count, send->buffer, send->cbdata);
+    }
+    if (NULL == (req = send->req)) {
+        return;
+    }
+
+    req->status = status;
+    opal_atomic_wmb();
+    req->complete = true;
+
+    /* only pay for the lock if someone is waiting */
+    opal_atomic_mb();
+    if (0 < orcm_pnp_base.req_waiters) {
+        OPAL_THREAD_LOCK(&orcm_pnp_base.req_lock);
+        opal_condition_broadcast(&orcm_pnp_base.req_cond);
+        OPAL_THREAD_UNLOCK(&orcm_pnp_base.req_lock);
+    }
+}
+
+int orcm_pnp_test(orcm_pnp_send_req_t **req, bool *done)
+{
+    if (NULL == *req) {
+        *done = true;
+        return ORCM_SUCCESS;
+    }
+    if (!req_done(*req)) {
+        *done = false;
+        return ORCM_SUCCESS;
+    }
+    *done = true;
+    return req_finish(req);
+}
+
+int orcm_pnp_wait(orcm_pnp_send_req_t **req)
+{
+    return orcm_pnp_wait_all(1, req);
+}
+
+int orcm_pnp_wait_any(int count, orcm_pnp_send_req_t **reqs, int *index)
+{
+    int i, active;
+
+    *index = -1;
+    OPAL_THREAD_LOCK(&orcm_pnp_base.req_lock);
+    opal_atomic_add_32(&orcm_pnp_base.req_waiters, 1);
+    opal_atomic_mb();
+    while (1) {
+        for (i=0, active=0; i < count; i++) {
+            if (NULL == reqs[i]) {
+                continue;
+            }
+            active++;
+            if (req_done(reqs[i])) {
+                *index = i;
+                break;
+            }
+        }
+        if (0 <= *index || 0 == active) {
+            break;
+        }
+        opal_condition_wait(&orcm_pnp_base.req_cond, &orcm_pnp_base.req_lock);
+    }
+    opal_atomic_add_32(&orcm_pnp_base.req_waiters, -1);
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.req_lock);
+
+    if (0 > *index) {
+        return ORCM_SUCCESS;
+    }
+    return req_finish(&reqs[*index]);
+}
+
+int orcm_pnp_wait_all(int count, orcm_pnp_send_req_t **reqs)
+{
+    int i, status, rc=ORCM_SUCCESS;
+
+    /* sweep up whatever is already done before deciding to sleep */
+    for (i=0; i < count; i++) {
+        if (NULL != reqs[i] && req_done(reqs[i])) {
+            status = req_finish(&reqs[i]);
+            if (ORCM_SUCCESS == rc) {
+                rc = status;
+            }
+        }
+    }
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.req_lock);
+    opal_atomic_add_32(&orcm_pnp_base.req_waiters, 1);
+    opal_atomic_mb();
+    for (i=0; i < count; i++) {
+        if (NULL == reqs[i]) {
+            continue;
+        }
+        while (!req_done(reqs[i])) {
+            opal_condition_wait(&orcm_pnp_base.req_cond, &orcm_pnp_base.req_lock);
+        }
+        status = req_finish(&reqs[i]);
+        if (ORCM_SUCCESS == rc) {
+            rc = status;
+        }
+    }
+    opal_atomic_add_32(&orcm_pnp_base.req_waiters, -1);
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.req_lock);
+
+    return rc;
+}
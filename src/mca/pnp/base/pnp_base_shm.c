@@ -0,0 +1,766 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <fcntl.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "opal/class/opal_hash_table.h"
+#include "opal/dss/dss.h"
+#include "opal/sys/atomic.h"
+#include "opal/threads/mutex.h"
+#include "opal/threads/threads.h"
+#include "opal/util/opal_environ.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/mca/rml/rml_types.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/base/public.h"
+#include "mca/pnp/base/private.h"
+
+/*
+ * Direct msgs between procs on the same node bypass RML. Each proc
+ * owns one inbound ring in a POSIX shared memory segment named after
+ * it - since that namespace is local to the node, being able to open
+ * a peer's segment is all it takes to know the peer is local. Senders
+ * serialize on a lock word in the segment and copy the msg in, while
+ * the owner's reader thread copies msgs out and hands them to the recv
+ * processing threads exactly as if RML had delivered them. As with the
+ * recv queues, the reader only sleeps when the ring is empty and only
+ * a sender that finds it asleep pays for a wakeup - here a byte down a
+ * fifo, as an eventfd cannot be reached from an unrelated process.
+ * A sender waits for room if the ring is full, and a msg larger than
+ * the ring is fed through it in pieces, so a peer reached this way
+ * gets every direct msg this way and in the order it was sent. The
+ * reader never blocks handing msgs on, so a full ring only ever waits
+ * on the reader copying msgs out.
+ */
+
+#if defined(HAVE_SHM_OPEN) && defined(HAVE_SYS_MMAN_H)
+
+#define ORCM_PNP_SHM_PATH_MAX  256
+/* how long the reader waits before retrying held msgs, and how
+ * long a sender that has yielded ORCM_PNP_SHM_SPINS times without
+ * finding room sleeps between tries
+ */
+#define ORCM_PNP_SHM_HELD_USECS  100
+#define ORCM_PNP_SHM_SPINS       1024
+
+typedef struct {
+    /* set once the reader is running, cleared when it goes away */
+    volatile int32_t alive;
+    int32_t pid;
+    /* pid of the sender currently copying a msg in, or 0 */
+    volatile int32_t lock;
+    /* reader is blocked (or about to block) on the fifo */
+    volatile int32_t sleeping;
+    /* bytes in the ring - a power of two */
+    int32_t size;
+    /* free-running byte counts - the reader owns head, the
+     * sender holding the lock owns tail
+     */
+    volatile int32_t head;
+    volatile int32_t tail;
+    char fifo[ORCM_PNP_SHM_PATH_MAX];
+} shm_hdr_t;
+
+/* each msg in the ring is preceded by one of these and padded
+ * out to a multiple of its size
+ */
+typedef struct {
+    uint32_t jobid;
+    uint32_t vpid;
+    uint32_t len;
+    uint32_t pad;
+} shm_rec_t;
+
+#define SHM_RING_OFFSET  ((sizeof(shm_hdr_t) + 63) & ~((size_t)63))
+#define SHM_RING(s)      ((uint8_t*)(s) + SHM_RING_OFFSET)
+
+static shm_hdr_t *my_seg=NULL;
+static size_t my_seg_len=0;
+static char *my_seg_name=NULL;
+static int my_fifo=-1;
+static opal_thread_t reader;
+static bool reader_started=false;
+static volatile int32_t reader_stop=0;
+/* msgs taken out of the ring whose recv queue had no room */
+static opal_list_t held;
+static bool held_setup=false;
+/* the record the reader is part way through */
+static struct {
+    bool active;
+    shm_rec_t rec;
+    orcm_pnp_msg_t *msg;
+    uint32_t got;
+    uint32_t body;
+} cur;
+
+static inline uint64_t peer_key(const orte_process_name_t *peer)
+{
+    return ((uint64_t)peer->jobid << 32) | (uint64_t)peer->vpid;
+}
+
+static inline uint32_t rec_size(size_t len)
+{
+    return (uint32_t)((sizeof(shm_rec_t) + len + sizeof(shm_rec_t) - 1) &
+                      ~(sizeof(shm_rec_t) - 1));
+}
+
+static char* seg_name(const orte_process_name_t *name)
+{
+    char *nm=NULL;
+
+    asprintf(&nm, "/orcm-pnp-%u-%u-%u", (unsigned int)getuid(),
+             (unsigned int)name->jobid, (unsigned int)name->vpid);
+    return nm;
+}
+
+static bool proc_gone(int32_t pid)
+{
+    return (0 != kill((pid_t)pid, 0) && ESRCH == errno);
+}
+
+static void ring_write(shm_hdr_t *seg, uint32_t pos, const void *src, size_t len)
+{
+    uint32_t off = pos & (uint32_t)(seg->size - 1);
+    size_t first = (size_t)seg->size - off;
+
+    if (len <= first) {
+        memcpy(SHM_RING(seg) + off, src, len);
+    } else {
+        memcpy(SHM_RING(seg) + off, src, first);
+        memcpy(SHM_RING(seg), (const uint8_t*)src + first, len - first);
+    }
+}
+
+static void ring_read(shm_hdr_t *seg, uint32_t pos, void *dest, size_t len)
+{
+    uint32_t off = pos & (uint32_t)(seg->size - 1);
+    size_t first = (size_t)seg->size - off;
+
+    if (len <= first) {
+        memcpy(dest, SHM_RING(seg) + off, len);
+    } else {
+        memcpy(dest, SHM_RING(seg) + off, first);
+        memcpy((uint8_t*)dest + first, SHM_RING(seg), len - first);
+    }
+}
+
+static void ring_append(shm_hdr_t *seg, uint32_t pos, opal_buffer_t *dest, size_t len)
+{
+    uint32_t off = pos & (uint32_t)(seg->size - 1);
+    size_t first = (size_t)seg->size - off;
+
+    if (len <= first) {
+        orcm_pnp_base_append_raw(dest, SHM_RING(seg) + off, len);
+    } else {
+        orcm_pnp_base_append_raw(dest, SHM_RING(seg) + off, first);
+        orcm_pnp_base_append_raw(dest, SHM_RING(seg), len - first);
+    }
+}
+
+/* hand held msgs on in the order they came - false if a recv
+ * queue still has no room
+ */
+static bool push_held(void)
+{
+    opal_list_item_t *item;
+    orcm_pnp_msg_t *msg;
+
+    while (opal_list_get_end(&held) != (item = opal_list_get_first(&held))) {
+        msg = (orcm_pnp_msg_t*)item;
+        if (ORCM_SUCCESS != orcm_pnp_queue_push(orcm_pnp_base_recv_queue(msg), msg, false)) {
+            return false;
+        }
+        opal_list_remove_first(&held);
+    }
+    return true;
+}
+
+/* pass everything waiting in my ring on for processing. The ring is
+ * always emptied - a msg whose recv queue is full is held here rather
+ * than left in the ring, so a sender never waits on our recv
+ * processing, which may itself be waiting to send to that sender. A
+ * msg larger than the ring arrives in pieces, so one may only be
+ * partly there - it is picked up where it left off next time
+ */
+static void drain(void)
+{
+    shm_rec_t *rec=&cur.rec;
+    orcm_pnp_msg_t *msg=cur.msg;
+    uint32_t head, avail, n;
+    bool full;
+
+    full = !push_held();
+
+    head = (uint32_t)my_seg->head;
+    while (0 < (avail = (uint32_t)my_seg->tail - head)) {
+        opal_atomic_rmb();
+        if (!cur.active) {
+            /* a record header is always published whole */
+            ring_read(my_seg, head, rec, sizeof(*rec));
+            head += sizeof(*rec);
+            avail -= sizeof(*rec);
+            cur.active = true;
+            cur.got = 0;
+            cur.body = rec_size(rec->len) - sizeof(*rec);
+
+            /* if we have not announced, ignore this message */
+            if (NULL == orcm_pnp_base.my_string_id || !orcm_pnp_base.comm_enabled) {
+                msg = NULL;
+            } else {
+                msg = orcm_pnp_base_get_msg();
+                msg->channel = ORCM_PNP_DIRECT_CHANNEL;
+                msg->sender.jobid = rec->jobid;
+                msg->sender.vpid = rec->vpid;
+            }
+            cur.msg = msg;
+        }
+
+        /* take what is there of the body, leaving out the padding */
+        n = (avail < cur.body - cur.got) ? avail : cur.body - cur.got;
+        if (NULL != msg && cur.got < rec->len) {
+            ring_append(my_seg, head, &msg->buf,
+                        (n < rec->len - cur.got) ? n : rec->len - cur.got);
+        }
+        head += n;
+        cur.got += n;
+
+        /* done with the space - hand it back to the senders */
+        opal_atomic_mb();
+        my_seg->head = (int32_t)head;
+
+        if (cur.got < cur.body) {
+            /* the sender is still writing the rest */
+            break;
+        }
+        cur.active = false;
+        cur.msg = NULL;
+        if (NULL == msg) {
+            continue;
+        }
+        if (msg->buf.bytes_used != rec->len) {
+            ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+            orcm_pnp_base_return_msg(msg);
+            continue;
+        }
+        OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                             "%s pnp:base:shm recvd direct msg from %s",
+                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                             ORTE_NAME_PRINT(&msg->sender)));
+        msg->queued = orcm_pnp_base_metrics_now();
+        if (full || ORCM_SUCCESS != orcm_pnp_queue_push(orcm_pnp_base_recv_queue(msg), msg, false)) {
+            /* nothing may overtake what is already held */
+            opal_list_append(&held, &msg->super);
+            full = true;
+        }
+    }
+}
+
+static void* shm_reader(opal_object_t *obj)
+{
+    char c;
+
+    OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
+                         "%s pnp:base:shm reader operational",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+
+    while (1) {
+        drain();
+        if (reader_stop) {
+            break;
+        }
+        if (!opal_list_is_empty(&held)) {
+            /* nothing tells us when the recv queues have room, so
+             * check back shortly
+             */
+            usleep(ORCM_PNP_SHM_HELD_USECS);
+            continue;
+        }
+        my_seg->sleeping = 1;
+        opal_atomic_mb();
+        /* recheck now that senders can see we are idle */
+        if (my_seg->head != my_seg->tail &&
+            opal_atomic_cmpset_32(&my_seg->sleeping, 1, 0)) {
+            /* nobody signalled us - just go drain */
+            continue;
+        }
+        if (read(my_fifo, &c, sizeof(c)) < 0 && EINTR != errno) {
+            opal_output(0, "%s pnp:base:shm reader cannot read its fifo - stopping",
+                        ORTE_NAME_PRINT(ORTE_PROC_MY_NAME));
+            break;
+        }
+    }
+    return OPAL_THREAD_CANCELLED;
+}
+
+int orcm_pnp_base_shm_init(void)
+{
+    shm_hdr_t *seg;
+    size_t len;
+    int fd;
+
+    if (!orcm_pnp_base.shm || NULL != my_seg) {
+        return ORCM_SUCCESS;
+    }
+
+    if (NULL == (my_seg_name = seg_name(ORTE_PROC_MY_NAME))) {
+        return ORCM_ERR_OUT_OF_RESOURCE;
+    }
+    /* clear out anything left behind by a previous incarnation */
+    shm_unlink(my_seg_name);
+
+    len = SHM_RING_OFFSET + orcm_pnp_base.shm_size;
+    if (0 > (fd = shm_open(my_seg_name, O_RDWR | O_CREAT | O_EXCL, 0600))) {
+        goto error;
+    }
+    if (0 > ftruncate(fd, len)) {
+        close(fd);
+        shm_unlink(my_seg_name);
+        goto error;
+    }
+    seg = (shm_hdr_t*)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == seg) {
+        shm_unlink(my_seg_name);
+        goto error;
+    }
+    my_seg = seg;
+    my_seg_len = len;
+    seg->alive = 0;
+    seg->pid = (int32_t)getpid();
+    seg->lock = 0;
+    seg->sleeping = 0;
+    seg->size = orcm_pnp_base.shm_size;
+    seg->head = 0;
+    seg->tail = 0;
+
+    /* the wakeup fifo - opened read-write so neither we nor any
+     * sender ever sees it without a reader
+     */
+    snprintf(seg->fifo, sizeof(seg->fifo), "%s/orcm-pnp-%u-%u-%u",
+             opal_tmp_directory(), (unsigned int)getuid(),
+             (unsigned int)ORTE_PROC_MY_NAME->jobid,
+             (unsigned int)ORTE_PROC_MY_NAME->vpid);
+    unlink(seg->fifo);
+    if (0 > mkfifo(seg->fifo, 0600)) {
+        seg->fifo[0] = '\0';
+        goto error;
+    }
+    if (0 > (my_fifo = open(seg->fifo, O_RDWR))) {
+        goto error;
+    }
+
+    OBJ_CONSTRUCT(&held, opal_list_t);
+    held_setup = true;
+    memset(&cur, 0, sizeof(cur));
+    reader_stop = 0;
+    reader.t_run = shm_reader;
+    reader.t_arg = NULL;
+    if (ORTE_SUCCESS != opal_thread_start(&reader)) {
+        goto error;
+    }
+    reader_started = true;
+
+    /* let senders in */
+    opal_atomic_wmb();
+    seg->alive = 1;
+
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:base:shm accepting direct msgs through %s",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), my_seg_name));
+    return ORCM_SUCCESS;
+
+ error:
+    opal_output(0, "%s pnp:base:shm cannot setup shared memory segment %s: %s - using RML only",
+                ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), my_seg_name, strerror(errno));
+    orcm_pnp_base_shm_finalize();
+    return ORCM_ERR_NOT_AVAILABLE;
+}
+
+void orcm_pnp_base_shm_finalize(void)
+{
+    uint64_t key;
+    void *ptr, *node, *next;
+    opal_list_item_t *item;
+    char c=0;
+    int rc;
+
+    if (NULL != my_seg) {
+        /* stop senders from coming in, then let the reader go */
+        my_seg->alive = 0;
+        if (reader_started) {
+            reader_stop = 1;
+            opal_atomic_mb();
+            write(my_fifo, &c, sizeof(c));
+            opal_thread_join(&reader, NULL);
+            reader_started = false;
+        }
+        if ('\0' != my_seg->fifo[0]) {
+            unlink(my_seg->fifo);
+        }
+        munmap(my_seg, my_seg_len);
+        shm_unlink(my_seg_name);
+        my_seg = NULL;
+    }
+    if (0 <= my_fifo) {
+        close(my_fifo);
+        my_fifo = -1;
+    }
+    if (NULL != my_seg_name) {
+        free(my_seg_name);
+        my_seg_name = NULL;
+    }
+    if (NULL != cur.msg) {
+        orcm_pnp_base_return_msg(cur.msg);
+        cur.msg = NULL;
+    }
+    cur.active = false;
+    if (held_setup) {
+        while (NULL != (item = opal_list_remove_first(&held))) {
+            orcm_pnp_base_return_msg((orcm_pnp_msg_t*)item);
+        }
+        OBJ_DESTRUCT(&held);
+        held_setup = false;
+    }
+
+    /* let go of the peers */
+    OPAL_THREAD_LOCK(&orcm_pnp_base.shm_lock);
+    rc = opal_hash_table_get_first_key_uint64(&orcm_pnp_base.shm_peers,
+                                              &key, &ptr, &node);
+    while (OPAL_SUCCESS == rc) {
+        OBJ_RELEASE(ptr);
+        rc = opal_hash_table_get_next_key_uint64(&orcm_pnp_base.shm_peers,
+                                                 &key, &ptr, node, &next);
+        node = next;
+    }
+    opal_hash_table_remove_all(&orcm_pnp_base.shm_peers);
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.shm_lock);
+}
+
+/* map a peer's segment - a peer without one is not on this node */
+static orcm_pnp_shm_peer_t* attach(const orte_process_name_t *name)
+{
+    orcm_pnp_shm_peer_t *peer;
+    shm_hdr_t *seg;
+    struct stat st;
+    char *nm;
+    int fd;
+
+    peer = OBJ_NEW(orcm_pnp_shm_peer_t);
+    if (NULL == (nm = seg_name(name))) {
+        return peer;
+    }
+    fd = shm_open(nm, O_RDWR, 0600);
+    free(nm);
+    if (fd < 0) {
+        return peer;
+    }
+    if (0 > fstat(fd, &st) || (size_t)st.st_size < SHM_RING_OFFSET) {
+        close(fd);
+        return peer;
+    }
+    seg = (shm_hdr_t*)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == seg) {
+        return peer;
+    }
+    if (!seg->alive || proc_gone(seg->pid) ||
+        (size_t)st.st_size < SHM_RING_OFFSET + (size_t)seg->size ||
+        '\0' != seg->fifo[ORCM_PNP_SHM_PATH_MAX-1] ||
+        0 > (peer->fifo = open(seg->fifo, O_RDWR | O_NONBLOCK))) {
+        munmap(seg, st.st_size);
+        return peer;
+    }
+    peer->seg = seg;
+    peer->len = st.st_size;
+
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:base:shm reaching %s through shared memory",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), ORTE_NAME_PRINT(name)));
+    return peer;
+}
+
+static orcm_pnp_shm_peer_t* get_peer(const orte_process_name_t *name)
+{
+    orcm_pnp_shm_peer_t *peer;
+    void *ptr;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.shm_lock);
+    if (OPAL_SUCCESS == opal_hash_table_get_value_uint64(&orcm_pnp_base.shm_peers,
+                                                         peer_key(name), &ptr)) {
+        peer = (orcm_pnp_shm_peer_t*)ptr;
+    } else {
+        peer = attach(name);
+        opal_hash_table_set_value_uint64(&orcm_pnp_base.shm_peers, peer_key(name), peer);
+    }
+    if (NULL == peer->seg) {
+        peer = NULL;
+    } else {
+        OBJ_RETAIN(peer);
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.shm_lock);
+    return peer;
+}
+
+/* the peer went away - forget it so a restarted incarnation
+ * is looked up afresh
+ */
+static void drop_peer(const orte_process_name_t *name, orcm_pnp_shm_peer_t *peer)
+{
+    void *ptr;
+
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:base:shm lost %s",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), ORTE_NAME_PRINT(name)));
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.shm_lock);
+    if (OPAL_SUCCESS == opal_hash_table_get_value_uint64(&orcm_pnp_base.shm_peers,
+                                                         peer_key(name), &ptr) &&
+        ptr == (void*)peer) {
+        opal_hash_table_remove_value_uint64(&orcm_pnp_base.shm_peers, peer_key(name));
+        OBJ_RELEASE(peer);
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.shm_lock);
+}
+
+/* wait a little for the reader to make room - false if anyone
+ * we are waiting on has died
+ */
+static bool backoff(shm_hdr_t *seg, int32_t owner, unsigned int *spins)
+{
+    if (*spins < ORCM_PNP_SHM_SPINS) {
+        sched_yield();
+    } else {
+        usleep(ORCM_PNP_SHM_HELD_USECS);
+    }
+    if (0 == (++(*spins) & (ORCM_PNP_SHM_SPINS - 1))) {
+        /* make sure nobody died on us */
+        if (proc_gone(seg->pid)) {
+            return false;
+        }
+        if (0 != owner && proc_gone(owner)) {
+            opal_atomic_cmpset_32(&seg->lock, owner, 0);
+        }
+    }
+    return true;
+}
+
+/* take the ring's lock once it has room for need bytes - false if
+ * the peer is gone. The reader always empties the ring, so this only
+ * waits while it catches up, backing off to sleeping if that takes
+ * a while rather than burning the cpu it needs
+ */
+static bool claim(shm_hdr_t *seg, int32_t me, uint32_t need)
+{
+    int32_t owner;
+    unsigned int spins=0;
+
+    while (1) {
+        if (!seg->alive) {
+            return false;
+        }
+        owner = seg->lock;
+        if (0 == owner) {
+            if (opal_atomic_cmpset_32(&seg->lock, 0, me)) {
+                if ((uint32_t)seg->size - ((uint32_t)seg->tail - (uint32_t)seg->head) >= need) {
+                    return true;
+                }
+                /* full - let the reader catch up */
+                opal_atomic_wmb();
+                seg->lock = 0;
+            }
+        }
+        if (!backoff(seg, owner, &spins)) {
+            return false;
+        }
+    }
+}
+
+/* copy n bytes of the msg body, starting off bytes in, into the ring.
+ * Anything past the end of the msg is padding and is left alone
+ */
+static void body_write(shm_hdr_t *seg, uint32_t pos, opal_buffer_t *hdr,
+                       struct iovec *msg, int count, size_t off, size_t n)
+{
+    const uint8_t *src;
+    size_t sz, k;
+    int i;
+
+    for (i=-1; i < count && 0 < n; i++) {
+        if (i < 0) {
+            src = (const uint8_t*)hdr->base_ptr;
+            sz = hdr->bytes_used;
+        } else {
+            src = (const uint8_t*)msg[i].iov_base;
+            sz = msg[i].iov_len;
+        }
+        if (sz <= off) {
+            off -= sz;
+            continue;
+        }
+        k = (n < sz - off) ? n : sz - off;
+        ring_write(seg, pos, src + off, k);
+        pos += k;
+        n -= k;
+        off = 0;
+    }
+}
+
+/* only pay for a wakeup if the reader is idle - a full fifo
+ * means it has wakeups waiting anyway
+ */
+static void wake_reader(orcm_pnp_shm_peer_t *peer)
+{
+    shm_hdr_t *seg = (shm_hdr_t*)peer->seg;
+    char c=0;
+
+    opal_atomic_mb();
+    if (seg->sleeping && opal_atomic_cmpset_32(&seg->sleeping, 1, 0)) {
+        write(peer->fifo, &c, sizeof(c));
+    }
+}
+
+int orcm_pnp_base_shm_send(orte_process_name_t *recipient, opal_buffer_t *hdr,
+                           struct iovec *msg, int count)
+{
+    orcm_pnp_shm_peer_t *peer;
+    shm_hdr_t *seg;
+    shm_rec_t rec;
+    uint32_t tail, room, need, body, off, n;
+    unsigned int spins=0;
+    int32_t me;
+    size_t len;
+    int i, rc;
+
+    if (!orcm_pnp_base.shm) {
+        return ORCM_ERR_NOT_AVAILABLE;
+    }
+
+    len = hdr->bytes_used;
+    for (i=0; i < count; i++) {
+        len += msg[i].iov_len;
+    }
+    if ((size_t)UINT32_MAX - 2*sizeof(rec) < len) {
+        ORTE_ERROR_LOG(ORCM_ERR_BAD_PARAM);
+        return ORCM_ERR_BAD_PARAM;
+    }
+
+    if (NULL == (peer = get_peer(recipient))) {
+        /* not on this node */
+        return ORCM_ERR_NOT_AVAILABLE;
+    }
+    seg = (shm_hdr_t*)peer->seg;
+
+    /* once a peer is reached through its ring, every msg for it goes
+     * that way so none can overtake another over RML - a msg larger
+     * than the ring is fed through it in pieces as the reader makes
+     * room, holding the lock so nothing gets in between
+     */
+    me = (int32_t)getpid();
+    need = rec_size(len);
+    if (!claim(seg, me, ((uint32_t)seg->size < need) ? sizeof(rec) : need)) {
+        drop_peer(recipient, peer);
+        rc = ORCM_ERR_NOT_AVAILABLE;
+        goto cleanup;
+    }
+
+    rec.jobid = ORTE_PROC_MY_NAME->jobid;
+    rec.vpid = ORTE_PROC_MY_NAME->vpid;
+    rec.len = (uint32_t)len;
+    rec.pad = 0;
+    tail = (uint32_t)seg->tail;
+    ring_write(seg, tail, &rec, sizeof(rec));
+    tail += sizeof(rec);
+
+    body = need - sizeof(rec);
+    for (off=0; off < body; off += n) {
+        room = (uint32_t)seg->size - (tail - (uint32_t)seg->head);
+        if (0 == room) {
+            if (!seg->alive || !backoff(seg, 0, &spins)) {
+                /* the msg dies with the peer */
+                opal_atomic_cmpset_32(&seg->lock, me, 0);
+                drop_peer(recipient, peer);
+                rc = ORCM_ERR_NOT_AVAILABLE;
+                goto cleanup;
+            }
+            n = 0;
+            continue;
+        }
+        n = (room < body - off) ? room : body - off;
+        body_write(seg, tail, hdr, msg, count, off, n);
+        tail += n;
+        if (off + n < body) {
+            /* publish what is there so the reader can make more room */
+            opal_atomic_wmb();
+            seg->tail = (int32_t)tail;
+            wake_reader(peer);
+        }
+    }
+
+    /* publish the rest and let the next sender in */
+    opal_atomic_wmb();
+    seg->tail = (int32_t)tail;
+    opal_atomic_wmb();
+    seg->lock = 0;
+    wake_reader(peer);
+    rc = ORCM_SUCCESS;
+
+ cleanup:
+    OBJ_RELEASE(peer);
+    return rc;
+}
+
+#else
+
+/* no POSIX shared memory here - everything goes over RML */
+
+int orcm_pnp_base_shm_init(void)
+{
+    if (orcm_pnp_base.shm) {
+        opal_output(0, "%s pnp:base:shm shared memory is not supported here - using RML only",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME));
+        orcm_pnp_base.shm = false;
+    }
+    return ORCM_ERR_NOT_AVAILABLE;
+}
+
+void orcm_pnp_base_shm_finalize(void)
+{
+}
+
+int orcm_pnp_base_shm_send(orte_process_name_t *recipient, opal_buffer_t *hdr,
+                           struct iovec *msg, int count)
+{
+    return ORCM_ERR_NOT_AVAILABLE;
+}
+
+#endif
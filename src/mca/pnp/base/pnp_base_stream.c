@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "opal/class/opal_list.h"
+#include "opal/dss/dss.h"
+#include "opal/sys/atomic.h"
+#include "opal/threads/mutex.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "mca/pnp/base/public.h"
+#include "mca/pnp/base/private.h"
+
+/*
+ * A streamed msg goes out as a series of fragments, each a regular
+ * msg whose header is followed by:
+ *
+ *   [stream id][offset of the fragment][size of the whole msg][len]
+ *
+ * and then len raw bytes. Fragments from a sender arrive in the order
+ * they were sent, so the receiver only has to check that each one
+ * picks up where the last left off. The size of the whole msg comes
+ * off the wire, so it is capped before any space is taken for it, and
+ * a msg whose sender stops partway through is eventually let go.
+ */
+
+void orcm_pnp_base_setup_stream(orcm_pnp_stream_t *stream,
+                                struct iovec *msg, int count,
+                                opal_buffer_t *buffer)
+{
+    int i;
+
+    stream->msg = msg;
+    stream->count = count;
+    stream->buffer = buffer;
+    if (NULL != msg) {
+        stream->iov = msg;
+        stream->niov = count;
+        stream->total = 0;
+        for (i=0; i < count; i++) {
+            stream->total += msg[i].iov_len;
+        }
+    } else {
+        stream->whole.iov_base = buffer->unpack_ptr;
+        stream->whole.iov_len = buffer->bytes_used - (buffer->unpack_ptr - buffer->base_ptr);
+        stream->iov = &stream->whole;
+        stream->niov = 1;
+        stream->total = stream->whole.iov_len;
+    }
+    stream->cur = 0;
+    stream->off = 0;
+    stream->sent = 0;
+    stream->id = (uint32_t)opal_atomic_add_32(&orcm_pnp_base.next_stream, 1);
+}
+
+int orcm_pnp_base_next_fragment(orcm_pnp_stream_t *stream,
+                                opal_buffer_t **frag)
+{
+    opal_buffer_t *buf;
+    int32_t len;
+    size_t n;
+    int ret;
+
+    *frag = NULL;
+    if (stream->total <= stream->sent) {
+        return ORCM_ERR_NOT_FOUND;
+    }
+    if ((int64_t)orcm_pnp_base.fragment_size < stream->total - stream->sent) {
+        len = orcm_pnp_base.fragment_size;
+    } else {
+        len = stream->total - stream->sent;
+    }
+
+    buf = orcm_pnp_base_get_buffer(len + 64);
+    if (ORCM_SUCCESS != (ret = orcm_pnp_base_pack_header(buf, stream->tag, ORCM_PNP_MSG_FRAGMENT)) ||
+        ORCM_SUCCESS != (ret = opal_dss.pack(buf, &stream->id, 1, OPAL_UINT32)) ||
+        ORCM_SUCCESS != (ret = opal_dss.pack(buf, &stream->sent, 1, OPAL_INT64)) ||
+        ORCM_SUCCESS != (ret = opal_dss.pack(buf, &stream->total, 1, OPAL_INT64)) ||
+        ORCM_SUCCESS != (ret = opal_dss.pack(buf, &len, 1, OPAL_INT32))) {
+        ORTE_ERROR_LOG(ret);
+        OBJ_RELEASE(buf);
+        return ret;
+    }
+
+    /* copy the next len bytes, which may span iovecs */
+    stream->sent += len;
+    while (0 < len) {
+        n = stream->iov[stream->cur].iov_len - stream->off;
+        if ((size_t)len < n) {
+            n = len;
+        }
+        if (ORCM_SUCCESS != (ret = orcm_pnp_base_append_raw(buf, (uint8_t*)stream->iov[stream->cur].iov_base + stream->off, n))) {
+            OBJ_RELEASE(buf);
+            return ret;
+        }
+        len -= n;
+        stream->off += n;
+        if (stream->iov[stream->cur].iov_len <= stream->off) {
+            stream->cur++;
+            stream->off = 0;
+        }
+    }
+    *frag = buf;
+    return ORCM_SUCCESS;
+}
+
+/* drop reassemblies that have gone too long without a fragment -
+ * must be called with the stream lock held
+ */
+static void expire_streams(time_t now)
+{
+    opal_list_item_t *item, *next;
+    orcm_pnp_reassembly_t *ra;
+
+    if (0 == orcm_pnp_base.stream_timeout) {
+        return;
+    }
+    for (item = opal_list_get_first(&orcm_pnp_base.reassembly);
+         item != opal_list_get_end(&orcm_pnp_base.reassembly);
+         item = next) {
+        next = opal_list_get_next(item);
+        ra = (orcm_pnp_reassembly_t*)item;
+        if (now - ra->last < orcm_pnp_base.stream_timeout) {
+            continue;
+        }
+        OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                             "%s pnp:base:stream %u from %s timed out at offset %ld - dropped",
+                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), ra->id,
+                             ORTE_NAME_PRINT(&ra->sender), (long)ra->buf->bytes_used));
+        opal_list_remove_item(&orcm_pnp_base.reassembly, item);
+        OBJ_RELEASE(ra);
+    }
+}
+
+int orcm_pnp_base_reassemble(orte_process_name_t *sender,
+                             uint32_t id, int64_t offset,
+                             int64_t total, uint8_t *data,
+                             size_t len, opal_buffer_t **msg)
+{
+    opal_list_item_t *item;
+    orcm_pnp_reassembly_t *ra=NULL;
+    int ret=ORCM_SUCCESS;
+    time_t now;
+
+    *msg = NULL;
+    now = time(NULL);
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.stream_lock);
+    expire_streams(now);
+    for (item = opal_list_get_first(&orcm_pnp_base.reassembly);
+         item != opal_list_get_end(&orcm_pnp_base.reassembly);
+         item = opal_list_get_next(item)) {
+        ra = (orcm_pnp_reassembly_t*)item;
+        if (id == ra->id &&
+            sender->jobid == ra->sender.jobid &&
+            sender->vpid == ra->sender.vpid) {
+            break;
+        }
+        ra = NULL;
+    }
+
+    if (NULL == ra) {
+        if (0 != offset || total <= 0) {
+            /* we missed the start of it */
+            ret = ORCM_ERR_COMM_FAILURE;
+            goto cleanup;
+        }
+        if (orcm_pnp_base.stream_max_size < total || (uint64_t)SIZE_MAX < (uint64_t)total) {
+            OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                                 "%s pnp:base:stream %u from %s of %ld bytes is too large - dropped",
+                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), id,
+                                 ORTE_NAME_PRINT(sender), (long)total));
+            ret = ORCM_ERR_OUT_OF_RESOURCE;
+            goto cleanup;
+        }
+        ra = OBJ_NEW(orcm_pnp_reassembly_t);
+        ra->sender = *sender;
+        ra->id = id;
+        ra->total = total;
+        /* we know how big it will be, so get the space up front */
+        if (NULL == (ra->buf->base_ptr = (char*)malloc(total))) {
+            OBJ_RELEASE(ra);
+            ret = ORCM_ERR_OUT_OF_RESOURCE;
+            goto cleanup;
+        }
+        ra->buf->bytes_allocated = total;
+        ra->buf->pack_ptr = ra->buf->base_ptr;
+        ra->buf->unpack_ptr = ra->buf->base_ptr;
+        opal_list_append(&orcm_pnp_base.reassembly, &ra->super);
+    }
+
+    if (offset != (int64_t)ra->buf->bytes_used ||
+        total != ra->total || total < offset + (int64_t)len) {
+        /* lost a fragment - give up on the msg */
+        opal_list_remove_item(&orcm_pnp_base.reassembly, &ra->super);
+        OBJ_RELEASE(ra);
+        ret = ORCM_ERR_COMM_FAILURE;
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (ret = orcm_pnp_base_append_raw(ra->buf, data, len))) {
+        opal_list_remove_item(&orcm_pnp_base.reassembly, &ra->super);
+        OBJ_RELEASE(ra);
+        goto cleanup;
+    }
+    ra->last = now;
+
+    if (total == (int64_t)ra->buf->bytes_used) {
+        /* all there - hand it over */
+        opal_list_remove_item(&orcm_pnp_base.reassembly, &ra->super);
+        *msg = ra->buf;
+        ra->buf = NULL;
+        OBJ_RELEASE(ra);
+    }
+
+ cleanup:
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.stream_lock);
+    if (ORCM_ERR_COMM_FAILURE == ret) {
+        OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                             "%s pnp:base:stream %u from %s missing data at offset %ld - dropped",
+                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), id,
+                             ORTE_NAME_PRINT(sender), (long)offset));
+    }
+    return ret;
+}
+
+void orcm_pnp_base_drop_streams(orte_process_name_t *sender)
+{
+    opal_list_item_t *item, *next;
+    orcm_pnp_reassembly_t *ra;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.stream_lock);
+    for (item = opal_list_get_first(&orcm_pnp_base.reassembly);
+         item != opal_list_get_end(&orcm_pnp_base.reassembly);
+         item = next) {
+        next = opal_list_get_next(item);
+        ra = (orcm_pnp_reassembly_t*)item;
+        if (sender->jobid == ra->sender.jobid &&
+            sender->vpid == ra->sender.vpid) {
+            opal_list_remove_item(&orcm_pnp_base.reassembly, item);
+            OBJ_RELEASE(ra);
+        }
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.stream_lock);
+}
+
+void orcm_pnp_base_release_streams(void)
+{
+    opal_list_item_t *item;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.stream_lock);
+    while (NULL != (item = opal_list_remove_first(&orcm_pnp_base.reassembly))) {
+        OBJ_RELEASE(item);
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.stream_lock);
+}
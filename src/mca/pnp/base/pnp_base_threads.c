@@ -11,10 +11,10 @@
 #include "include/constants.h"
 
 #include <stdio.h>
+#include <limits.h>
 
 #include "opal/mca/mca.h"
 #include "opal/mca/base/base.h"
-#include "opal/util/fd.h"
 
 #include "orte/mca/errmgr/errmgr.h"
 #include "orte/util/name_fns.h"
@@ -27,7 +27,12 @@
 #include "mca/pnp/base/private.h"
 
 static void process_msg(orcm_pnp_msg_t *msg);
+static int deliver(orcm_pnp_msg_t *msg, orcm_pnp_channel_obj_t *chan,
+                   orcm_triplet_t *trp, char *string_id,
+                   orcm_pnp_tag_t tag, int8_t flag, bool framed);
 static void* rcv_processing_thread(opal_object_t *obj);
+static int next_batch(orcm_pnp_worker_t *worker, orcm_pnp_msg_t **msgs,
+                      int batch, int *streak);
 static int extract_hdr(opal_buffer_t *buf,
                        orte_process_name_t *name,
                        orte_rmcast_channel_t *channel,
@@ -37,33 +42,73 @@ static int extract_hdr(opal_buffer_t *buf,
 
 int orcm_pnp_base_start_threads(void)
 {
-    int rc;
+    int i, rc;
+    orcm_pnp_worker_t *worker;
 
-    if (!orcm_pnp_base.recv_process_ctl.running) {
-        OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
-                             "%s pnp:base: starting recv processing thread",
-                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
-        /* setup a pipe that we will use to signal the thread that a message
-         * is waiting to be processed - don't define an event for it
-         */
-        if (pipe(orcm_pnp_base.recv_pipe) < 0) {
-            opal_output(0, "%s Cannot open recv processing thread ctl pipe",
-                        ORTE_NAME_PRINT(ORTE_PROC_MY_NAME));
-            return ORTE_ERR_OUT_OF_RESOURCE;
+    /* setup the workers and the queues that we will use to hand
+     * messages to them - these are retained until the framework
+     * closes so late arrivals always have somewhere to go
+     */
+    if (NULL == orcm_pnp_base.workers) {
+        orcm_pnp_base.workers = (orcm_pnp_worker_t**)malloc(orcm_pnp_base.num_workers *
+                                                            sizeof(orcm_pnp_worker_t*));
+        for (i=0; i < orcm_pnp_base.num_workers; i++) {
+            worker = OBJ_NEW(orcm_pnp_worker_t);
+            worker->idx = i;
+            worker->queue = OBJ_NEW(orcm_pnp_queue_t);
+            if (ORCM_SUCCESS != (rc = orcm_pnp_queue_init(worker->queue,
+                                                          orcm_pnp_base.recv_queue_size))) {
+                opal_output(0, "%s Cannot setup recv processing thread queue",
+                            ORTE_NAME_PRINT(ORTE_PROC_MY_NAME));
+                OBJ_RELEASE(worker);
+                for (i--; 0 <= i; i--) {
+                    OBJ_RELEASE(orcm_pnp_base.workers[i]);
+                }
+                free(orcm_pnp_base.workers);
+                orcm_pnp_base.workers = NULL;
+                return rc;
+            }
+            if (orcm_pnp_base.recv_priority) {
+                worker->control = OBJ_NEW(orcm_pnp_queue_t);
+                if (ORCM_SUCCESS != (rc = orcm_pnp_queue_init_lane(worker->control,
+                                                                   orcm_pnp_base.recv_queue_size,
+                                                                   worker->queue))) {
+                    /* just deliver everything in order */
+                    OBJ_RELEASE(worker->control);
+                    worker->control = NULL;
+                }
+            }
+            orcm_pnp_base.workers[i] = worker;
         }
+    }
+
+    if (orcm_pnp_base.recv_progress) {
+        /* the app drains the queue itself */
+        return ORTE_SUCCESS;
+    }
+
+    for (i=0; i < orcm_pnp_base.num_workers; i++) {
+        worker = orcm_pnp_base.workers[i];
+        if (worker->ctl.running) {
+            continue;
+        }
+        OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
+                             "%s pnp:base: starting recv processing thread %d",
+                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), i));
         /* start the thread - we will send it a NULL msg pointer when
          * we want it to stop
          */
-        orcm_pnp_base.recv_process.t_run = rcv_processing_thread;
-        if (ORTE_SUCCESS != (rc = opal_thread_start(&orcm_pnp_base.recv_process))) {
+        worker->thread.t_run = rcv_processing_thread;
+        worker->thread.t_arg = worker;
+        if (ORTE_SUCCESS != (rc = opal_thread_start(&worker->thread))) {
             ORTE_ERROR_LOG(rc);
-            orcm_pnp_base.recv_process_ctl.running = false;
+            worker->ctl.running = false;
             return rc;
         }
 
         OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
-                             "%s pnp:base: recv processing thread started",
-                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+                             "%s pnp:base: recv processing thread %d started",
+                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), i));
     }
 
     return ORTE_SUCCESS;
@@ -72,86 +117,276 @@ int orcm_pnp_base_start_threads(void)
 void orcm_pnp_base_stop_threads(void)
 {
     orcm_pnp_msg_t *msg=NULL;
+    orcm_pnp_worker_t *worker;
+    int i;
 
-    ORTE_ACQUIRE_THREAD(&orcm_pnp_base.recv_process_ctl);
-    if (orcm_pnp_base.recv_process_ctl.running) {
-        ORTE_RELEASE_THREAD(&orcm_pnp_base.recv_process_ctl);
-        if (orte_abnormal_term_ordered) {
-            OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
-                                 "%s pnp:base: killing recv processing thread",
-                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
-            opal_thread_kill(&orcm_pnp_base.recv_process, SIGTERM);
-            orcm_pnp_base.recv_process_ctl.running = false;
-            ORTE_ACQUIRE_THREAD(&orcm_pnp_base.recv_process_ctl);
-        } else {
-            OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
-                                 "%s pnp:base: stopping recv processing thread",
-                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
-            opal_fd_write(orcm_pnp_base.recv_pipe[1], sizeof(orcm_pnp_msg_t*), &msg);
-            opal_thread_join(&orcm_pnp_base.recv_process, NULL);
-            ORTE_ACQUIRE_THREAD(&orcm_pnp_base.recv_process_ctl);
+    if (NULL == orcm_pnp_base.workers) {
+        return;
+    }
+
+    for (i=0; i < orcm_pnp_base.num_workers; i++) {
+        worker = orcm_pnp_base.workers[i];
+        ORTE_ACQUIRE_THREAD(&worker->ctl);
+        if (worker->ctl.running) {
+            ORTE_RELEASE_THREAD(&worker->ctl);
+            if (orte_abnormal_term_ordered) {
+                OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
+                                     "%s pnp:base: killing recv processing thread %d",
+                                     ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), i));
+                opal_thread_kill(&worker->thread, SIGTERM);
+                worker->ctl.running = false;
+                ORTE_ACQUIRE_THREAD(&worker->ctl);
+            } else {
+                OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
+                                     "%s pnp:base: stopping recv processing thread %d",
+                                     ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), i));
+                orcm_pnp_queue_push(worker->queue, msg, true);
+                opal_thread_join(&worker->thread, NULL);
+                ORTE_ACQUIRE_THREAD(&worker->ctl);
+            }
         }
+        ORTE_RELEASE_THREAD(&worker->ctl);
     }
-    ORTE_RELEASE_THREAD(&orcm_pnp_base.recv_process_ctl);
 
     OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
                          "%s pnp:base: all threads stopped",
                          ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
 }
 
+/* control msgs are the ones that drive failure detection and
+ * recovery, or bring new procs into the system. State changes and
+ * terminate requests stay behind the sender's data so they cannot
+ * overtake msgs sent before them
+ */
+static bool is_control(orcm_pnp_msg_t *msg)
+{
+    char *ptr;
+    orcm_triplet_handle_t handle;
+    orcm_pnp_tag_t tag;
+    int8_t flag;
+    int rc;
+
+    if (ORCM_PNP_HEARTBEAT_CHANNEL == msg->channel ||
+        ORCM_PNP_ERROR_CHANNEL == msg->channel) {
+        return true;
+    }
+
+    /* peek at the tag without disturbing the buffer */
+    ptr = msg->buf.unpack_ptr;
+    rc = orcm_pnp_base_unpack_header(&msg->buf, &handle, &tag, &flag);
+    msg->buf.unpack_ptr = ptr;
+    if (ORCM_SUCCESS != rc) {
+        /* let process_msg complain about it */
+        return false;
+    }
+
+    switch (tag) {
+    case ORCM_PNP_TAG_ANNOUNCE:
+    case ORCM_PNP_TAG_BOOTSTRAP:
+    case ORCM_PNP_TAG_HEARTBEAT:
+    case ORCM_PNP_TAG_ERRMGR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* select the queue for this msg - all msgs from a given sender land
+ * on the same worker so they are delivered in the order they were
+ * recvd, while msgs from unrelated senders can be processed in
+ * parallel. Control msgs jump ahead of any data from the sender
+ * still waiting to be processed
+ */
+orcm_pnp_queue_t* orcm_pnp_base_recv_queue(orcm_pnp_msg_t *msg)
+{
+    orcm_pnp_worker_t *worker;
+    uint32_t hash;
+
+    if (1 == orcm_pnp_base.num_workers) {
+        worker = orcm_pnp_base.workers[0];
+    } else {
+        hash = (uint32_t)msg->sender.jobid * 2654435761U;
+        hash ^= (uint32_t)msg->sender.vpid + 0x9e3779b9U + (hash << 6) + (hash >> 2);
+        worker = orcm_pnp_base.workers[hash % orcm_pnp_base.num_workers];
+    }
+    if (NULL != worker->control && is_control(msg)) {
+        return worker->control;
+    }
+    return worker->queue;
+}
+
+/* pull the next batch of msgs off a worker's queues, taking control
+ * msgs first unless data has been waiting through too many passes
+ */
+static int next_batch(orcm_pnp_worker_t *worker, orcm_pnp_msg_t **msgs,
+                      int batch, int *streak)
+{
+    int n=0;
+
+    if (NULL != worker->control &&
+        (0 == orcm_pnp_base.recv_priority_weight ||
+         *streak < orcm_pnp_base.recv_priority_weight)) {
+        if (0 < (n = orcm_pnp_queue_pop(worker->control, (void**)msgs, batch))) {
+            (*streak)++;
+        }
+    }
+    if (0 == n) {
+        /* give the data a turn */
+        *streak = 0;
+        n = orcm_pnp_queue_pop(worker->queue, (void**)msgs, batch);
+        if (0 == n && NULL != worker->control) {
+            n = orcm_pnp_queue_pop(worker->control, (void**)msgs, batch);
+        }
+    }
+    return n;
+}
+
+/* the app's thread stands in for the processing thread - it waits
+ * on the queue's wakeup fd in its own event loop, and only the one
+ * thread may drive progress
+ */
+static bool progress_armed=false;
+static int progress_streak=0;
+
+int orcm_pnp_base_progress_fd(void)
+{
+    if (!orcm_pnp_base.recv_progress || NULL == orcm_pnp_base.workers) {
+        return -1;
+    }
+    return orcm_pnp_base.workers[0]->queue->wakeup[0];
+}
+
+int orcm_pnp_base_progress(int max_msgs)
+{
+    orcm_pnp_worker_t *worker;
+    orcm_pnp_msg_t *msgs[ORCM_PNP_MAX_MSGS];
+    int i, n, batch, done=0;
+
+    if (!orcm_pnp_base.recv_progress) {
+        return ORCM_ERR_NOT_SUPPORTED;
+    }
+    if (NULL == orcm_pnp_base.workers) {
+        /* nothing can have arrived yet */
+        return 0;
+    }
+    worker = orcm_pnp_base.workers[0];
+
+    if (progress_armed) {
+        progress_armed = false;
+        if (ORCM_SUCCESS != orcm_pnp_queue_disarm(worker->queue)) {
+            return ORCM_ERROR;
+        }
+    }
+
+    while (0 >= max_msgs || done < max_msgs) {
+        batch = ORCM_PNP_MAX_MSGS;
+        if (orcm_pnp_base.recv_batch_size < batch) {
+            batch = orcm_pnp_base.recv_batch_size;
+        }
+        if (0 < max_msgs && max_msgs - done < batch) {
+            batch = max_msgs - done;
+        }
+        if (0 == (n = next_batch(worker, msgs, batch, &progress_streak))) {
+            if (0 < done) {
+                /* let the caller decide whether to come back */
+                break;
+            }
+            if (orcm_pnp_queue_arm(worker->queue)) {
+                /* the fd signals the next arrival */
+                progress_armed = true;
+                break;
+            }
+            continue;
+        }
+        for (i=0; i < n; i++) {
+            if (NULL != msgs[i]) {
+                /* processing function releases the msg */
+                process_msg(msgs[i]);
+            }
+        }
+        done += n;
+    }
+    return done;
+}
 
 static void* rcv_processing_thread(opal_object_t *obj)
 {
-    orcm_pnp_msg_t *msg;
-    int rc;
+    orcm_pnp_worker_t *worker = (orcm_pnp_worker_t*)((opal_thread_t*)obj)->t_arg;
+    orcm_pnp_msg_t **msgs;
+    int i, n, batch, streak=0;
     struct timespec tp={0, 10};
 
     OPAL_OUTPUT_VERBOSE((5, orcm_pnp_base.output,
-                         "%s pnp:base: recv processing thread operational",
-                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+                         "%s pnp:base: recv processing thread %d operational",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), worker->idx));
+
+    batch = orcm_pnp_base.recv_batch_size;
+    msgs = (orcm_pnp_msg_t**)malloc(batch * sizeof(orcm_pnp_msg_t*));
 
-    ORTE_ACQUIRE_THREAD(&orcm_pnp_base.recv_process_ctl);
-    orcm_pnp_base.recv_process_ctl.running = true;
-    ORTE_RELEASE_THREAD(&orcm_pnp_base.recv_process_ctl);
+    ORTE_ACQUIRE_THREAD(&worker->ctl);
+    worker->ctl.running = true;
+    ORTE_RELEASE_THREAD(&worker->ctl);
 
     while (1) {
-        /* block here until a trigger arrives */
-        if (0 > (rc = opal_fd_read(orcm_pnp_base.recv_pipe[0],
-                                   sizeof(orcm_pnp_msg_t*), &msg))) {
-            /* if something bad happened, punt */
-            opal_output(0, "%s PUNTING THREAD", ORTE_NAME_PRINT(ORTE_PROC_MY_NAME));
-            ORTE_ACQUIRE_THREAD(&orcm_pnp_base.recv_process_ctl);
-            orcm_pnp_base.recv_process_ctl.running = false;
-            ORTE_RELEASE_THREAD(&orcm_pnp_base.recv_process_ctl);
-            /* give a little delay to ensure the main thread gets into
-             * opal_thread_join before we exit
-             */
-            nanosleep(&tp, NULL);
-            return OPAL_THREAD_CANCELLED;
-        }
-        /* check to see if we were told to stop */
-        if (NULL == msg) {
-            ORTE_ACQUIRE_THREAD(&orcm_pnp_base.recv_process_ctl);
-            orcm_pnp_base.recv_process_ctl.running = false;
-            ORTE_RELEASE_THREAD(&orcm_pnp_base.recv_process_ctl);
-            return OPAL_THREAD_CANCELLED;
+        /* drain whatever is waiting, up to a batch at a time,
+         * taking control msgs first
+         */
+        if (0 == (n = next_batch(worker, msgs, batch, &streak))) {
+            /* nothing there - block here until a trigger arrives */
+            if (ORCM_SUCCESS != orcm_pnp_queue_wait(worker->queue)) {
+                /* if something bad happened, punt */
+                opal_output(0, "%s PUNTING THREAD", ORTE_NAME_PRINT(ORTE_PROC_MY_NAME));
+                ORTE_ACQUIRE_THREAD(&worker->ctl);
+                worker->ctl.running = false;
+                ORTE_RELEASE_THREAD(&worker->ctl);
+                free(msgs);
+                /* give a little delay to ensure the main thread gets into
+                 * opal_thread_join before we exit
+                 */
+                nanosleep(&tp, NULL);
+                return OPAL_THREAD_CANCELLED;
+            }
+            continue;
         }
 
-        /* process it - processing function releases the msg */
-        process_msg(msg);
+        for (i=0; i < n; i++) {
+            /* check to see if we were told to stop */
+            if (NULL == msgs[i]) {
+                /* release anything that snuck in behind the stop */
+                for (i++; i < n; i++) {
+                    if (NULL != msgs[i]) {
+                        OBJ_RELEASE(msgs[i]);
+                    }
+                }
+                while (NULL != worker->control &&
+                       0 < (n = orcm_pnp_queue_pop(worker->control, (void**)msgs, batch))) {
+                    for (i=0; i < n; i++) {
+                        if (NULL != msgs[i]) {
+                            OBJ_RELEASE(msgs[i]);
+                        }
+                    }
+                }
+                free(msgs);
+                ORTE_ACQUIRE_THREAD(&worker->ctl);
+                worker->ctl.running = false;
+                ORTE_RELEASE_THREAD(&worker->ctl);
+                return OPAL_THREAD_CANCELLED;
+            }
+            /* process it - processing function releases the msg */
+            process_msg(msgs[i]);
+        }
     }
 }
 
 static void process_msg(orcm_pnp_msg_t *msg)
 {
-    int n, rc;
+    int rc;
     int8_t flag;
-    int32_t i, num_iovecs, num_bytes;
-    struct iovec *iovecs=NULL;
     orcm_pnp_tag_t tag;
-    char *string_id=NULL;
+    orcm_pnp_channel_t channel;
+    orcm_triplet_handle_t handle;
+    char *string_id;
     orcm_pnp_channel_obj_t *chan;
-    orcm_pnp_request_t *request;
     orcm_triplet_t *trp;
     orcm_source_t *src;
 
@@ -160,19 +395,14 @@ static void process_msg(orcm_pnp_msg_t *msg)
                          ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
                          ORTE_NAME_PRINT(&msg->sender)));
 
-    /* extract the string id of the sender's triplet */
-    n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, &string_id, &n, OPAL_STRING))) {
-        ORTE_ERROR_LOG(rc);
-        goto DEPART;
-    }    
-    
-    /* extract the pnp tag */
-    n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, &tag, &n, ORCM_PNP_TAG_T))) {
+    /* extract the handle of the sender's triplet, the pnp tag
+     * and the iovec vs buffer flag
+     */
+    if (ORCM_SUCCESS != (rc = orcm_pnp_base_unpack_header(&msg->buf, &handle, &tag, &flag))) {
         ORTE_ERROR_LOG(rc);
         goto DEPART;
     }
+    orcm_pnp_base_metrics_in(msg->channel, tag, msg->buf.bytes_used);
 
     /* if this is an announcement, process it immediately - do not
      * push it onto the recv thread! Otherwise, any immediate msgs
@@ -183,17 +413,38 @@ static void process_msg(orcm_pnp_msg_t *msg)
                              "%s Processing announcement from %s",
                              ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
                              ORTE_NAME_PRINT(&msg->sender)));
+        orcm_pnp_base_process_announcements(&msg->sender, &msg->buf);
+        goto DEPART;
+    }
 
-        free(string_id);
-        /* unpack the iovec vs buffer flag to maintain place in buffer */
-        n=1;
-        if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, &flag, &n, OPAL_INT8))) {
-            ORTE_ERROR_LOG(rc);
+    /* someone wants to know how we are doing */
+    if (ORCM_PNP_TAG_METRICS == tag && ORCM_PNP_DIRECT_CHANNEL == msg->channel) {
+        orcm_pnp_base_answer_metrics(&msg->sender);
+        goto DEPART;
+    }
+
+    /* map the handle to the sender's triplet - if we don't know
+     * the triplet, then nobody can have registered for its msgs
+     */
+    if (NULL == (trp = orcm_get_triplet_handle(handle))) {
+        OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                             "%s Message from %s with unknown triplet handle %u ignored",
+                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                             ORTE_NAME_PRINT(&msg->sender), handle));
+        orcm_pnp_base_metrics_drop(msg->channel, tag, ORCM_PNP_DROP_NO_RECV);
+        goto DEPART;
+    }
+    if (trp->handle_shared) {
+        /* can't tell which triplet this is from the handle */
+        ORTE_RELEASE_THREAD(&trp->ctl);
+        if (NULL == (trp = orcm_get_triplet_process(&msg->sender))) {
             goto DEPART;
         }
-        orcm_pnp_base_process_announcements(&msg->sender, &msg->buf);
-        goto DEPART;
     }
+    /* triplets persist until finalize and their stringid never
+     * changes, so we can hang onto it after releasing the lock
+     */
+    string_id = trp->string_id;
 
     /* if this is coming on our direct channel, then always listen to
      * it. Otherwise, check to see if the message is from the leader of
@@ -204,9 +455,6 @@ static void process_msg(orcm_pnp_msg_t *msg)
          * have received notification of death while waiting
          * for this message to be processed
          */
-        if (NULL == (trp = orcm_get_triplet_stringid(string_id))) {
-            goto DEPART;
-        }
         if (NULL == (src = orcm_get_source(trp, &msg->sender, false))) {
             ORTE_RELEASE_THREAD(&trp->ctl);
             goto DEPART;
@@ -219,98 +467,387 @@ static void process_msg(orcm_pnp_msg_t *msg)
         ORTE_RELEASE_THREAD(&src->ctl);
         ORTE_RELEASE_THREAD(&trp->ctl);
     } else {
+        ORTE_RELEASE_THREAD(&trp->ctl);
         if (!orcm_leader.deliver_msg(string_id, &msg->sender)) {
             OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
                                  "%s Message from %s of triplet %s ignored - not leader",
                                  ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
                                  ORTE_NAME_PRINT(&msg->sender), string_id));
+            orcm_pnp_base_metrics_drop(msg->channel, tag, ORCM_PNP_DROP_NOT_LEADER);
             goto DEPART;
         }
     }
 
-    /* deal with alias */
+    /* deal with alias - the msg keeps the channel it came in on */
     if (ORCM_PNP_DIRECT_CHANNEL == msg->channel) {
-        msg->channel = orcm_pnp_base.my_input_channel->channel;
+        channel = orcm_pnp_base.my_input_channel->channel;
+    } else {
+        channel = msg->channel;
     }
 
     /* get the channel object */
-    if (NULL == (chan = (orcm_pnp_channel_obj_t*)opal_pointer_array_get_item(&orcm_pnp_base.channels, msg->channel))) {
+    if (NULL == (chan = (orcm_pnp_channel_obj_t*)opal_pointer_array_get_item(&orcm_pnp_base.channels, channel))) {
         /* unrecognized channel - ignore message */
         OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
                              "%s Unrecognized channel %s",
                              ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
-                             orcm_pnp_print_channel(msg->channel)));
+                             orcm_pnp_print_channel(channel)));
+        orcm_pnp_base_metrics_drop(msg->channel, tag, ORCM_PNP_DROP_NO_RECV);
+        goto DEPART;
+    }
+
+    if (ORCM_PNP_MSG_BATCH != flag) {
+        deliver(msg, chan, trp, string_id, tag, flag, false);
         goto DEPART;
     }
 
-    /* find the request object for this tag */
-    if (NULL == (request = orcm_pnp_base_find_request(&chan->recvs, string_id, tag))) {
+    /* a frame of batched msgs - each carries its own tag and flag */
+    while (msg->buf.unpack_ptr < msg->buf.base_ptr + msg->buf.bytes_used) {
+        if (ORCM_SUCCESS != (rc = orcm_pnp_base_unpack_entry(&msg->buf, &tag, &flag))) {
+            ORTE_ERROR_LOG(rc);
+            goto DEPART;
+        }
+        if (ORCM_SUCCESS != deliver(msg, chan, trp, string_id, tag, flag, true)) {
+            /* can't find the start of the next msg */
+            goto DEPART;
+        }
+    }
+
+ DEPART:
+    orcm_pnp_base_return_msg(msg);
+}
+
+/* hand a piece of a msg to a recv that takes msgs piece by piece */
+static void deliver_piece(orcm_pnp_msg_t *msg, orcm_pnp_request_t *request,
+                          orcm_pnp_tag_t tag, uint32_t id,
+                          int64_t offset, int64_t total,
+                          void *data, size_t len, bool last)
+{
+    uint64_t start;
+
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:default:received %lu bytes at offset %ld of stream %u - delivering",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                         (unsigned long)len, (long)offset, id));
+    start = orcm_pnp_base_metrics_now();
+    request->stream_cbfunc(ORCM_SUCCESS, &msg->sender, tag, id, offset, total,
+                           (uint8_t*)data, len, last, request->cbdata);
+    orcm_pnp_base_metrics_callback(msg->channel, tag, msg->queued, start,
+                                   orcm_pnp_base_metrics_now());
+}
+
+/* hand a whole msg to its recv */
+static void deliver_msg(orcm_pnp_msg_t *msg, orcm_pnp_request_t *request,
+                        orcm_pnp_tag_t tag, struct iovec *iovecs, int count,
+                        opal_buffer_t *buf)
+{
+    uint64_t start;
+
+    start = orcm_pnp_base_metrics_now();
+    request->cbfunc(ORCM_SUCCESS, &msg->sender, tag, iovecs, count, buf, request->cbdata);
+    orcm_pnp_base_metrics_callback(msg->channel, tag, msg->queued, start,
+                                   orcm_pnp_base_metrics_now());
+}
+
+/* hand a decoded msg to each of the n recvs that matched it. Every recv
+ * sees the same iovecs or buffer - nothing is copied per recv. The
+ * buffer is rewound to the start of the payload for each recv, and
+ * holds an extra reference while any recv after the current one still
+ * needs it, which tells orcm_pnp_retain_buffer to copy rather than take
+ * the storage - so only the very last recv can take it, whatever kind
+ * of recv comes after. Recvs that take msgs piece by piece are skipped
+ * unless pieces is set, and recvs with an executor get a copy queued
+ * to it
+ */
+static void fan_out(orcm_pnp_msg_t *msg, int n, orcm_pnp_tag_t tag,
+                    struct iovec *iovecs, int count, opal_buffer_t *buf,
+                    bool pieces)
+{
+    orcm_pnp_request_t *request;
+    opal_buffer_t *ref;
+    char *payload=NULL;
+    size_t avail=0, total;
+    int64_t offset;
+    int i, k, last;
+
+    /* find the last recv that gets the msg */
+    for (last=n-1; 0 <= last; last--) {
+        if (pieces || NULL == msg->recvs[last]->stream_cbfunc) {
+            break;
+        }
+    }
+    if (NULL != buf) {
+        payload = buf->unpack_ptr;
+        avail = buf->bytes_used - (buf->unpack_ptr - buf->base_ptr);
+    }
+    for (i=0, total=0; NULL != iovecs && i < count; i++) {
+        total += iovecs[i].iov_len;
+    }
+
+    for (k=0; k <= last; k++) {
+        request = msg->recvs[k];
+        if (NULL != buf) {
+            /* undo whatever the previous recv read */
+            buf->unpack_ptr = payload;
+        }
+        if (NULL != request->stream_cbfunc) {
+            if (!pieces) {
+                continue;
+            }
+            if (NULL != buf) {
+                deliver_piece(msg, request, tag, 0, 0, avail, payload, avail, true);
+                continue;
+            }
+            /* each iovec is a piece */
+            if (0 == count) {
+                deliver_piece(msg, request, tag, 0, 0, 0, NULL, 0, true);
+            }
+            for (i=0, offset=0; i < count; i++) {
+                deliver_piece(msg, request, tag, 0, offset, total,
+                              iovecs[i].iov_base, iovecs[i].iov_len,
+                              (i == count-1));
+                offset += iovecs[i].iov_len;
+            }
+            continue;
+        }
+        if (NULL != request->executor) {
+            /* the executor takes its own copy */
+            orcm_pnp_base_exec_submit(request, msg, tag, iovecs, count, buf);
+            continue;
+        }
+        if (NULL == buf || k == last) {
+            /* the last recv may take the storage */
+            deliver_msg(msg, request, tag, iovecs, count, buf);
+            continue;
+        }
+        OBJ_RETAIN(buf);
+        deliver_msg(msg, request, tag, iovecs, count, buf);
+        ref = buf;
+        OBJ_RELEASE(ref);
+    }
+}
+
+/* take the next fragment of a streamed msg */
+static int deliver_fragment(orcm_pnp_msg_t *msg, int n, orcm_pnp_tag_t tag)
+{
+    int k, rc;
+    int32_t num;
+    uint32_t id;
+    int64_t offset, total;
+    int32_t len;
+    size_t avail;
+    bool whole_wanted=false;
+    opal_buffer_t *whole;
+
+    num=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, &id, &num, OPAL_UINT32))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    num=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, &offset, &num, OPAL_INT64))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    num=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, &total, &num, OPAL_INT64))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    num=1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, &len, &num, OPAL_INT32))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    avail = msg->buf.bytes_used - (msg->buf.unpack_ptr - msg->buf.base_ptr);
+    if (len < 0 || avail < (size_t)len) {
+        rc = ORCM_ERR_UNPACK_READ_PAST_END_OF_BUFFER;
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+
+    /* recvs that stream get each fragment as it comes */
+    for (k=0; k < n; k++) {
+        if (NULL != msg->recvs[k]->stream_cbfunc) {
+            deliver_piece(msg, msg->recvs[k], tag, id, offset, total,
+                          msg->buf.unpack_ptr, len, (total <= offset + len));
+        } else {
+            whole_wanted = true;
+        }
+    }
+    /* the rest get the msg once it is whole - it is only put
+     * back together once, however many want it
+     */
+    if (whole_wanted &&
+        ORCM_SUCCESS == orcm_pnp_base_reassemble(&msg->sender, id, offset, total,
+                                                 (uint8_t*)msg->buf.unpack_ptr,
+                                                 len, &whole) &&
+        NULL != whole) {
+        OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                             "%s pnp:default:reassembled stream %u - delivering msg",
+                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), id));
+        fan_out(msg, n, tag, NULL, 0, whole, false);
+        OBJ_RELEASE(whole);
+    }
+    msg->buf.unpack_ptr += len;
+    return ORCM_SUCCESS;
+}
+
+/* hand one msg to every matching recv. The payload is decoded once
+ * and consumed from the buffer whether or not anyone wants it so that
+ * the next msg in a batched frame can be found
+ */
+static int deliver(orcm_pnp_msg_t *msg, orcm_pnp_channel_obj_t *chan,
+                   orcm_triplet_t *trp, char *string_id,
+                   orcm_pnp_tag_t tag, int8_t flag, bool framed)
+{
+    int k, n, rc=ORCM_SUCCESS;
+    uint32_t i, num_iovecs=0, num_bytes;
+    struct iovec *iovecs=NULL;
+    size_t total, avail;
+    uint8_t *ptr;
+    opal_buffer_t *slice, *whole;
+
+    /* find the request objects for this tag */
+    n = orcm_pnp_base_lookup_requests(chan, &trp->key, trp->handle, tag,
+                                      &msg->recvs, &msg->max_recvs);
+    if (0 == n) {
         /* no matching requests */
         OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
                              "%s pnp:default:recv triplet %s has no matching recvs for channel %s tag %s",
                              ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
                              string_id, orcm_pnp_print_channel(msg->channel), orcm_pnp_print_tag(tag)));
-        goto DEPART;
+        orcm_pnp_base_metrics_drop(msg->channel, tag, ORCM_PNP_DROP_NO_RECV);
+        if (!framed) {
+            return ORCM_SUCCESS;
+        }
     }
 
-    /* unpack the iovec vs buffer flag */
-    n=1;
-    if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, &flag, &n, OPAL_INT8))) {
-        ORTE_ERROR_LOG(rc);
-        goto DEPART;
-    }    
-    
-    if (0 == flag) {
+    if (ORCM_PNP_MSG_FRAGMENT == flag) {
+        return deliver_fragment(msg, n, tag);
+    }
+
+    if (ORCM_PNP_MSG_COMPRESSED == flag) {
+        if (ORCM_SUCCESS != (rc = orcm_pnp_base_decompress_payload(&msg->buf, &whole))) {
+            return rc;
+        }
+        OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                             "%s pnp:default:received compressed buffer - delivering msg",
+                             ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+        fan_out(msg, n, tag, NULL, 0, whole, true);
+        OBJ_RELEASE(whole);
+        return ORCM_SUCCESS;
+    }
+
+    if (ORCM_PNP_MSG_IOVECS == flag) {
         /* iovecs were sent - get them */
-        n=1;
-        if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, &num_iovecs, &n, OPAL_INT32))) {
+        if (ORCM_SUCCESS != (rc = orcm_pnp_base_unpack_raw32(&msg->buf, &num_iovecs))) {
             ORTE_ERROR_LOG(rc);
-            goto DEPART;
+            return rc;
+        }
+        /* the count came off the wire - each iovec needs at least
+         * its size in what is left, so don't believe more than that
+         */
+        avail = msg->buf.bytes_used - (msg->buf.unpack_ptr - msg->buf.base_ptr);
+        if (avail / sizeof(uint32_t) < num_iovecs || (uint32_t)INT_MAX < num_iovecs) {
+            rc = ORCM_ERR_UNPACK_READ_PAST_END_OF_BUFFER;
+            ORTE_ERROR_LOG(rc);
+            return rc;
         }
+        total = 0;
         if (0 < num_iovecs) {
-            iovecs = (struct iovec *)malloc(num_iovecs * sizeof(struct iovec));
+            if (NULL == (iovecs = (struct iovec *)malloc(num_iovecs * sizeof(struct iovec)))) {
+                ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+                return ORCM_ERR_OUT_OF_RESOURCE;
+            }
             for (i=0; i < num_iovecs; i++) {
-                n=1;
-                if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, &num_bytes, &n, OPAL_INT32))) {
+                if (ORCM_SUCCESS != (rc = orcm_pnp_base_unpack_raw32(&msg->buf, &num_bytes))) {
                     ORTE_ERROR_LOG(rc);
-                    goto DEPART;
+                    goto cleanup;
                 }
                 iovecs[i].iov_len = num_bytes;
-                if (0 < num_bytes) {
-                    iovecs[i].iov_base = (uint8_t*)malloc(num_bytes);
-                    if (ORCM_SUCCESS != (rc = opal_dss.unpack(&msg->buf, iovecs[i].iov_base, &num_bytes, OPAL_UINT8))) {
-                        ORTE_ERROR_LOG(rc);
-                        goto DEPART;
-                    }
+                total += num_bytes;
+            }
+            /* the bytes follow the header raw - just point the
+             * iovecs at them in the buffer
+             */
+            avail = msg->buf.bytes_used - (msg->buf.unpack_ptr - msg->buf.base_ptr);
+            if (avail < total) {
+                rc = ORCM_ERR_UNPACK_READ_PAST_END_OF_BUFFER;
+                ORTE_ERROR_LOG(rc);
+                goto cleanup;
+            }
+            ptr = (uint8_t*)msg->buf.unpack_ptr;
+            for (i=0; i < num_iovecs; i++) {
+                if (0 < iovecs[i].iov_len) {
+                    iovecs[i].iov_base = ptr;
+                    ptr += iovecs[i].iov_len;
                 } else {
                     iovecs[i].iov_base = NULL;
                 }
             }
+            msg->buf.unpack_ptr = (char*)ptr;
         }
         OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
                              "%s pnp:default:received input iovecs - delivering msg",
                              ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+        fan_out(msg, n, tag, iovecs, num_iovecs, NULL, true);
+        goto cleanup;
+    }
 
-        request->cbfunc(ORCM_SUCCESS, &msg->sender, tag, iovecs, num_iovecs, NULL, request->cbdata);
-        /* release the memory */
-        if (0 < num_iovecs) {
-            for (i=0; i < num_iovecs; i++) {
-                free(iovecs[i].iov_base);
-            }
-            free(iovecs);
-        }
-        goto DEPART;
+    if (ORCM_PNP_MSG_BUFFER != flag) {
+        rc = ORCM_ERR_UNPACK_FAILURE;
+        ORTE_ERROR_LOG(rc);
+        return rc;
     }
 
-    if (1 == flag) {
+    if (!framed) {
         /* buffer was sent - just hand it over */
         OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
                              "%s pnp:default:received input buffer - delivering msg",
                              ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
-        request->cbfunc(ORCM_SUCCESS, &msg->sender, tag, NULL, 0, &msg->buf, request->cbdata);
+        fan_out(msg, n, tag, NULL, 0, &msg->buf, true);
+        return ORCM_SUCCESS;
     }
- DEPART:
-    OBJ_RELEASE(msg);
+
+    /* a batched buffer shares the frame with the msgs around it,
+     * so give the recipients a buffer holding only its own bytes
+     */
+    if (ORCM_SUCCESS != (rc = orcm_pnp_base_unpack_raw32(&msg->buf, &num_bytes))) {
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    avail = msg->buf.bytes_used - (msg->buf.unpack_ptr - msg->buf.base_ptr);
+    if (avail < (size_t)num_bytes) {
+        rc = ORCM_ERR_UNPACK_READ_PAST_END_OF_BUFFER;
+        ORTE_ERROR_LOG(rc);
+        return rc;
+    }
+    for (k=0; k < n && NULL != msg->recvs[k]->stream_cbfunc; k++);
+    if (k == n) {
+        /* only recvs that stream - they can read it in place */
+        for (k=0; k < n; k++) {
+            deliver_piece(msg, msg->recvs[k], tag, 0, 0, num_bytes,
+                          msg->buf.unpack_ptr, num_bytes, true);
+        }
+    } else {
+        slice = orcm_pnp_base_get_buffer(num_bytes);
+        if (ORCM_SUCCESS == (rc = orcm_pnp_base_append_raw(slice, msg->buf.unpack_ptr, num_bytes))) {
+            OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                                 "%s pnp:default:received batched buffer - delivering msg",
+                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+            fan_out(msg, n, tag, NULL, 0, slice, true);
+        }
+        orcm_pnp_base_return_buffer(slice);
+    }
+    msg->buf.unpack_ptr += num_bytes;
+    return rc;
+
+ cleanup:
+    if (NULL != iovecs) {
+        free(iovecs);
+    }
+    return rc;
 }
 
 void orcm_pnp_base_recv_input_buffers(int status,
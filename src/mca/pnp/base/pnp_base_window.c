@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include <stdio.h>
+
+#include "opal/class/opal_list.h"
+#include "opal/class/opal_hash_table.h"
+#include "opal/threads/mutex.h"
+#include "opal/threads/condition.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "mca/pnp/base/public.h"
+#include "mca/pnp/base/private.h"
+
+/*
+ * Non-blocking sends are metered per multicast channel and per p2p
+ * peer. A send is charged against its window just before it is handed
+ * to the transport and credited back when the transport is done with
+ * it. A send that would overflow the window either waits for room, is
+ * parked until room frees up (dropping the oldest parked send if the
+ * backlog is full), or is refused - depending on the policy. A window
+ * always admits one send so a msg larger than the byte limit cannot
+ * wedge it.
+ */
+
+static inline uint64_t peer_key(const orte_process_name_t *peer)
+{
+    return ((uint64_t)peer->jobid << 32) | (uint64_t)peer->vpid;
+}
+
+static orcm_pnp_window_t* get_window(orcm_pnp_send_t *send)
+{
+    orcm_pnp_window_t *win=NULL;
+    void *ptr;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.window_lock);
+    if (send->multicast) {
+        if (OPAL_SUCCESS == opal_hash_table_get_value_uint32(&orcm_pnp_base.channel_windows,
+                                                             send->channel, &ptr)) {
+            win = (orcm_pnp_window_t*)ptr;
+        } else {
+            win = OBJ_NEW(orcm_pnp_window_t);
+            opal_hash_table_set_value_uint32(&orcm_pnp_base.channel_windows,
+                                             send->channel, win);
+        }
+    } else {
+        if (OPAL_SUCCESS == opal_hash_table_get_value_uint64(&orcm_pnp_base.peer_windows,
+                                                             peer_key(&send->target), &ptr)) {
+            win = (orcm_pnp_window_t*)ptr;
+        } else {
+            win = OBJ_NEW(orcm_pnp_window_t);
+            opal_hash_table_set_value_uint64(&orcm_pnp_base.peer_windows,
+                                             peer_key(&send->target), win);
+        }
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.window_lock);
+    return win;
+}
+
+static bool window_full(orcm_pnp_window_t *win, int32_t bytes)
+{
+    if (0 == win->msgs) {
+        return false;
+    }
+    if (0 < orcm_pnp_base.window_msgs && orcm_pnp_base.window_msgs <= win->msgs) {
+        return true;
+    }
+    if (0 < orcm_pnp_base.window_bytes &&
+        (int64_t)orcm_pnp_base.window_bytes < win->bytes + bytes) {
+        return true;
+    }
+    return false;
+}
+
+static void charge(orcm_pnp_window_t *win, orcm_pnp_send_t *send)
+{
+    win->msgs++;
+    win->bytes += send->bytes;
+    send->window = win;
+}
+
+int orcm_pnp_base_window_charge(orcm_pnp_send_t *send)
+{
+    orcm_pnp_window_t *win;
+    orcm_pnp_send_t *dropped=NULL;
+
+    if (!orcm_pnp_base.send_window) {
+        return ORCM_SUCCESS;
+    }
+    win = get_window(send);
+
+    OPAL_THREAD_LOCK(&win->lock);
+    /* nobody jumps ahead of sends that are already parked */
+    while (window_full(win, send->bytes) ||
+           0 < opal_list_get_size(&win->backlog)) {
+        if (ORCM_PNP_WINDOW_BLOCK == orcm_pnp_base.window_policy) {
+            opal_condition_wait(&win->cond, &win->lock);
+            continue;
+        }
+        if (ORCM_PNP_WINDOW_EAGAIN == orcm_pnp_base.window_policy) {
+            OPAL_THREAD_UNLOCK(&win->lock);
+            return ORCM_ERR_WOULD_BLOCK;
+        }
+        /* park it, making room if necessary */
+        if (orcm_pnp_base.window_backlog <= (int)opal_list_get_size(&win->backlog)) {
+            dropped = (orcm_pnp_send_t*)opal_list_remove_first(&win->backlog);
+        }
+        opal_list_append(&win->backlog, &send->super);
+        OPAL_THREAD_UNLOCK(&win->lock);
+
+        if (NULL != dropped) {
+            OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                                 "%s pnp:base:window full - dropping oldest send",
+                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+            orcm_pnp_base_report_send(dropped, ORCM_ERR_TEMP_OUT_OF_RESOURCE);
+            orcm_pnp_base_return_send(dropped);
+        }
+        return ORCM_ERR_RESOURCE_BUSY;
+    }
+    charge(win, send);
+    OPAL_THREAD_UNLOCK(&win->lock);
+    return ORCM_SUCCESS;
+}
+
+orcm_pnp_send_t* orcm_pnp_base_window_release(orcm_pnp_send_t *send)
+{
+    orcm_pnp_window_t *win;
+    orcm_pnp_send_t *next=NULL;
+
+    if (NULL == (win = send->window)) {
+        return NULL;
+    }
+    send->window = NULL;
+
+    OPAL_THREAD_LOCK(&win->lock);
+    win->msgs--;
+    win->bytes -= send->bytes;
+    /* start the next parked send if it now fits */
+    if (0 < opal_list_get_size(&win->backlog)) {
+        next = (orcm_pnp_send_t*)opal_list_get_first(&win->backlog);
+        if (window_full(win, next->bytes)) {
+            next = NULL;
+        } else {
+            opal_list_remove_first(&win->backlog);
+            charge(win, next);
+        }
+    }
+    opal_condition_broadcast(&win->cond);
+    OPAL_THREAD_UNLOCK(&win->lock);
+    return next;
+}
+
+void orcm_pnp_base_release_windows(void)
+{
+    uint32_t chan;
+    uint64_t peer;
+    void *ptr, *node, *next;
+    int rc;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.window_lock);
+    rc = opal_hash_table_get_first_key_uint32(&orcm_pnp_base.channel_windows,
+                                              &chan, &ptr, &node);
+    while (OPAL_SUCCESS == rc) {
+        OBJ_RELEASE(ptr);
+        rc = opal_hash_table_get_next_key_uint32(&orcm_pnp_base.channel_windows,
+                                                 &chan, &ptr, node, &next);
+        node = next;
+    }
+    rc = opal_hash_table_get_first_key_uint64(&orcm_pnp_base.peer_windows,
+                                              &peer, &ptr, &node);
+    while (OPAL_SUCCESS == rc) {
+        OBJ_RELEASE(ptr);
+        rc = opal_hash_table_get_next_key_uint64(&orcm_pnp_base.peer_windows,
+                                                 &peer, &ptr, node, &next);
+        node = next;
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.window_lock);
+}
+
+int orcm_pnp_get_send_window(orcm_pnp_channel_t channel,
+                             orte_process_name_t *recipient,
+                             int32_t *msgs, int64_t *bytes)
+{
+    orcm_pnp_window_t *win;
+    void *ptr;
+    int rc;
+
+    *msgs = 0;
+    *bytes = 0;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.window_lock);
+    if (NULL == recipient ||
+        (ORTE_JOBID_WILDCARD == recipient->jobid &&
+         ORTE_VPID_WILDCARD == recipient->vpid)) {
+        if (ORCM_PNP_GROUP_OUTPUT_CHANNEL == channel && NULL != orcm_pnp_base.my_output_channel) {
+            channel = orcm_pnp_base.my_output_channel->channel;
+        } else if (ORCM_PNP_GROUP_INPUT_CHANNEL == channel && NULL != orcm_pnp_base.my_input_channel) {
+            channel = orcm_pnp_base.my_input_channel->channel;
+        }
+        rc = opal_hash_table_get_value_uint32(&orcm_pnp_base.channel_windows, channel, &ptr);
+    } else {
+        rc = opal_hash_table_get_value_uint64(&orcm_pnp_base.peer_windows, peer_key(recipient), &ptr);
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.window_lock);
+
+    /* nothing sent there yet */
+    if (OPAL_SUCCESS != rc) {
+        return ORCM_SUCCESS;
+    }
+    win = (orcm_pnp_window_t*)ptr;
+    OPAL_THREAD_LOCK(&win->lock);
+    *msgs = win->msgs;
+    *bytes = win->bytes;
+    OPAL_THREAD_UNLOCK(&win->lock);
+    return ORCM_SUCCESS;
+}
@@ -14,7 +14,7 @@
 
 #include "opal/dss/dss_types.h"
 #include "opal/class/opal_list.h"
-#include "opal/util/fd.h"
+#include "opal/mca/event/event.h"
 
 #include "orte/threads/threads.h"
 #include "orte/mca/rml/rml_types.h"
@@ -26,6 +26,7 @@
 BEGIN_C_DECLS
 
 #define ORCM_PNP_MAX_MSGS    8
+#define ORCM_PNP_QUEUE_SIZE  1024
 
 /*
  * globals that might be needed
@@ -33,9 +34,14 @@ BEGIN_C_DECLS
 typedef struct {
     opal_list_item_t super;
     char *string_id;
+    orcm_triplet_key_t key;
     orcm_pnp_tag_t tag;
     orcm_pnp_callback_fn_t cbfunc;
+    /* set instead of cbfunc for recvs that take msgs piece by piece */
+    orcm_pnp_stream_fn_t stream_cbfunc;
     void *cbdata;
+    /* where cbfunc runs - NULL => on the recv processing thread */
+    orcm_pnp_executor_t *executor;
 } orcm_pnp_request_t;
 ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_request_t);
 
@@ -52,27 +58,189 @@ typedef struct {
     orcm_pnp_callback_fn_t cbfunc;
     opal_buffer_t *buffer;
     void *cbdata;
+    /* the msg as handed to the transport - the header (the
+     * whole msg unless it is scatter-gathered) and the iovec
+     * array for scatter-gather sends
+     */
+    opal_buffer_t *hdr;
+    struct iovec *iovs;
+    bool multicast;
+    /* send window this msg is charged against */
+    int32_t bytes;
+    struct orcm_pnp_window_t *window;
+    /* completed along with the send, if it came from output_req */
+    orcm_pnp_send_req_t *req;
 } orcm_pnp_send_t;
 ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_send_t);
 
+/* what to do with a non-blocking send that would overflow its window */
+#define ORCM_PNP_WINDOW_BLOCK       0
+#define ORCM_PNP_WINDOW_DROP_OLDEST 1
+#define ORCM_PNP_WINDOW_EAGAIN      2
+
+typedef struct orcm_pnp_window_t {
+    opal_object_t super;
+    opal_mutex_t lock;
+    opal_condition_t cond;
+    /* in flight */
+    int32_t msgs;
+    int64_t bytes;
+    /* sends parked under the drop-oldest policy */
+    opal_list_t backlog;
+} orcm_pnp_window_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_window_t);
+
 typedef struct {
     opal_list_item_t super;
     orcm_pnp_channel_t channel;
     orte_process_name_t sender;
     opal_buffer_t buf;
+    /* when it was queued for processing - usecs */
+    uint64_t queued;
+    /* recvs matching the msg being delivered - kept with the
+     * msg so a recycled msg reuses the array
+     */
+    orcm_pnp_request_t **recvs;
+    int max_recvs;
 } orcm_pnp_msg_t;
 ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_msg_t);
 
+/* what follows the tag in a msg header */
+#define ORCM_PNP_MSG_IOVECS     0
+#define ORCM_PNP_MSG_BUFFER     1
+/* a frame of batched msgs, each with its own tag and flag */
+#define ORCM_PNP_MSG_BATCH      2
+/* one piece of a streamed msg */
+#define ORCM_PNP_MSG_FRAGMENT   3
+/* a buffer whose payload is compressed */
+#define ORCM_PNP_MSG_COMPRESSED 4
+
+/* a msg going out as a stream of fragments */
+typedef struct {
+    opal_object_t super;
+    opal_mutex_t lock;
+    uint32_t id;
+    bool multicast;
+    orcm_pnp_channel_t channel;
+    orte_process_name_t target;
+    orcm_pnp_tag_t tag;
+    /* the caller's msg, handed back in the callback */
+    struct iovec *msg;
+    int count;
+    opal_buffer_t *buffer;
+    orcm_pnp_callback_fn_t cbfunc;
+    void *cbdata;
+    /* the payload, and how far into it we have got - a
+     * buffer is treated as a single iovec
+     */
+    struct iovec whole;
+    struct iovec *iov;
+    int niov;
+    int cur;
+    size_t off;
+    int64_t total;
+    int64_t sent;
+    int inflight;
+    int status;
+    /* only one thread at a time hands fragments to the
+     * transport so they go out in order
+     */
+    bool pumping;
+    bool complete;
+} orcm_pnp_stream_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_stream_t);
+
+/* metrics for one tag of one channel - the counts are
+ * only ever updated atomically
+ */
+typedef struct {
+    opal_object_t super;
+    orcm_pnp_metrics_t data;
+} orcm_pnp_metric_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_metric_t);
+
+/* why a recvd msg was dropped */
+#define ORCM_PNP_DROP_NO_RECV     0
+#define ORCM_PNP_DROP_NOT_LEADER  1
+#define ORCM_PNP_DROP_OVERFLOW    2
+
+/* a peer's shared memory ring - seg is NULL if the
+ * peer is not on this node
+ */
+typedef struct {
+    opal_object_t super;
+    void *seg;
+    size_t len;
+    int fifo;
+} orcm_pnp_shm_peer_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_shm_peer_t);
+
+/* a streamed msg being reassembled for a regular recv */
+typedef struct {
+    opal_list_item_t super;
+    orte_process_name_t sender;
+    uint32_t id;
+    int64_t total;
+    opal_buffer_t *buf;
+    /* when its last fragment arrived - secs */
+    time_t last;
+} orcm_pnp_reassembly_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_reassembly_t);
+
+/* msgs waiting to go out on a channel as one frame */
+typedef struct {
+    opal_object_t super;
+    opal_mutex_t lock;
+    /* held from taking a frame until it is handed to the transport,
+     * so frames go out in the order they were filled
+     */
+    opal_mutex_t send_lock;
+    orcm_pnp_channel_t channel;
+    /* NULL until the first msg arrives */
+    opal_buffer_t *frame;
+    orcm_pnp_tag_t tag;
+    bool timer_active;
+    opal_event_t ev;
+} orcm_pnp_batch_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_batch_t);
+
+/* announcements either describe the sender alone or, when
+ * answering an original announcement in roster mode, carry a
+ * roster of all the peers the responder knows about
+ */
+typedef uint8_t orcm_pnp_announce_kind_t;
+#define ORCM_PNP_ANNOUNCE_KIND_T    OPAL_UINT8
+#define ORCM_PNP_ANNOUNCE_SINGLE    0
+#define ORCM_PNP_ANNOUNCE_ROSTER    1
+
+/* a reply to an announcement held back in case a roster
+ * answers it first
+ */
+typedef struct {
+    opal_list_item_t super;
+    orte_process_name_t announcer;
+    orcm_pnp_channel_t channel;
+    bool cancelled;
+    opal_event_t ev;
+} orcm_pnp_reply_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_reply_t);
+
 /* internal base functions */
 ORCM_DECLSPEC char* orcm_pnp_print_tag(orcm_pnp_tag_t tag);
 ORCM_DECLSPEC char* orcm_pnp_print_channel(orcm_pnp_channel_t chan);
 ORCM_DECLSPEC int orcm_pnp_base_start_threads(void);
 ORCM_DECLSPEC void orcm_pnp_base_stop_threads(void);
+/* drive recv processing from the app's own thread */
+ORCM_DECLSPEC int orcm_pnp_base_progress_fd(void);
+ORCM_DECLSPEC int orcm_pnp_base_progress(int max_msgs);
+ORCM_DECLSPEC orcm_pnp_queue_t* orcm_pnp_base_recv_queue(orcm_pnp_msg_t *msg);
 ORCM_DECLSPEC int orcm_pnp_base_record_recv(orcm_triplet_t *triplet,
                                             orcm_pnp_channel_t channel,
                                             orcm_pnp_tag_t tag,
                                             orcm_pnp_callback_fn_t cbfunc,
-                                            void *cbdata);
+                                            orcm_pnp_stream_fn_t stream_cbfunc,
+                                            void *cbdata,
+                                            orcm_pnp_executor_t *executor);
 ORCM_DECLSPEC void orcm_pnp_base_update_pending_recvs(orcm_triplet_t *trp);
 ORCM_DECLSPEC void orcm_pnp_base_check_pending_recvs(orcm_triplet_t *trp,
                                                      orcm_triplet_group_t *grp);
@@ -80,12 +248,137 @@ ORCM_DECLSPEC void orcm_pnp_base_check_trip_recvs(char *stringid,
                                                   opal_list_t *recvs,
                                                   orcm_pnp_channel_t channel);
 ORCM_DECLSPEC orcm_pnp_request_t* orcm_pnp_base_find_request(opal_list_t *list,
-                                                             char *string_id,
+                                                             const orcm_triplet_key_t *key,
                                                              orcm_pnp_tag_t tag);
+ORCM_DECLSPEC void orcm_pnp_base_set_request_id(orcm_pnp_request_t *req,
+                                                const char *string_id);
+
+/* channel recv index support - the index must be updated
+ * whenever the channel's list of recvs is changed
+ */
+typedef struct orcm_pnp_recv_index_t orcm_pnp_recv_index_t;
+ORCM_DECLSPEC int orcm_pnp_base_update_index(orcm_pnp_channel_obj_t *chan);
+/* collect every recv on the channel matching a msg, in the order they
+ * were registered. The matches are placed in the caller's array, which
+ * is grown as needed (size holds its capacity) and kept by the caller
+ * for reuse. Returns the number of matches
+ */
+ORCM_DECLSPEC int orcm_pnp_base_lookup_requests(orcm_pnp_channel_obj_t *chan,
+                                                const orcm_triplet_key_t *key,
+                                                orcm_triplet_handle_t handle,
+                                                orcm_pnp_tag_t tag,
+                                                orcm_pnp_request_t ***recvs,
+                                                int *size);
+ORCM_DECLSPEC void orcm_pnp_base_release_index(orcm_pnp_channel_obj_t *chan);
 ORCM_DECLSPEC int orcm_pnp_base_pack_announcement(opal_buffer_t *buf,
                                                   orte_process_name_t *sender);
 ORCM_DECLSPEC void orcm_pnp_base_process_announcements(orte_process_name_t *sender,
                                                        opal_buffer_t *buf);
+ORCM_DECLSPEC void orcm_pnp_base_cancel_replies(void);
+
+/* send window support - a send is charged before it is handed to the
+ * transport and must be released when the transport is done with it.
+ * Release hands back a parked send that now fits, which the caller
+ * must then transmit
+ */
+ORCM_DECLSPEC int orcm_pnp_base_window_charge(orcm_pnp_send_t *send);
+ORCM_DECLSPEC orcm_pnp_send_t* orcm_pnp_base_window_release(orcm_pnp_send_t *send);
+ORCM_DECLSPEC void orcm_pnp_base_release_windows(void);
+
+/* streaming support - the sender prepares a stream and then pulls
+ * fragments off it until it is drained, while the receiver feeds
+ * fragments destined for a regular recv into a reassembly that
+ * hands back the whole msg once its last fragment arrives. A
+ * reassembly that stalls is dropped after pnp_base_stream_timeout,
+ * and drop_streams discards those of a sender that has restarted
+ */
+ORCM_DECLSPEC void orcm_pnp_base_setup_stream(orcm_pnp_stream_t *stream,
+                                              struct iovec *msg, int count,
+                                              opal_buffer_t *buffer);
+ORCM_DECLSPEC int orcm_pnp_base_next_fragment(orcm_pnp_stream_t *stream,
+                                              opal_buffer_t **frag);
+ORCM_DECLSPEC int orcm_pnp_base_reassemble(orte_process_name_t *sender,
+                                           uint32_t id, int64_t offset,
+                                           int64_t total, uint8_t *data,
+                                           size_t len, opal_buffer_t **msg);
+ORCM_DECLSPEC void orcm_pnp_base_drop_streams(orte_process_name_t *sender);
+ORCM_DECLSPEC void orcm_pnp_base_release_streams(void);
+
+/* compression support - compress_payload packs the header and the
+ * compressed payload into hdr, or returns NOT_AVAILABLE without
+ * touching it if the payload does not shrink enough
+ */
+ORCM_DECLSPEC bool orcm_pnp_base_want_compress(orcm_pnp_channel_t channel,
+                                               orcm_pnp_tag_t tag, size_t len);
+ORCM_DECLSPEC int orcm_pnp_base_compress_payload(opal_buffer_t *hdr, orcm_pnp_tag_t tag,
+                                                 opal_buffer_t *buffer);
+ORCM_DECLSPEC int orcm_pnp_base_decompress_payload(opal_buffer_t *buf, opal_buffer_t **msg);
+
+/* shared memory transport - shm_send copies a direct msg straight
+ * into the recipient's ring, or returns NOT_AVAILABLE if it has to
+ * go over RML instead
+ */
+ORCM_DECLSPEC int orcm_pnp_base_shm_init(void);
+ORCM_DECLSPEC void orcm_pnp_base_shm_finalize(void);
+ORCM_DECLSPEC int orcm_pnp_base_shm_send(orte_process_name_t *recipient, opal_buffer_t *hdr,
+                                         struct iovec *msg, int count);
+
+/* object pools - get hands back a recycled object if there is one
+ * and a new one otherwise, and return recycles the object if there
+ * is room and nobody else holds it, releasing it otherwise. Buffers
+ * come back empty, with room for about hint bytes where possible.
+ * stash_storage takes the memory out of a buffer that is about to be
+ * handed other memory, keeping it in the pool if there is room
+ */
+ORCM_DECLSPEC void orcm_pnp_base_init_pools(void);
+ORCM_DECLSPEC orcm_pnp_send_t* orcm_pnp_base_get_send(void);
+ORCM_DECLSPEC void orcm_pnp_base_return_send(orcm_pnp_send_t *send);
+ORCM_DECLSPEC orcm_pnp_msg_t* orcm_pnp_base_get_msg(void);
+ORCM_DECLSPEC void orcm_pnp_base_return_msg(orcm_pnp_msg_t *msg);
+ORCM_DECLSPEC opal_buffer_t* orcm_pnp_base_get_buffer(size_t hint);
+ORCM_DECLSPEC void orcm_pnp_base_return_buffer(opal_buffer_t *buf);
+ORCM_DECLSPEC void orcm_pnp_base_stash_storage(opal_buffer_t *buf);
+ORCM_DECLSPEC void orcm_pnp_base_release_pools(void);
+
+/* recv executors - get returns an executor of the given kind for the
+ * caller to use, or NULL for inline recvs, and release lets go of it.
+ * Each serial recv gets one of its own, while pooled recvs share one.
+ * Submit copies the msg for the executor and queues it, applying the
+ * overflow policy when there is no room
+ */
+#define ORCM_PNP_EXEC_BLOCK   0
+#define ORCM_PNP_EXEC_DROP    1
+ORCM_DECLSPEC orcm_pnp_executor_t* orcm_pnp_base_get_executor(orcm_pnp_exec_t kind);
+ORCM_DECLSPEC void orcm_pnp_base_release_executor(orcm_pnp_executor_t *executor);
+ORCM_DECLSPEC void orcm_pnp_base_exec_release_lanes(orcm_pnp_executor_t *executor);
+ORCM_DECLSPEC void orcm_pnp_base_set_executor(orcm_pnp_request_t *req,
+                                              orcm_pnp_executor_t *executor);
+ORCM_DECLSPEC int orcm_pnp_base_exec_submit(orcm_pnp_request_t *req, orcm_pnp_msg_t *msg,
+                                            orcm_pnp_tag_t tag,
+                                            struct iovec *iovecs, int count,
+                                            opal_buffer_t *buf);
+ORCM_DECLSPEC void orcm_pnp_base_exec_depth(int32_t *depth, int32_t *max_depth);
+ORCM_DECLSPEC void orcm_pnp_base_stop_executors(void);
+
+/* tell the sender how a send went - through its callback and/or by
+ * completing its request, waking anyone waiting on it
+ */
+ORCM_DECLSPEC void orcm_pnp_base_report_send(orcm_pnp_send_t *send, int status);
+
+/* metrics support - the time is in usecs, and is always 0 when
+ * metrics are not being kept
+ */
+ORCM_DECLSPEC uint64_t orcm_pnp_base_metrics_now(void);
+ORCM_DECLSPEC void orcm_pnp_base_metrics_in(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                                            size_t bytes);
+ORCM_DECLSPEC void orcm_pnp_base_metrics_out(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                                             size_t bytes);
+ORCM_DECLSPEC void orcm_pnp_base_metrics_drop(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                                              int reason);
+ORCM_DECLSPEC void orcm_pnp_base_metrics_callback(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                                                  uint64_t queued, uint64_t start, uint64_t end);
+ORCM_DECLSPEC void orcm_pnp_base_answer_metrics(orte_process_name_t *requestor);
+ORCM_DECLSPEC void orcm_pnp_base_release_metrics(void);
 
 ORCM_DECLSPEC void orcm_pnp_base_recv_input_buffers(int status,
                                                     orte_rmcast_channel_t channel,
@@ -97,8 +390,53 @@ ORCM_DECLSPEC void orcm_pnp_base_recv_direct_msgs(int status, orte_process_name_
                                                   opal_buffer_t* buffer, orte_rml_tag_t tg,
                                                   void* cbdata);
 
+ORCM_DECLSPEC void orcm_pnp_base_transfer_payload(opal_buffer_t *dest, opal_buffer_t *src);
+
 ORCM_DECLSPEC int orcm_pnp_base_construct_msg(opal_buffer_t **buf, opal_buffer_t *buffer,
-                                              orcm_pnp_tag_t tag, struct iovec *msg, int count);
+                                              orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                                              struct iovec *msg, int count);
+ORCM_DECLSPEC struct iovec* orcm_pnp_base_gather_msg(opal_buffer_t *hdr,
+                                                     struct iovec *msg, int count);
+ORCM_DECLSPEC int orcm_pnp_base_append_raw(opal_buffer_t *buf,
+                                           const void *data, size_t len);
+
+/* msg framing - the header is the sender's triplet handle, the tag
+ * and the flag, and each msg in a batched frame starts with an entry
+ * holding its tag and flag. These and the sizes of iovecs and batched
+ * buffers are laid down raw in network byte order
+ */
+#define ORCM_PNP_HDR_SIZE   9
+ORCM_DECLSPEC int orcm_pnp_base_pack_header(opal_buffer_t *buf, orcm_pnp_tag_t tag,
+                                            int8_t flag);
+ORCM_DECLSPEC int orcm_pnp_base_unpack_header(opal_buffer_t *buf, orcm_triplet_handle_t *handle,
+                                              orcm_pnp_tag_t *tag, int8_t *flag);
+ORCM_DECLSPEC int orcm_pnp_base_pack_entry(opal_buffer_t *buf, orcm_pnp_tag_t tag,
+                                           int8_t flag);
+ORCM_DECLSPEC int orcm_pnp_base_unpack_entry(opal_buffer_t *buf, orcm_pnp_tag_t *tag,
+                                             int8_t *flag);
+ORCM_DECLSPEC int orcm_pnp_base_pack_raw32(opal_buffer_t *buf, uint32_t val);
+ORCM_DECLSPEC int orcm_pnp_base_unpack_raw32(opal_buffer_t *buf, uint32_t *val);
+ORCM_DECLSPEC int orcm_pnp_base_pack_sizes(opal_buffer_t *buf, struct iovec *msg, int count);
+ORCM_DECLSPEC int orcm_pnp_base_start_batch(opal_buffer_t **frame,
+                                            orcm_pnp_tag_t tag);
+ORCM_DECLSPEC int orcm_pnp_base_batch_msg(opal_buffer_t *frame,
+                                          orcm_pnp_tag_t tag,
+                                          struct iovec *msg, int count,
+                                          opal_buffer_t *buffer);
+ORCM_DECLSPEC void orcm_pnp_base_release_batches(void);
+ORCM_DECLSPEC int orcm_pnp_base_flatten_msg(opal_buffer_t *hdr,
+                                            struct iovec *msg, int count);
+
+/* recv queue support */
+ORCM_DECLSPEC int orcm_pnp_queue_init(orcm_pnp_queue_t *q, int32_t size);
+ORCM_DECLSPEC int orcm_pnp_queue_init_lane(orcm_pnp_queue_t *q, int32_t size,
+                                           orcm_pnp_queue_t *owner);
+ORCM_DECLSPEC int orcm_pnp_queue_push(orcm_pnp_queue_t *q, void *item, bool block);
+ORCM_DECLSPEC int orcm_pnp_queue_pop(orcm_pnp_queue_t *q, void **items, int max);
+ORCM_DECLSPEC int orcm_pnp_queue_wait(orcm_pnp_queue_t *q);
+ORCM_DECLSPEC bool orcm_pnp_queue_arm(orcm_pnp_queue_t *q);
+ORCM_DECLSPEC int orcm_pnp_queue_disarm(orcm_pnp_queue_t *q);
+ORCM_DECLSPEC int32_t orcm_pnp_queue_depth(orcm_pnp_queue_t *q);
 
 #define ORCM_PNP_MESSAGE_EVENT(sndr, chn, bf)                   \
     do {                                                        \
@@ -106,13 +444,18 @@ ORCM_DECLSPEC int orcm_pnp_base_construct_msg(opal_buffer_t **buf, opal_buffer_t
         OPAL_OUTPUT_VERBOSE((1, orte_debug_output,              \
                              "defining pnp msg event: %s %d",   \
                              __FILE__, __LINE__));              \
-        msg = OBJ_NEW(orcm_pnp_msg_t);                          \
+        msg = orcm_pnp_base_get_msg();                          \
         msg->channel = (chn);                                   \
         msg->sender.jobid = (sndr)->jobid;                      \
         msg->sender.vpid = (sndr)->vpid;                        \
-        opal_dss.copy_payload(&msg->buf, (bf));                 \
-        opal_fd_write(orcm_pnp_base.recv_pipe[1],               \
-                      sizeof(orcm_pnp_msg_t*), &msg);           \
+        msg->queued = orcm_pnp_base_metrics_now();              \
+        if (orcm_pnp_base.zero_copy) {                          \
+            orcm_pnp_base_transfer_payload(&msg->buf, (bf));    \
+        } else {                                                \
+            opal_dss.copy_payload(&msg->buf, (bf));             \
+        }                                                       \
+        orcm_pnp_queue_push(orcm_pnp_base_recv_queue(msg),      \
+                            msg, true);                         \
     } while(0);
 
 
@@ -13,6 +13,7 @@
 
 #include "opal/class/opal_list.h"
 #include "opal/class/opal_pointer_array.h"
+#include "opal/class/opal_hash_table.h"
 
 #include "orte/threads/threads.h"
 
@@ -20,20 +21,191 @@
 
 BEGIN_C_DECLS
 
+/* bounded lock-free MPSC ring used to hand recvd messages to the
+ * processing thread
+ */
+typedef struct {
+    volatile int32_t seq;
+    void *item;
+} orcm_pnp_queue_slot_t;
+
+typedef struct orcm_pnp_queue_t {
+    opal_object_t super;
+    orcm_pnp_queue_slot_t *slots;
+    int32_t size;
+    int32_t mask;
+    /* consumer position - only touched by the processing thread */
+    volatile int32_t head;
+    /* producer position - claimed via atomic cmpset */
+    volatile int32_t tail;
+    /* number of msgs currently waiting, and the high-water mark */
+    volatile int32_t depth;
+    volatile int32_t max_depth;
+    /* consumer is blocked (or about to block) on the wakeup fd */
+    volatile int32_t sleeping;
+    int wakeup[2];
+    bool use_eventfd;
+    /* a consumer fed by several rings sleeps on the wakeup of
+     * the first - the others point at it and are chained off it
+     */
+    struct orcm_pnp_queue_t *wake;
+    struct orcm_pnp_queue_t *lane;
+} orcm_pnp_queue_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_queue_t);
+
+/* recycled objects of one kind - a stack of up to pool_size
+ * objects, each reset as if it were new before it is reused
+ */
+typedef struct {
+    opal_mutex_t lock;
+    void **items;
+    int num;
+} orcm_pnp_pool_t;
+
+/* msg buffers are pooled by how much memory they hold, up to
+ * the largest class - anything bigger is freed
+ */
+#define ORCM_PNP_POOL_BUF_CLASSES   3
+
+/* a recv processing thread and the queues that feed it - control
+ * msgs get their own queue so they are not stuck behind bulk data
+ */
+typedef struct {
+    opal_object_t super;
+    int idx;
+    opal_thread_t thread;
+    orte_thread_ctl_t ctl;
+    orcm_pnp_queue_t *queue;
+    orcm_pnp_queue_t *control;
+} orcm_pnp_worker_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_worker_t);
+
+/* threads that run recv callbacks off the recv processing threads -
+ * a serial executor has one, the shared pool several. Jobs are
+ * sharded across the threads by sender. Each thread holds a
+ * reference to the executor until it exits, and each recv using it
+ * counts as a user - a serial executor is stopped when its last
+ * user lets go, the shared pool only at close
+ */
+struct orcm_pnp_exec_lane_t;
+typedef struct {
+    opal_object_t super;
+    int num_workers;
+    orcm_pnp_worker_t **workers;
+    /* jobs parked for each worker while its queue is full */
+    struct orcm_pnp_exec_lane_t *lanes;
+    volatile int32_t users;
+    bool shared;
+    bool stopped;
+    /* where it is tracked in the list of executors */
+    int idx;
+} orcm_pnp_executor_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_executor_t);
+
 typedef struct {
     int output;
     opal_list_t opened;
-    int recv_pipe[2];
-    opal_thread_t recv_process;
-    orte_thread_ctl_t recv_process_ctl;
+    int recv_queue_size;
+    int recv_batch_size;
+    /* pool of recv processing threads - msgs are sharded
+     * across them by sender so each sender's msgs are
+     * still processed in order
+     */
+    int num_workers;
+    orcm_pnp_worker_t **workers;
+    /* the app drains the recv queue itself through progress
+     * instead of a processing thread doing so
+     */
+    bool recv_progress;
+    /* deliver control msgs ahead of data - 0 weight => strictly,
+     * otherwise one pass over data is made after that many
+     * consecutive passes over control msgs
+     */
+    bool recv_priority;
+    int recv_priority_weight;
+    /* take over recvd buffers instead of copying them */
+    bool zero_copy;
     uint32_t my_uid;
     char *my_string_id;
+    orcm_triplet_handle_t my_handle;
     orcm_triplet_t *my_triplet;
     orcm_triplet_group_t *my_group;
     orcm_pnp_announce_fn_t my_announce_cbfunc;
     orcm_pnp_channel_obj_t *my_input_channel;
     orcm_pnp_channel_obj_t *my_output_channel;
     opal_pointer_array_t channels;
+    /* serializes rebuilds of the channel recv indexes */
+    opal_mutex_t index_lock;
+    /* answer original announcements with one roster from a
+     * designated responder instead of a reply from every peer
+     */
+    bool roster;
+    /* max msecs anyone else waits for a roster naming them
+     * before replying itself - 0 => never reply
+     */
+    int reply_delay;
+    unsigned int reply_seed;
+    opal_mutex_t reply_lock;
+    opal_list_t replies;
+    /* limits on the non-blocking sends in flight to each
+     * multicast channel and each p2p peer - 0 => no limit
+     */
+    bool send_window;
+    int window_msgs;
+    int window_bytes;
+    int window_policy;
+    int window_backlog;
+    opal_mutex_t window_lock;
+    opal_hash_table_t channel_windows;
+    opal_hash_table_t peer_windows;
+    /* coalescing of small multicast msgs */
+    int batch_size;
+    int batch_timeout;
+    opal_mutex_t batch_lock;
+    opal_hash_table_t batches;
+    /* streaming of large msgs */
+    int fragment_size;
+    int stream_depth;
+    int64_t stream_max_size;
+    int stream_timeout;
+    volatile int32_t next_stream;
+    opal_mutex_t stream_lock;
+    opal_list_t reassembly;
+    /* payload compression */
+    int compress_threshold;
+    int num_compress_channels;
+    orcm_pnp_channel_t *compress_channels;
+    opal_mutex_t compress_lock;
+    orcm_pnp_compress_stats_t compress_stats;
+    /* traffic metrics per channel and tag */
+    bool metrics;
+    opal_mutex_t metrics_lock;
+    opal_hash_table_t metrics_table;
+    /* direct msgs to procs on the same node go through shared memory */
+    bool shm;
+    int shm_size;
+    opal_mutex_t shm_lock;
+    opal_hash_table_t shm_peers;
+    /* executors running recv callbacks - every one is kept
+     * here so its threads can be stopped at close
+     */
+    int exec_queue_size;
+    int exec_policy;
+    int exec_pool_threads;
+    opal_mutex_t exec_lock;
+    opal_pointer_array_t executors;
+    orcm_pnp_executor_t *exec_pool;
+    /* shared by everyone waiting on send requests - completions
+     * only take the lock when someone is waiting
+     */
+    opal_mutex_t req_lock;
+    opal_condition_t req_cond;
+    volatile int32_t req_waiters;
+    /* recycled send and recv objects and msg buffers */
+    int pool_size;
+    orcm_pnp_pool_t send_pool;
+    orcm_pnp_pool_t msg_pool;
+    orcm_pnp_pool_t buffer_pools[ORCM_PNP_POOL_BUF_CLASSES];
     bool comm_enabled;
 } orcm_pnp_base_t;
 ORCM_DECLSPEC extern orcm_pnp_base_t orcm_pnp_base;
@@ -26,9 +26,11 @@
 
 #include "opal/dss/dss.h"
 #include "opal/class/opal_list.h"
+#include "opal/class/opal_hash_table.h"
 #include "opal/class/opal_pointer_array.h"
 #include "opal/util/argv.h"
 #include "opal/util/output.h"
+#include "opal/sys/atomic.h"
 #include "opal/threads/threads.h"
 #include "opal/mca/sysinfo/sysinfo.h"
 
@@ -66,6 +68,21 @@ static int register_receive(const char *app,
                             orcm_pnp_tag_t tag,
                             orcm_pnp_callback_fn_t cbfunc,
                             void *cbdata);
+static int register_stream(const char *app,
+                           const char *version,
+                           const char *release,
+                           orcm_pnp_channel_t channel,
+                           orcm_pnp_tag_t tag,
+                           orcm_pnp_stream_fn_t cbfunc,
+                           void *cbdata);
+static int register_receive_exec(const char *app,
+                                 const char *version,
+                                 const char *release,
+                                 orcm_pnp_channel_t channel,
+                                 orcm_pnp_tag_t tag,
+                                 orcm_pnp_exec_t exec,
+                                 orcm_pnp_callback_fn_t cbfunc,
+                                 void *cbdata);
 static int cancel_receive(const char *app,
                           const char *version,
                           const char *release,
@@ -83,9 +100,32 @@ static int default_output_nb(orcm_pnp_channel_t channel,
                              opal_buffer_t *buffer,
                              orcm_pnp_callback_fn_t cbfunc,
                              void *cbdata);
+static int default_output_req(orcm_pnp_channel_t channel,
+                              orte_process_name_t *recipient,
+                              orcm_pnp_tag_t tag,
+                              struct iovec *msg, int count,
+                              opal_buffer_t *buffer,
+                              orcm_pnp_send_req_t **req);
+static int default_output_batch(orcm_pnp_channel_t channel,
+                                orte_process_name_t *recipient,
+                                orcm_pnp_tag_t tag,
+                                struct iovec *msg, int count,
+                                opal_buffer_t *buffer,
+                                orcm_pnp_callback_fn_t cbfunc,
+                                void *cbdata);
+static int default_flush(orcm_pnp_channel_t channel);
+static int default_output_stream(orcm_pnp_channel_t channel,
+                                 orte_process_name_t *recipient,
+                                 orcm_pnp_tag_t tag,
+                                 struct iovec *msg, int count,
+                                 opal_buffer_t *buffer,
+                                 orcm_pnp_callback_fn_t cbfunc,
+                                 void *cbdata);
 static orcm_pnp_tag_t define_new_tag(void);
 static char* get_string_id(void);
 static int disable_comm(void);
+static int get_fd(void);
+static int progress(int max_msgs);
 static int default_finalize(void);
 
 /* The module struct */
@@ -95,12 +135,20 @@ orcm_pnp_base_module_t orcm_pnp_default_module = {
     announce,
     open_channel,
     register_receive,
+    register_stream,
+    register_receive_exec,
     cancel_receive,
     default_output,
     default_output_nb,
+    default_output_req,
+    default_output_batch,
+    default_flush,
+    default_output_stream,
     define_new_tag,
     get_string_id,
     disable_comm,
+    get_fd,
+    progress,
     default_finalize
 };
 
@@ -118,11 +166,45 @@ static void rml_callback(int status,
                          orte_rml_tag_t tag,
                          void* cbdata);
 
+static void rml_iovec_callback(int status,
+                               struct orte_process_name_t* peer,
+                               struct iovec* msg,
+                               int count,
+                               orte_rml_tag_t tag,
+                               void* cbdata);
+
+static int send_nb(orcm_pnp_channel_t channel,
+                   orte_process_name_t *recipient,
+                   orcm_pnp_tag_t tag,
+                   struct iovec *msg, int count,
+                   opal_buffer_t *buffer,
+                   orcm_pnp_callback_fn_t cbfunc,
+                   void *cbdata,
+                   orcm_pnp_send_req_t *req);
+static int transmit(orcm_pnp_send_t *send);
+static void start_parked(orcm_pnp_send_t *send);
+static int start_send(orcm_pnp_send_t *send);
+static void send_complete(int status, orcm_pnp_send_t *send);
+static void batch_timeout_cb(int fd, short flags, void *cbdata);
+static void flush_all_batches(void);
+static int add_receive(const char *app,
+                       const char *version,
+                       const char *release,
+                       orcm_pnp_channel_t channel,
+                       orcm_pnp_tag_t tag,
+                       orcm_pnp_callback_fn_t cbfunc,
+                       orcm_pnp_stream_fn_t stream_cbfunc,
+                       orcm_pnp_exec_t exec,
+                       void *cbdata);
+static void pump_stream(orcm_pnp_stream_t *stream);
+
 
 /* Local variables */
 static bool recv_on = false;
 
-/* local thread support */
+/* serializes changes to the announcement and recv registrations -
+ * the send path never takes it
+ */
 static orte_thread_ctl_t local_thread;
 
 static int default_init(void)
@@ -235,6 +317,11 @@ static int default_init(void)
         }
     }
 
+    /* let procs on this node reach us through shared memory - if
+     * that cannot be setup, they just use RML
+     */
+    orcm_pnp_base_shm_init();
+
     orcm_pnp_base.comm_enabled = true;
     return ORCM_SUCCESS;
 }
@@ -247,6 +334,7 @@ static int announce(const char *app,
     int ret;
     opal_buffer_t buf;
     orcm_pnp_channel_t chan;
+    char *string_id;
 
     /* bozo check */
     if (NULL == app || NULL == version || NULL == release) {
@@ -276,9 +364,11 @@ static int announce(const char *app,
                          app, version, release));
     
     /* retain a local record of my info - this enables communication
-     * by setting my_string_id != NULL
+     * by setting my_string_id != NULL once my triplet and group are
+     * in place
      */
-    ORCM_CREATE_STRING_ID(&orcm_pnp_base.my_string_id, app, version, release);
+    ORCM_CREATE_STRING_ID(&string_id, app, version, release);
+    orcm_pnp_base.my_handle = orcm_triplet_hash(string_id);
     
     /* retain the callback function */
     orcm_pnp_base.my_announce_cbfunc = cbfunc;
@@ -293,6 +383,15 @@ static int announce(const char *app,
     orcm_pnp_base.my_group->input = orcm_pnp_base.my_input_channel->channel;
     orcm_pnp_base.my_group->output = orcm_pnp_base.my_output_channel->channel;
 
+    /* senders and receivers check my_string_id without the lock, so
+     * everything setup above must be visible before it is. It has to
+     * be set before the pending recvs are checked so recvs on my own
+     * input channel are opened up to everyone, and before the
+     * announcement goes out so no reply to it is dropped
+     */
+    opal_atomic_wmb();
+    orcm_pnp_base.my_string_id = string_id;
+
     /* check for pending recvs for these channels - this will copy
      * recvs that were pre-posted on the triplet to the channel
      * array
@@ -492,10 +591,8 @@ static int open_channel(const char *app,
     }
     /* if we didn't find the group, then we have to add it */
     if (!done) {
-        grp = OBJ_NEW(orcm_triplet_group_t);
-        grp->jobid = jobid;
+        grp = orcm_get_triplet_group(triplet, jobid, true);
         grp->pnp_cbfunc = cbfunc;
-        opal_pointer_array_add(&triplet->groups, grp);
     }
 
     ORTE_RELEASE_THREAD(&triplet->ctl);
@@ -510,12 +607,52 @@ static int register_receive(const char *app,
                             orcm_pnp_tag_t tag,
                             orcm_pnp_callback_fn_t cbfunc,
                             void *cbdata)
+{
+    return add_receive(app, version, release, channel, tag, cbfunc, NULL,
+                       ORCM_PNP_EXEC_INLINE, cbdata);
+}
+
+static int register_stream(const char *app,
+                           const char *version,
+                           const char *release,
+                           orcm_pnp_channel_t channel,
+                           orcm_pnp_tag_t tag,
+                           orcm_pnp_stream_fn_t cbfunc,
+                           void *cbdata)
+{
+    return add_receive(app, version, release, channel, tag, NULL, cbfunc,
+                       ORCM_PNP_EXEC_INLINE, cbdata);
+}
+
+static int register_receive_exec(const char *app,
+                                 const char *version,
+                                 const char *release,
+                                 orcm_pnp_channel_t channel,
+                                 orcm_pnp_tag_t tag,
+                                 orcm_pnp_exec_t exec,
+                                 orcm_pnp_callback_fn_t cbfunc,
+                                 void *cbdata)
+{
+    return add_receive(app, version, release, channel, tag, cbfunc, NULL, exec, cbdata);
+}
+
+static int add_receive(const char *app,
+                       const char *version,
+                       const char *release,
+                       orcm_pnp_channel_t channel,
+                       orcm_pnp_tag_t tag,
+                       orcm_pnp_callback_fn_t cbfunc,
+                       orcm_pnp_stream_fn_t stream_cbfunc,
+                       orcm_pnp_exec_t exec,
+                       void *cbdata)
 {
     orcm_triplet_t *triplet, *trp;
     int i;
     int ret=ORCM_SUCCESS;
     orcm_pnp_channel_obj_t *recvr;
     orcm_pnp_request_t *req;
+    orcm_pnp_executor_t *executor;
+    opal_pointer_array_t matches;
 
     OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
                          "%s pnp:default:register_recv app %s version %s release %s channel %s tag %s",
@@ -532,6 +669,12 @@ static int register_receive(const char *app,
         return ORTE_ERR_BAD_PARAM;
     }
 
+    /* find where the callback is to run - stream callbacks are
+     * only ever handed a fragment while it is being processed,
+     * so they always run inline
+     */
+    executor = (NULL == stream_cbfunc) ? orcm_pnp_base_get_executor(exec) : NULL;
+
     /* since we are modifying global lists, lock
      * the thread
      */
@@ -557,23 +700,27 @@ static int register_receive(const char *app,
              * ensuring no duplicates
              */
             if (ORCM_PNP_GROUP_INPUT_CHANNEL == channel) {
-                if (NULL == orcm_pnp_base_find_request(&triplet->input_recvs, triplet->string_id, tag)) {
+                if (NULL == orcm_pnp_base_find_request(&triplet->input_recvs, &triplet->key, tag)) {
                     /* create it */
                     req = OBJ_NEW(orcm_pnp_request_t);
-                    req->string_id = strdup(triplet->string_id);
+                    orcm_pnp_base_set_request_id(req, triplet->string_id);
                     req->tag = tag;
                     req->cbfunc = cbfunc;
+                    req->stream_cbfunc = stream_cbfunc;
                     req->cbdata = cbdata;
+                    orcm_pnp_base_set_executor(req, executor);
                     opal_list_append(&triplet->input_recvs, &req->super);
                 }
             } else {
-                if (NULL == orcm_pnp_base_find_request(&triplet->output_recvs, triplet->string_id, tag)) {
+                if (NULL == orcm_pnp_base_find_request(&triplet->output_recvs, &triplet->key, tag)) {
                     /* create it */
                     req = OBJ_NEW(orcm_pnp_request_t);
-                    req->string_id = strdup(triplet->string_id);
+                    orcm_pnp_base_set_request_id(req, triplet->string_id);
                     req->tag = tag;
                     req->cbfunc = cbfunc;
+                    req->stream_cbfunc = stream_cbfunc;
                     req->cbdata = cbdata;
+                    orcm_pnp_base_set_executor(req, executor);
                     opal_list_append(&triplet->output_recvs, &req->super);
                 }
             }
@@ -581,26 +728,24 @@ static int register_receive(const char *app,
             /* lock the global triplet arrays for our use */
             ORTE_ACQUIRE_THREAD(&orcm_triplets->ctl);
 
-            /* check all known triplets to find those that match */
-            for (i=0; i < orcm_triplets->array.size; i++) {
-                if (NULL == (trp = (orcm_triplet_t*)opal_pointer_array_get_item(&orcm_triplets->array, i))) {
-                    continue;
-                }
-                if (trp == triplet) {
-                    /* don't copy from ourselves */
+            /* find the known triplets this one spans */
+            OBJ_CONSTRUCT(&matches, opal_pointer_array_t);
+            opal_pointer_array_init(&matches, 8, INT_MAX, 8);
+            orcm_triplet_get_matches(&triplet->key, false, &matches);
+            for (i=0; i < matches.size; i++) {
+                if (NULL == (trp = (orcm_triplet_t*)opal_pointer_array_get_item(&matches, i))) {
                     continue;
                 }
                 /* lock the triplet thread */
                 ORTE_ACQUIRE_THREAD(&trp->ctl);
-                if (orcm_triplet_cmp(trp->string_id, triplet->string_id)) {
-                    /* triplet matches - transfer the recv */
-                    if (ORCM_SUCCESS != (ret = orcm_pnp_base_record_recv(trp, channel, tag, cbfunc, cbdata))) {
-                        ORTE_ERROR_LOG(ret);
-                    }
+                /* transfer the recv */
+                if (ORCM_SUCCESS != (ret = orcm_pnp_base_record_recv(trp, channel, tag, cbfunc, stream_cbfunc, cbdata, executor))) {
+                    ORTE_ERROR_LOG(ret);
                 }
                 /* release this triplet */
                 ORTE_RELEASE_THREAD(&trp->ctl);
             }
+            OBJ_DESTRUCT(&matches);
 
             /* release the global arrays */
             ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
@@ -613,14 +758,17 @@ static int register_receive(const char *app,
                 recvr->channel = channel;
                 opal_pointer_array_set_item(&orcm_pnp_base.channels, recvr->channel, recvr);
             }
-            if (NULL == (req = orcm_pnp_base_find_request(&recvr->recvs, triplet->string_id, tag))) {
+            if (NULL == (req = orcm_pnp_base_find_request(&recvr->recvs, &triplet->key, tag))) {
                 /* not already present - create it */
                 req = OBJ_NEW(orcm_pnp_request_t);
-                req->string_id = strdup(req->string_id);
-                req->tag = req->tag;
+                orcm_pnp_base_set_request_id(req, triplet->string_id);
+                req->tag = tag;
                 req->cbfunc = cbfunc;
+                req->stream_cbfunc = stream_cbfunc;
                 req->cbdata = cbdata;
+                orcm_pnp_base_set_executor(req, executor);
                 opal_list_append(&recvr->recvs, &req->super);
+                orcm_pnp_base_update_index(recvr);
             }
             if (channel < ORCM_PNP_SYS_CHANNEL) {
                 /* can't register rmcast recvs on group_input, group_output, and wildcard channels */
@@ -649,7 +797,7 @@ static int register_receive(const char *app,
 
     } else {
         /* we are dealing with a non-wildcard triplet - record the request */
-        if (ORCM_SUCCESS != (ret = orcm_pnp_base_record_recv(triplet, channel, tag, cbfunc, cbdata))) {
+        if (ORCM_SUCCESS != (ret = orcm_pnp_base_record_recv(triplet, channel, tag, cbfunc, stream_cbfunc, cbdata, executor))) {
             ORTE_ERROR_LOG(ret);
         }
     }
@@ -658,7 +806,11 @@ static int register_receive(const char *app,
     /* clear the threads */
     ORTE_RELEASE_THREAD(&triplet->ctl);
     ORTE_RELEASE_THREAD(&local_thread);
-    
+    /* the recvs hold their own references */
+    if (NULL != executor) {
+        orcm_pnp_base_release_executor(executor);
+    }
+
     return ret;
 }
 
@@ -712,6 +864,7 @@ static int cancel_receive(const char *app,
                 }
                 item = next;
             }
+            orcm_pnp_base_update_index(chan);
         }
         goto cleanup;
     }
@@ -753,6 +906,7 @@ static int cancel_receive(const char *app,
                         }
                         item = next;
                     }
+                    orcm_pnp_base_update_index(chan);
                 }
             }
             /* release the triplet */
@@ -798,6 +952,7 @@ static int cancel_receive(const char *app,
                         }
                         item = next;
                     }
+                    orcm_pnp_base_update_index(chan);
                 }
             }
             /* release the triplet */
@@ -821,6 +976,7 @@ static int cancel_receive(const char *app,
             }
             item = next;
         }
+        orcm_pnp_base_update_index(chan);
         free(string_id);
     }
 
@@ -838,8 +994,10 @@ static int default_output(orcm_pnp_channel_t channel,
                           opal_buffer_t *buffer)
 {
     int i, ret;
+    size_t bytes;
     opal_buffer_t *buf;
     orcm_pnp_channel_t chan;
+    struct iovec *iovs;
     
     /* if we have not announced, ignore this message */
     if (NULL == orcm_pnp_base.my_string_id) {
@@ -850,13 +1008,9 @@ static int default_output(orcm_pnp_channel_t channel,
         return ORCM_ERR_COMM_DISABLED;
     }
 
-    /* protect against threading */
-    ORTE_ACQUIRE_THREAD(&local_thread);
-
     /* setup the message for xmission */
-    if (ORTE_SUCCESS != (ret = orcm_pnp_base_construct_msg(&buf, buffer, tag, msg, count))) {
+    if (ORTE_SUCCESS != (ret = orcm_pnp_base_construct_msg(&buf, buffer, channel, tag, msg, count))) {
         ORTE_ERROR_LOG(ret);
-        ORTE_RELEASE_THREAD(&local_thread);
         return ret;
     }
     
@@ -882,12 +1036,17 @@ static int default_output(orcm_pnp_channel_t channel,
                              orcm_pnp_print_channel(chan),
                              orcm_pnp_print_tag(tag)));
         
+        /* the multicast transport needs a single buffer */
+        if (NULL != msg && ORCM_SUCCESS != (ret = orcm_pnp_base_flatten_msg(buf, msg, count))) {
+            orcm_pnp_base_return_buffer(buf);
+            return ret;
+        }
         /* send the data to the channel */
+        orcm_pnp_base_metrics_out(chan, tag, buf->bytes_used);
         if (ORCM_SUCCESS != (ret = orte_rmcast.send_buffer(chan, tag, buf))) {
             ORTE_ERROR_LOG(ret);
         }
-        OBJ_RELEASE(buf);
-        ORTE_RELEASE_THREAD(&local_thread);
+        orcm_pnp_base_return_buffer(buf);
         return ret;
     }
     
@@ -897,8 +1056,7 @@ static int default_output(orcm_pnp_channel_t channel,
     if (ORTE_JOBID_WILDCARD == recipient->jobid ||
         ORTE_VPID_WILDCARD == recipient->vpid) {
         ORTE_ERROR_LOG(ORTE_ERR_NOT_IMPLEMENTED);
-        OBJ_RELEASE(buf);
-        ORTE_RELEASE_THREAD(&local_thread);
+        orcm_pnp_base_return_buffer(buf);
         return ORTE_ERR_NOT_IMPLEMENTED;
     }
     
@@ -911,16 +1069,42 @@ static int default_output(orcm_pnp_channel_t channel,
                          ORTE_NAME_PRINT(recipient),
                          orcm_pnp_print_tag(tag)));
 
-    /* release the thread prior to send */
-    ORTE_RELEASE_THREAD(&local_thread);
-    
+    bytes = buf->bytes_used;
+    for (i=0; NULL != msg && i < count; i++) {
+        bytes += msg[i].iov_len;
+    }
+    orcm_pnp_base_metrics_out(ORCM_PNP_DIRECT_CHANNEL, tag, bytes);
+
+    /* a peer on this node gets it straight away */
+    if (ORCM_SUCCESS == orcm_pnp_base_shm_send(recipient, buf, msg, (NULL == msg) ? 0 : count)) {
+        orcm_pnp_base_return_buffer(buf);
+        return ORCM_SUCCESS;
+    }
+
+    if (NULL != msg) {
+        /* hand the header and the caller's iovecs straight to the transport */
+        if (NULL == (iovs = orcm_pnp_base_gather_msg(buf, msg, count))) {
+            ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+            orcm_pnp_base_return_buffer(buf);
+            return ORCM_ERR_OUT_OF_RESOURCE;
+        }
+        if (0 > (ret = orte_rml.send(recipient, iovs, count+1, ORTE_RML_TAG_MULTICAST_DIRECT, 0))) {
+            ORTE_ERROR_LOG(ret);
+        } else {
+            ret = ORCM_SUCCESS;
+        }
+        free(iovs);
+        orcm_pnp_base_return_buffer(buf);
+        return ret;
+    }
+
     /* send the msg */
     if (0 > (ret = orte_rml.send_buffer(recipient, buf, ORTE_RML_TAG_MULTICAST_DIRECT, 0))) {
         ORTE_ERROR_LOG(ret);
     } else {
         ret = ORCM_SUCCESS;
     }
-    OBJ_RELEASE(buf);
+    orcm_pnp_base_return_buffer(buf);
     return ret;
 }
 
@@ -931,6 +1115,37 @@ static int default_output_nb(orcm_pnp_channel_t channel,
                              opal_buffer_t *buffer,
                              orcm_pnp_callback_fn_t cbfunc,
                              void *cbdata)
+{
+    return send_nb(channel, recipient, tag, msg, count, buffer, cbfunc, cbdata, NULL);
+}
+
+static int default_output_req(orcm_pnp_channel_t channel,
+                              orte_process_name_t *recipient,
+                              orcm_pnp_tag_t tag,
+                              struct iovec *msg, int count,
+                              opal_buffer_t *buffer,
+                              orcm_pnp_send_req_t **req)
+{
+    int ret;
+
+    *req = OBJ_NEW(orcm_pnp_send_req_t);
+    if (ORCM_SUCCESS != (ret = send_nb(channel, recipient, tag, msg, count,
+                                       buffer, NULL, NULL, *req))) {
+        /* nothing will ever complete it */
+        OBJ_RELEASE(*req);
+        *req = NULL;
+    }
+    return ret;
+}
+
+static int send_nb(orcm_pnp_channel_t channel,
+                   orte_process_name_t *recipient,
+                   orcm_pnp_tag_t tag,
+                   struct iovec *msg, int count,
+                   opal_buffer_t *buffer,
+                   orcm_pnp_callback_fn_t cbfunc,
+                   void *cbdata,
+                   orcm_pnp_send_req_t *req)
 {
     int i, ret;
     orcm_pnp_send_t *send;
@@ -946,23 +1161,27 @@ static int default_output_nb(orcm_pnp_channel_t channel,
         return ORCM_ERR_COMM_DISABLED;
     }
 
-    /* protect against threading */
-    ORTE_ACQUIRE_THREAD(&local_thread);
-    
-    send = OBJ_NEW(orcm_pnp_send_t);
+    send = orcm_pnp_base_get_send();
     send->tag = tag;
     send->msg = msg;
     send->count = count;
     send->buffer = buffer;
     send->cbfunc = cbfunc;
     send->cbdata = cbdata;
+    if (NULL != req) {
+        OBJ_RETAIN(req);
+        send->req = req;
+    }
 
-    /* setup the message for xmission */
-    if (ORTE_SUCCESS != (ret = orcm_pnp_base_construct_msg(&buf, buffer, tag, msg, count))) {
+    /* setup the message for xmission - the send
+     * holds onto it until the transport is done
+     */
+    if (ORTE_SUCCESS != (ret = orcm_pnp_base_construct_msg(&buf, buffer, channel, tag, msg, count))) {
         ORTE_ERROR_LOG(ret);
-        ORTE_RELEASE_THREAD(&local_thread);
+        orcm_pnp_base_return_send(send);
         return ret;
     }
+    send->hdr = buf;
     
     /* if this is intended for everyone who might be listening to my output,
      * multicast it
@@ -986,14 +1205,15 @@ static int default_output_nb(orcm_pnp_channel_t channel,
                              orcm_pnp_print_channel(channel),
                              orcm_pnp_print_tag(tag)));
         
-        /* release thread prior to send */
-        ORTE_RELEASE_THREAD(&local_thread);
-        /* send the data to the channel */
-        if (ORCM_SUCCESS != (ret = orte_rmcast.send_buffer_nb(chan, tag, buf,
-                                                              rmcast_callback, send))) {
-            ORTE_ERROR_LOG(ret);
+        /* the multicast transport needs a single buffer */
+        if (NULL != msg && ORCM_SUCCESS != (ret = orcm_pnp_base_flatten_msg(buf, msg, count))) {
+            orcm_pnp_base_return_send(send);
+            return ret;
         }
-        return ret;
+        send->multicast = true;
+        send->channel = chan;
+        send->bytes = buf->bytes_used;
+        return start_send(send);
     }
     
     /* if only one name field is WILDCARD, I don't know how to send
@@ -1002,8 +1222,7 @@ static int default_output_nb(orcm_pnp_channel_t channel,
     if (ORTE_JOBID_WILDCARD == recipient->jobid ||
         ORTE_VPID_WILDCARD == recipient->vpid) {
         ORTE_ERROR_LOG(ORTE_ERR_NOT_IMPLEMENTED);
-        OBJ_RELEASE(send);
-        ORTE_RELEASE_THREAD(&local_thread);
+        orcm_pnp_base_return_send(send);
         return ORTE_ERR_NOT_IMPLEMENTED;
     }
     
@@ -1016,20 +1235,571 @@ static int default_output_nb(orcm_pnp_channel_t channel,
                          ORTE_NAME_PRINT(recipient),
                          orcm_pnp_print_tag(tag)));
 
-    /* release thread prior to send */
-    ORTE_RELEASE_THREAD(&local_thread);
-    
-    /* send the msg */
-    if (0 > (ret = orte_rml.send_buffer_nb(recipient, buf,
-                                           ORTE_RML_TAG_MULTICAST_DIRECT, 0,
-                                           rml_callback, send))) {
+    send->target = *recipient;
+    send->bytes = buf->bytes_used;
+    if (NULL != msg) {
+        /* hand the header and the caller's iovecs straight to the
+         * transport - the send object holds onto both until the
+         * transport is done with them
+         */
+        if (NULL == (send->iovs = orcm_pnp_base_gather_msg(buf, msg, count))) {
+            ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+            orcm_pnp_base_return_send(send);
+            return ORCM_ERR_OUT_OF_RESOURCE;
+        }
+        for (i=0; i < count; i++) {
+            send->bytes += msg[i].iov_len;
+        }
+    }
+    return start_send(send);
+}
+
+/* hand a prepared send to the transport */
+static int transmit(orcm_pnp_send_t *send)
+{
+    int ret;
+
+    if (send->multicast) {
+        /* send the data to the channel */
+        orcm_pnp_base_metrics_out(send->channel, send->tag, send->bytes);
+        return orte_rmcast.send_buffer_nb(send->channel, send->tag, send->hdr,
+                                          rmcast_callback, send);
+    }
+    orcm_pnp_base_metrics_out(ORCM_PNP_DIRECT_CHANNEL, send->tag, send->bytes);
+
+    /* a peer on this node gets it straight away - the msg has been
+     * copied, so it is complete before output_nb returns and the
+     * callback runs right here on the caller's thread
+     */
+    if (ORCM_SUCCESS == orcm_pnp_base_shm_send(&send->target, send->hdr,
+                                               (NULL == send->iovs) ? NULL : send->msg,
+                                               (NULL == send->iovs) ? 0 : send->count)) {
+        send_complete(ORCM_SUCCESS, send);
+        return ORCM_SUCCESS;
+    }
+    if (NULL != send->iovs) {
+        ret = orte_rml.send_nb(&send->target, send->iovs, send->count+1,
+                               ORTE_RML_TAG_MULTICAST_DIRECT, 0,
+                               rml_iovec_callback, send);
+    } else {
+        ret = orte_rml.send_buffer_nb(&send->target, send->hdr,
+                                      ORTE_RML_TAG_MULTICAST_DIRECT, 0,
+                                      rml_callback, send);
+    }
+    return (0 > ret) ? ret : ORCM_SUCCESS;
+}
+
+/* transmit sends that were parked in a send window until it had room */
+static void start_parked(orcm_pnp_send_t *send)
+{
+    orcm_pnp_send_t *next;
+    int ret;
+
+    while (NULL != send) {
+        if (ORCM_SUCCESS == (ret = transmit(send))) {
+            return;
+        }
+        /* the caller is long gone, so report it through the callback */
+        ORTE_ERROR_LOG(ret);
+        orcm_pnp_base_report_send(send, ret);
+        next = orcm_pnp_base_window_release(send);
+        orcm_pnp_base_return_send(send);
+        send = next;
+    }
+}
+
+static int start_send(orcm_pnp_send_t *send)
+{
+    orcm_pnp_send_t *next;
+    int ret;
+
+    /* make sure there is room in the send window */
+    ret = orcm_pnp_base_window_charge(send);
+    if (ORCM_ERR_RESOURCE_BUSY == ret) {
+        /* parked - it goes when there is room */
+        return ORCM_SUCCESS;
+    }
+    if (ORCM_ERR_WOULD_BLOCK == ret) {
+        if (NULL == send->cbfunc && NULL == send->req) {
+            orcm_pnp_base_return_send(send);
+            return ret;
+        }
+        orcm_pnp_base_report_send(send, ret);
+        orcm_pnp_base_return_send(send);
+        return ORCM_SUCCESS;
+    }
+
+    if (ORCM_SUCCESS != (ret = transmit(send))) {
         ORTE_ERROR_LOG(ret);
+        next = orcm_pnp_base_window_release(send);
+        orcm_pnp_base_return_send(send);
+        start_parked(next);
+    }
+    return ret;
+}
+
+/* the transport is done with a send */
+static void send_complete(int status, orcm_pnp_send_t *send)
+{
+    orcm_pnp_send_t *next;
+
+    /* do any required callbacks */
+    orcm_pnp_base_report_send(send, status);
+    /* free its slot in the send window - releasing the
+     * send also releases the msg
+     */
+    next = orcm_pnp_base_window_release(send);
+    orcm_pnp_base_return_send(send);
+    start_parked(next);
+}
+
+/* find the batch for a multicast channel, creating it if asked */
+static orcm_pnp_batch_t* get_batch(orcm_pnp_channel_t channel, bool create)
+{
+    orcm_pnp_batch_t *batch=NULL;
+    void *ptr;
+
+    OPAL_THREAD_LOCK(&orcm_pnp_base.batch_lock);
+    if (OPAL_SUCCESS == opal_hash_table_get_value_uint32(&orcm_pnp_base.batches,
+                                                         channel, &ptr)) {
+        batch = (orcm_pnp_batch_t*)ptr;
+    } else if (create) {
+        batch = OBJ_NEW(orcm_pnp_batch_t);
+        batch->channel = channel;
+        opal_event_evtimer_set(opal_event_base, &batch->ev, batch_timeout_cb, batch);
+        opal_hash_table_set_value_uint32(&orcm_pnp_base.batches, channel, batch);
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.batch_lock);
+    return batch;
+}
+
+/* take the frame out of a batch - must be called with the batch locked */
+static opal_buffer_t* take_frame(orcm_pnp_batch_t *batch, orcm_pnp_tag_t *tag)
+{
+    opal_buffer_t *frame;
+
+    if (batch->timer_active) {
+        opal_event_evtimer_del(&batch->ev);
+        batch->timer_active = false;
+    }
+    frame = batch->frame;
+    *tag = batch->tag;
+    batch->frame = NULL;
+    return frame;
+}
+
+/* multicast a completed frame */
+static int send_frame(orcm_pnp_channel_t channel, orcm_pnp_tag_t tag,
+                      opal_buffer_t *frame)
+{
+    orcm_pnp_send_t *send;
+
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:default:sending batch of %d bytes to channel %s",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                         (int)frame->bytes_used,
+                         orcm_pnp_print_channel(channel)));
+
+    send = orcm_pnp_base_get_send();
+    send->tag = tag;
+    send->hdr = frame;
+    send->multicast = true;
+    send->channel = channel;
+    send->bytes = frame->bytes_used;
+    return start_send(send);
+}
+
+static void batch_timeout_cb(int fd, short flags, void *cbdata)
+{
+    orcm_pnp_batch_t *batch = (orcm_pnp_batch_t*)cbdata;
+    opal_buffer_t *frame;
+    orcm_pnp_tag_t tag;
+    struct timeval delay;
+
+    /* a sender holding the send lock may be waiting on this thread
+     * for room in its send window, so never block here - just try
+     * again shortly
+     */
+    if (0 != opal_mutex_trylock(&batch->send_lock)) {
+        OPAL_THREAD_LOCK(&batch->lock);
+        if (NULL != batch->frame) {
+            delay.tv_sec = orcm_pnp_base.batch_timeout / 1000000;
+            delay.tv_usec = orcm_pnp_base.batch_timeout % 1000000;
+            opal_event_evtimer_add(&batch->ev, &delay);
+        } else {
+            batch->timer_active = false;
+        }
+        OPAL_THREAD_UNLOCK(&batch->lock);
+        return;
+    }
+
+    OPAL_THREAD_LOCK(&batch->lock);
+    /* the timer has fired, so there is nothing to delete */
+    batch->timer_active = false;
+    frame = take_frame(batch, &tag);
+    OPAL_THREAD_UNLOCK(&batch->lock);
+
+    if (NULL != frame) {
+        send_frame(batch->channel, tag, frame);
+    }
+    opal_mutex_unlock(&batch->send_lock);
+}
+
+static int flush_batch(orcm_pnp_batch_t *batch)
+{
+    opal_buffer_t *frame;
+    orcm_pnp_tag_t tag;
+    int ret=ORCM_SUCCESS;
+
+    OPAL_THREAD_LOCK(&batch->send_lock);
+    OPAL_THREAD_LOCK(&batch->lock);
+    frame = take_frame(batch, &tag);
+    OPAL_THREAD_UNLOCK(&batch->lock);
+
+    if (NULL != frame) {
+        ret = send_frame(batch->channel, tag, frame);
+    }
+    OPAL_THREAD_UNLOCK(&batch->send_lock);
+    return ret;
+}
+
+static void flush_all_batches(void)
+{
+    opal_pointer_array_t pending;
+    uint32_t chan;
+    void *ptr, *node, *next;
+    int rc, i;
+
+    /* collect the batches first so none are sent while
+     * holding the table lock
+     */
+    OBJ_CONSTRUCT(&pending, opal_pointer_array_t);
+    opal_pointer_array_init(&pending, 8, INT_MAX, 8);
+    OPAL_THREAD_LOCK(&orcm_pnp_base.batch_lock);
+    rc = opal_hash_table_get_first_key_uint32(&orcm_pnp_base.batches,
+                                              &chan, &ptr, &node);
+    while (OPAL_SUCCESS == rc) {
+        opal_pointer_array_add(&pending, ptr);
+        rc = opal_hash_table_get_next_key_uint32(&orcm_pnp_base.batches,
+                                                 &chan, &ptr, node, &next);
+        node = next;
+    }
+    OPAL_THREAD_UNLOCK(&orcm_pnp_base.batch_lock);
+
+    for (i=0; i < pending.size; i++) {
+        if (NULL != (ptr = opal_pointer_array_get_item(&pending, i))) {
+            flush_batch((orcm_pnp_batch_t*)ptr);
+        }
+    }
+    OBJ_DESTRUCT(&pending);
+}
+
+static int default_output_batch(orcm_pnp_channel_t channel,
+                                orte_process_name_t *recipient,
+                                orcm_pnp_tag_t tag,
+                                struct iovec *msg, int count,
+                                opal_buffer_t *buffer,
+                                orcm_pnp_callback_fn_t cbfunc,
+                                void *cbdata)
+{
+    orcm_pnp_batch_t *batch;
+    opal_buffer_t *full=NULL, *ready=NULL;
+    orcm_pnp_tag_t full_tag=ORCM_PNP_TAG_INVALID, ready_tag=ORCM_PNP_TAG_INVALID;
+    orcm_pnp_channel_t chan;
+    struct timeval delay;
+    size_t len;
+    int i, ret;
+
+    /* p2p msgs and announcements are never batched */
+    if ((NULL != recipient &&
+         (ORTE_JOBID_WILDCARD != recipient->jobid ||
+          ORTE_VPID_WILDCARD != recipient->vpid)) ||
+        ORCM_PNP_TAG_ANNOUNCE == tag) {
+        return default_output_nb(channel, recipient, tag, msg, count,
+                                 buffer, cbfunc, cbdata);
+    }
+
+    /* if we have not announced, ignore this message */
+    if (NULL == orcm_pnp_base.my_string_id) {
+        return ORCM_ERR_NOT_AVAILABLE;
+    }
+
+    if (!orcm_pnp_base.comm_enabled) {
+        return ORCM_ERR_COMM_DISABLED;
+    }
+
+    /* if this is going on the group channel, then substitute that channel here */
+    if (ORCM_PNP_GROUP_OUTPUT_CHANNEL == channel) {
+        chan = orcm_pnp_base.my_output_channel->channel;
+    } else if (ORCM_PNP_GROUP_INPUT_CHANNEL == channel) {
+        chan = orcm_pnp_base.my_input_channel->channel;
     } else {
-        ret = ORCM_SUCCESS;
+        chan = channel;
+    }
+
+    /* estimate the room the msg will take in the frame */
+    if (NULL != msg) {
+        len = (count + 2) * sizeof(int32_t);
+        for (i=0; i < count; i++) {
+            len += msg[i].iov_len;
+        }
+    } else {
+        len = sizeof(int32_t) + buffer->bytes_used -
+            (size_t)(buffer->unpack_ptr - buffer->base_ptr);
+    }
+
+    batch = get_batch(chan, true);
+
+    /* hold the send lock until any frames taken here are sent, so
+     * nobody else can take and send a later frame ahead of them
+     */
+    OPAL_THREAD_LOCK(&batch->send_lock);
+    OPAL_THREAD_LOCK(&batch->lock);
+    /* if the msg won't fit, send what we have first */
+    if (NULL != batch->frame &&
+        (size_t)orcm_pnp_base.batch_size < batch->frame->bytes_used + len) {
+        full = take_frame(batch, &full_tag);
+    }
+    if (NULL == batch->frame) {
+        if (ORCM_SUCCESS != (ret = orcm_pnp_base_start_batch(&batch->frame, tag))) {
+            OPAL_THREAD_UNLOCK(&batch->lock);
+            goto cleanup;
+        }
+        batch->tag = tag;
+        if (0 < orcm_pnp_base.batch_timeout) {
+            delay.tv_sec = orcm_pnp_base.batch_timeout / 1000000;
+            delay.tv_usec = orcm_pnp_base.batch_timeout % 1000000;
+            opal_event_evtimer_add(&batch->ev, &delay);
+            batch->timer_active = true;
+        }
+    }
+    if (ORCM_SUCCESS != (ret = orcm_pnp_base_batch_msg(batch->frame, tag, msg, count, buffer))) {
+        /* the frame is now corrupt - drop it */
+        ready = take_frame(batch, &ready_tag);
+        OBJ_RELEASE(ready);
+        ready = NULL;
+        OPAL_THREAD_UNLOCK(&batch->lock);
+        goto cleanup;
+    }
+    /* ship it if the frame is now full */
+    if ((size_t)orcm_pnp_base.batch_size <= batch->frame->bytes_used) {
+        ready = take_frame(batch, &ready_tag);
+    }
+    OPAL_THREAD_UNLOCK(&batch->lock);
+
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:default:batched %d %s to channel %s tag %s",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                         (NULL == msg) ? (int)buffer->bytes_used : count,
+                         (NULL == msg) ? "bytes" : "iovecs",
+                         orcm_pnp_print_channel(channel),
+                         orcm_pnp_print_tag(tag)));
+
+ cleanup:
+    if (NULL != full) {
+        send_frame(chan, full_tag, full);
+    }
+    if (NULL != ready) {
+        send_frame(chan, ready_tag, ready);
+    }
+    OPAL_THREAD_UNLOCK(&batch->send_lock);
+    if (ORCM_SUCCESS != ret) {
+        return ret;
+    }
+    /* the msg has been copied into the frame, so the caller
+     * can have it back right away
+     */
+    if (NULL != cbfunc) {
+        cbfunc(ORCM_SUCCESS, ORTE_PROC_MY_NAME, tag, msg, count, buffer, cbdata);
+    }
+    return ORCM_SUCCESS;
+}
+
+static int default_flush(orcm_pnp_channel_t channel)
+{
+    orcm_pnp_batch_t *batch;
+
+    if (ORCM_PNP_GROUP_OUTPUT_CHANNEL == channel) {
+        channel = orcm_pnp_base.my_output_channel->channel;
+    } else if (ORCM_PNP_GROUP_INPUT_CHANNEL == channel) {
+        channel = orcm_pnp_base.my_input_channel->channel;
+    }
+
+    /* nothing ever batched there */
+    if (NULL == (batch = get_batch(channel, false))) {
+        return ORCM_SUCCESS;
     }
+    return flush_batch(batch);
+}
+
+static int default_output_stream(orcm_pnp_channel_t channel,
+                                 orte_process_name_t *recipient,
+                                 orcm_pnp_tag_t tag,
+                                 struct iovec *msg, int count,
+                                 opal_buffer_t *buffer,
+                                 orcm_pnp_callback_fn_t cbfunc,
+                                 void *cbdata)
+{
+    orcm_pnp_stream_t *stream;
+    int ret;
+
+    /* if we have not announced, ignore this message */
+    if (NULL == orcm_pnp_base.my_string_id) {
+        return ORCM_ERR_NOT_AVAILABLE;
+    }
+
+    if (!orcm_pnp_base.comm_enabled) {
+        return ORCM_ERR_COMM_DISABLED;
+    }
+
+    stream = OBJ_NEW(orcm_pnp_stream_t);
+    stream->tag = tag;
+    stream->cbfunc = cbfunc;
+    stream->cbdata = cbdata;
+    orcm_pnp_base_setup_stream(stream, msg, count, buffer);
+
+    /* if it fits in one fragment, there is nothing to stream */
+    if (stream->total <= (int64_t)orcm_pnp_base.fragment_size) {
+        OBJ_RELEASE(stream);
+        return default_output_nb(channel, recipient, tag, msg, count,
+                                 buffer, cbfunc, cbdata);
+    }
+
+    if (NULL == recipient ||
+        (ORTE_JOBID_WILDCARD == recipient->jobid &&
+         ORTE_VPID_WILDCARD == recipient->vpid)) {
+        /* if this is going on the group channel, then substitute that channel here */
+        if (ORCM_PNP_GROUP_OUTPUT_CHANNEL == channel) {
+            stream->channel = orcm_pnp_base.my_output_channel->channel;
+        } else if (ORCM_PNP_GROUP_INPUT_CHANNEL == channel) {
+            stream->channel = orcm_pnp_base.my_input_channel->channel;
+        } else {
+            stream->channel = channel;
+        }
+        stream->multicast = true;
+    } else if (ORTE_JOBID_WILDCARD == recipient->jobid ||
+               ORTE_VPID_WILDCARD == recipient->vpid) {
+        /* if only one name field is WILDCARD, I don't know how to send
+         * it - at least, not right now
+         */
+        ORTE_ERROR_LOG(ORTE_ERR_NOT_IMPLEMENTED);
+        OBJ_RELEASE(stream);
+        return ORTE_ERR_NOT_IMPLEMENTED;
+    } else {
+        stream->target = *recipient;
+    }
+
+    OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
+                         "%s pnp:default:streaming %ld bytes as stream %u to %s tag %s",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                         (long)stream->total, stream->id,
+                         stream->multicast ? orcm_pnp_print_channel(stream->channel) :
+                         ORTE_NAME_PRINT(&stream->target),
+                         orcm_pnp_print_tag(tag)));
+
+    pump_stream(stream);
+
+    /* if not even the first fragment could be sent, nothing will
+     * ever call back - so report it here
+     */
+    ret = ORCM_SUCCESS;
+    OPAL_THREAD_LOCK(&stream->lock);
+    if (0 == stream->inflight && !stream->complete) {
+        stream->complete = true;
+        ret = stream->status;
+    }
+    OPAL_THREAD_UNLOCK(&stream->lock);
+
+    /* otherwise the stream lives until its last fragment has gone */
+    OBJ_RELEASE(stream);
     return ret;
 }
 
+/* the transport is done with a fragment - keep the pipeline full
+ * and let the caller know once the whole msg has gone
+ */
+static void stream_fragment_cb(int status, orte_process_name_t *sender,
+                               orcm_pnp_tag_t tag, struct iovec *msg,
+                               int count, opal_buffer_t *buffer,
+                               void *cbdata)
+{
+    orcm_pnp_stream_t *stream = (orcm_pnp_stream_t*)cbdata;
+    bool done=false, more=false;
+
+    OPAL_THREAD_LOCK(&stream->lock);
+    stream->inflight--;
+    if (ORCM_SUCCESS != status && ORCM_SUCCESS == stream->status) {
+        stream->status = status;
+    }
+    if (0 == stream->inflight &&
+        (stream->total <= stream->sent || ORCM_SUCCESS != stream->status) &&
+        !stream->complete) {
+        stream->complete = true;
+        done = true;
+    } else if (ORCM_SUCCESS == stream->status && stream->sent < stream->total) {
+        more = true;
+    }
+    OPAL_THREAD_UNLOCK(&stream->lock);
+
+    if (more) {
+        pump_stream(stream);
+    }
+    if (done && NULL != stream->cbfunc) {
+        stream->cbfunc(stream->status, ORTE_PROC_MY_NAME, stream->tag,
+                       stream->msg, stream->count, stream->buffer, stream->cbdata);
+    }
+    /* release the fragment's hold on the stream */
+    OBJ_RELEASE(stream);
+}
+
+/* send fragments until the pipeline is full */
+static void pump_stream(orcm_pnp_stream_t *stream)
+{
+    orcm_pnp_send_t *send;
+    opal_buffer_t *frag;
+    int ret;
+
+    OPAL_THREAD_LOCK(&stream->lock);
+    if (stream->pumping) {
+        /* whoever is pumping will see the room we made */
+        OPAL_THREAD_UNLOCK(&stream->lock);
+        return;
+    }
+    stream->pumping = true;
+    while (ORCM_SUCCESS == stream->status &&
+           stream->inflight < orcm_pnp_base.stream_depth &&
+           stream->sent < stream->total) {
+        if (ORCM_SUCCESS != (ret = orcm_pnp_base_next_fragment(stream, &frag))) {
+            stream->status = ret;
+            break;
+        }
+        stream->inflight++;
+        OBJ_RETAIN(stream);
+        OPAL_THREAD_UNLOCK(&stream->lock);
+
+        send = orcm_pnp_base_get_send();
+        send->tag = stream->tag;
+        send->hdr = frag;
+        send->multicast = stream->multicast;
+        send->channel = stream->channel;
+        send->target = stream->target;
+        send->bytes = frag->bytes_used;
+        send->cbfunc = stream_fragment_cb;
+        send->cbdata = stream;
+        ret = start_send(send);
+        OPAL_THREAD_LOCK(&stream->lock);
+        if (ORCM_SUCCESS != ret) {
+            /* never got to the transport, so account for it here */
+            stream->pumping = false;
+            OPAL_THREAD_UNLOCK(&stream->lock);
+            stream_fragment_cb(ret, ORTE_PROC_MY_NAME, stream->tag, NULL, 0, NULL, stream);
+            return;
+        }
+    }
+    stream->pumping = false;
+    OPAL_THREAD_UNLOCK(&stream->lock);
+}
+
 static orcm_pnp_tag_t define_new_tag(void)
 {
     return ORCM_PNP_TAG_INVALID;
@@ -1044,6 +1814,16 @@ static char* get_string_id(void)
     return strdup(orcm_pnp_base.my_string_id);
 }
 
+static int get_fd(void)
+{
+    return orcm_pnp_base_progress_fd();
+}
+
+static int progress(int max_msgs)
+{
+    return orcm_pnp_base_progress(max_msgs);
+}
+
 static int disable_comm(void)
 {
     OPAL_OUTPUT_VERBOSE((2, orcm_pnp_base.output,
@@ -1062,6 +1842,9 @@ static int disable_comm(void)
         recv_on = false;
     }
 
+    /* stop taking msgs through shared memory */
+    orcm_pnp_base_shm_finalize();
+
     /* stop the processing thread */
     orcm_pnp_base_stop_threads();
 }
@@ -1074,6 +1857,8 @@ static int default_finalize(void)
                          ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
     
     if (orcm_pnp_base.comm_enabled) {
+        /* get any batched msgs out before we go */
+        flush_all_batches();
         disable_comm();
     }
 
@@ -1092,13 +1877,8 @@ static void rmcast_callback(int status,
                             orte_process_name_t *sender,
                             opal_buffer_t *buf, void* cbdata)
 {
-    orcm_pnp_send_t *send = (orcm_pnp_send_t*)cbdata;
-    
-    OBJ_RELEASE(buf);
-    if (NULL != send->cbfunc) {
-        send->cbfunc(status, ORTE_PROC_MY_NAME, send->tag, send->msg, send->count, send->buffer, send->cbdata);
-    }
-    OBJ_RELEASE(send);
+    /* the buffer belongs to the send */
+    send_complete(status, (orcm_pnp_send_t*)cbdata);
 }
 
 static void rml_callback(int status,
@@ -1107,12 +1887,16 @@ static void rml_callback(int status,
                          orte_rml_tag_t tag,
                          void* cbdata)
 {
-    orcm_pnp_send_t *send = (orcm_pnp_send_t*)cbdata;
-    
-    OBJ_RELEASE(buffer);
-    /* do any required callbacks */
-    if (NULL != send->cbfunc) {
-        send->cbfunc(status, ORTE_PROC_MY_NAME, send->tag, send->msg, send->count, send->buffer, send->cbdata);
-    }
-    OBJ_RELEASE(send);
+    /* the buffer belongs to the send */
+    send_complete(status, (orcm_pnp_send_t*)cbdata);
+}
+
+static void rml_iovec_callback(int status,
+                               orte_process_name_t* sender,
+                               struct iovec* msg,
+                               int count,
+                               orte_rml_tag_t tag,
+                               void* cbdata)
+{
+    send_complete(status, (orcm_pnp_send_t*)cbdata);
 }
@@ -82,6 +82,39 @@ typedef int (*orcm_pnp_module_register_receive_fn_t)(const char *app,
                                                      orcm_pnp_callback_fn_t cbfunc,
                                                      void *cbdata);
 
+/*
+ * Receive msgs exactly as register_receive does, but hand each one to the
+ * callback piece by piece as it arrives instead of all at once. Msgs sent
+ * with output_stream arrive in fragment-sized pieces, so the receiver
+ * never has to hold a whole large msg. Any other msg arrives as a single
+ * piece (or one piece per iovec).
+ */
+typedef int (*orcm_pnp_module_register_stream_fn_t)(const char *app,
+                                                    const char *version,
+                                                    const char *release,
+                                                    orcm_pnp_channel_t channel,
+                                                    orcm_pnp_tag_t tag,
+                                                    orcm_pnp_stream_fn_t cbfunc,
+                                                    void *cbdata);
+
+/*
+ * Receive msgs exactly as register_receive does, but run the callback
+ * on the given executor instead of on the recv processing thread, so a
+ * callback that blocks cannot hold up delivery to anyone else. Each
+ * msg is copied for the executor, so the buffer or iovecs the callback
+ * gets are only valid until it returns, as usual. An executor queues
+ * up to pnp_base_exec_queue_size msgs - what happens to a msg beyond
+ * that is set by pnp_base_exec_policy.
+ */
+typedef int (*orcm_pnp_module_register_receive_exec_fn_t)(const char *app,
+                                                          const char *version,
+                                                          const char *release,
+                                                          orcm_pnp_channel_t channel,
+                                                          orcm_pnp_tag_t tag,
+                                                          orcm_pnp_exec_t exec,
+                                                          orcm_pnp_callback_fn_t cbfunc,
+                                                          void *cbdata);
+
 /* Cancel a receive - must provide the triplet and the channel (GROUP_OUTPUT or GROUP_INPUT)
  * and tag to get cancelled. A wildcard value for tag will cancel all receives on the
  * given channel. Likewise, a wildcard value for channel will cancel both output and
@@ -103,6 +136,16 @@ typedef int (*orcm_pnp_module_cancel_recv_fn_t)(const char *app,
  * NOTE: only processes that have registered_input from this app/version/release
  * will actually receive the message. Thus, it should NOT be assumed that a process
  * on the given channel actually received all prior messages.
+ *
+ * NOTE: iovecs sent point-to-point are handed to the transport without being
+ * copied, so for the non-blocking form they must not be changed or released
+ * until the callback fires.
+ *
+ * NOTE: when pnp_base_shm is set, a point-to-point msg for a process on the
+ * same node is copied straight into that process' shared memory, so the
+ * non-blocking form completes at once and its callback fires on the caller's
+ * thread before output_nb returns - the callback must not need anything the
+ * caller holds across the call to output_nb.
  */
 typedef int (*orcm_pnp_module_output_fn_t)(orcm_pnp_channel_t channel,
                                            orte_process_name_t *recipient,
@@ -118,12 +161,82 @@ typedef int (*orcm_pnp_module_output_nb_fn_t)(orcm_pnp_channel_t channel,
                                               orcm_pnp_callback_fn_t cbfunc,
                                               void *cbdata);
 
+/*
+ * Send a msg exactly as output_nb does, but report its completion
+ * through a request instead of a callback. The request is returned in
+ * req, and is completed once the transport is done with the msg - the
+ * msg must be left alone until then. Check on it with orcm_pnp_test,
+ * or wait for it with orcm_pnp_wait/wait_any/wait_all, which also
+ * release it. No request is returned if the send fails right away.
+ */
+typedef int (*orcm_pnp_module_output_req_fn_t)(orcm_pnp_channel_t channel,
+                                               orte_process_name_t *recipient,
+                                               orcm_pnp_tag_t tag,
+                                               struct iovec *msg, int count,
+                                               opal_buffer_t *buffer,
+                                               orcm_pnp_send_req_t **req);
+
+/*
+ * Multicast a msg coalesced with other small msgs on the same channel. Msgs
+ * are packed into one frame that goes out once it reaches
+ * pnp_base_batch_size bytes, once its first msg has waited
+ * pnp_base_batch_timeout usecs, or when the channel is flushed. The msg is
+ * copied into the frame, so the callback fires before this returns.
+ * Receivers see each msg individually, exactly as if it had been sent with
+ * output_nb. Msgs for a specific recipient are not batched - they are
+ * simply handed to output_nb.
+ */
+typedef int (*orcm_pnp_module_output_batch_fn_t)(orcm_pnp_channel_t channel,
+                                                 orte_process_name_t *recipient,
+                                                 orcm_pnp_tag_t tag,
+                                                 struct iovec *msg, int count,
+                                                 opal_buffer_t *buffer,
+                                                 orcm_pnp_callback_fn_t cbfunc,
+                                                 void *cbdata);
+
+/*
+ * Send a msg too large to go out in one piece. The msg is split into
+ * sequenced fragments of pnp_base_fragment_size bytes, with up to
+ * pnp_base_stream_depth of them in flight at once, so neither the
+ * multicast size limit nor the size of the msg holds up the sender.
+ * Recvs registered with register_receive get the reassembled msg as a
+ * buffer - recvs registered with register_stream get each fragment as it
+ * arrives. A msg that fits in one fragment simply goes out as it would
+ * with output_nb. The msg must not be changed or released until the
+ * callback fires, which happens once the last fragment has gone.
+ */
+typedef int (*orcm_pnp_module_output_stream_fn_t)(orcm_pnp_channel_t channel,
+                                                  orte_process_name_t *recipient,
+                                                  orcm_pnp_tag_t tag,
+                                                  struct iovec *msg, int count,
+                                                  opal_buffer_t *buffer,
+                                                  orcm_pnp_callback_fn_t cbfunc,
+                                                  void *cbdata);
+
+/* send any msgs batched on the channel right away */
+typedef int (*orcm_pnp_module_flush_fn_t)(orcm_pnp_channel_t channel);
+
 /* dynamically define a new tag */
 typedef orcm_pnp_tag_t (*orcm_pnp_module_define_new_tag_fn_t)(void);
 
 /* retrieve the triplet string id for this app */
 typedef char* (*orcm_pnp_module_get_string_id_fn_t)(void);
 
+/*
+ * Process recvd msgs on the caller's thread instead of on a thread of
+ * our own - only available when pnp_base_recv_progress is set, in which
+ * case no recv processing thread is started. get_fd returns an fd for
+ * the app to add to its own event loop (-1 if not available), and
+ * progress runs the callbacks for up to max_msgs waiting msgs (all of
+ * them if max_msgs <= 0), returning how many it processed. Keep
+ * calling progress until it returns 0 - only then is the fd certain
+ * to become readable when the next msg arrives. Control msgs are
+ * processed here too, so progress must be called promptly. Only one
+ * thread may call progress, and never from within a pnp callback.
+ */
+typedef int (*orcm_pnp_module_get_fd_fn_t)(void);
+typedef int (*orcm_pnp_module_progress_fn_t)(int max_msgs);
+
 /* component struct */
 typedef struct {
     /** Base component description */
@@ -140,18 +253,110 @@ typedef struct {
     orcm_pnp_module_announce_fn_t                   announce;
     orcm_pnp_module_open_channel_fn_t               open_channel;
     orcm_pnp_module_register_receive_fn_t           register_receive;
+    orcm_pnp_module_register_stream_fn_t            register_stream;
+    orcm_pnp_module_register_receive_exec_fn_t      register_receive_exec;
     orcm_pnp_module_cancel_recv_fn_t                cancel_receive;
     orcm_pnp_module_output_fn_t                     output;
     orcm_pnp_module_output_nb_fn_t                  output_nb;
+    orcm_pnp_module_output_req_fn_t                 output_req;
+    orcm_pnp_module_output_batch_fn_t               output_batch;
+    orcm_pnp_module_flush_fn_t                      flush;
+    orcm_pnp_module_output_stream_fn_t              output_stream;
     orcm_pnp_module_define_new_tag_fn_t             define_new_tag;
     orcm_pnp_module_get_string_id_fn_t              get_string_id;
     orcm_pnp_module_disable_comm_fn_t               disable_comm;
+    orcm_pnp_module_get_fd_fn_t                     get_fd;
+    orcm_pnp_module_progress_fn_t                   progress;
     orcm_pnp_module_finalize_fn_t                   finalize;
 } orcm_pnp_base_module_t;
 
 /** Interface for PNP communication */
 ORCM_DECLSPEC extern orcm_pnp_base_module_t orcm_pnp;
 
+/*
+ * The buffer passed to a recv callback is only valid until the callback
+ * returns. A callback that needs the data afterwards can retain it - the
+ * returned buffer holds the unread remainder of the msg (unpacking picks up
+ * where the callback left off) and must be released by the caller. Where
+ * possible the storage is handed over rather than copied, leaving the
+ * original buffer empty. Any iovecs delivered to a callback point into
+ * the recvd msg and are likewise only valid until the callback returns.
+ *
+ * A msg is delivered to every recv that matches it, in the order the
+ * recvs were registered. They all share the one decoded buffer, which is
+ * rewound to the start of the payload for each and must not be modified.
+ * While later recvs still need the buffer it carries an extra reference,
+ * and retaining it then copies the remainder instead of taking it.
+ */
+ORCM_DECLSPEC opal_buffer_t* orcm_pnp_retain_buffer(opal_buffer_t *buf);
+
+/*
+ * Report the non-blocking sends still in flight to a channel, or to a
+ * specific process if recipient is given, so callers can pace
+ * themselves. Sends are only metered when a send window is configured
+ * (pnp_base_send_window_msgs/bytes). What happens to a send that would
+ * overflow its window is set by pnp_base_send_window_policy - output_nb
+ * can wait for room, queue the msg (dropping the oldest queued msg when
+ * the queue is full, whose callback then fires with
+ * ORCM_ERR_TEMP_OUT_OF_RESOURCE) or hand the msg back through its
+ * callback with ORCM_ERR_WOULD_BLOCK. Without a callback, a refused msg
+ * is reported by output_nb returning ORCM_ERR_WOULD_BLOCK instead. Do not
+ * use the waiting policy if output_nb is called from within a send
+ * callback.
+ */
+ORCM_DECLSPEC int orcm_pnp_get_send_window(orcm_pnp_channel_t channel,
+                                           orte_process_name_t *recipient,
+                                           int32_t *msgs, int64_t *bytes);
+
+/*
+ * Complete requests returned by output_req. Each returns the status
+ * the send completed with - wait_all the first failure among them.
+ * A request that has been reported complete is released and the
+ * caller's pointer to it set to NULL; NULL requests are ignored, and
+ * wait_any returns an index of -1 if given nothing to wait on. Test
+ * never blocks - it sets done false if the request has yet to complete.
+ * The waits block the calling thread until the transport reports the
+ * sends done, so they must not be called from a pnp callback or from
+ * the thread progressing the event library.
+ */
+ORCM_DECLSPEC int orcm_pnp_test(orcm_pnp_send_req_t **req, bool *done);
+ORCM_DECLSPEC int orcm_pnp_wait(orcm_pnp_send_req_t **req);
+ORCM_DECLSPEC int orcm_pnp_wait_any(int count, orcm_pnp_send_req_t **reqs, int *index);
+ORCM_DECLSPEC int orcm_pnp_wait_all(int count, orcm_pnp_send_req_t **reqs);
+
+/*
+ * Report how well payload compression is doing. Buffer payloads of at
+ * least pnp_base_compress_threshold bytes (0 => never) sent on the
+ * channels listed in pnp_base_compress_channels (all if none) go out
+ * compressed, and are decompressed before delivery.
+ */
+ORCM_DECLSPEC void orcm_pnp_get_compress_stats(orcm_pnp_compress_stats_t *stats);
+
+/*
+ * Report the traffic seen by this proc on each channel and tag, along
+ * with the number of recvd msgs waiting to be processed (and the deepest
+ * any recv queue has been) and likewise the number waiting on recv
+ * executors. The metrics are returned in an array
+ * that must be freed by the caller. Metrics are only kept when
+ * pnp_base_metrics is set. Any proc can also be asked for its metrics
+ * by sending it an ORCM_PNP_TAG_METRICS msg - the answer comes back as
+ * an ORCM_PNP_TAG_METRICS_REPLY buffer that unpack_metrics decodes.
+ */
+ORCM_DECLSPEC int orcm_pnp_get_metrics(orcm_pnp_metrics_t **metrics, int32_t *num,
+                                       int32_t *depth, int32_t *max_depth,
+                                       int32_t *exec_depth, int32_t *exec_max_depth);
+ORCM_DECLSPEC int orcm_pnp_unpack_metrics(opal_buffer_t *buf,
+                                          orcm_pnp_metrics_t **metrics, int32_t *num,
+                                          int32_t *depth, int32_t *max_depth,
+                                          int32_t *exec_depth, int32_t *exec_max_depth);
+
+/*
+ * Estimate the value below which the given percentage of the
+ * samples in a histogram fall
+ */
+ORCM_DECLSPEC int64_t orcm_pnp_histogram_percentile(const orcm_pnp_histogram_t *hist,
+                                                    double pct);
+
 /*
  * Macro for use in components that are of type coll
  */
@@ -57,6 +57,13 @@ enum {
 
 #define ORCM_PNP_TAG_DYNAMIC    ORTE_RMCAST_TAG_DYNAMIC
 
+/* pnp's own tags, taken from just below the dynamic range - a
+ * metrics query sent directly to a proc is answered by pnp itself
+ * with a METRICS_REPLY
+ */
+#define ORCM_PNP_TAG_METRICS        (ORCM_PNP_TAG_DYNAMIC - 1)
+#define ORCM_PNP_TAG_METRICS_REPLY  (ORCM_PNP_TAG_DYNAMIC - 2)
+
 /* inherited channels */
 enum {
     ORCM_PNP_GROUP_INPUT_CHANNEL    = ORTE_RMCAST_GROUP_INPUT_CHANNEL,
@@ -73,10 +80,17 @@ enum {
 
 #define ORCM_PNP_DYNAMIC_CHANNELS   ORTE_RMCAST_DYNAMIC_CHANNELS
 
+struct orcm_pnp_recv_index_t;
+
 typedef struct {
     opal_object_t super;
     orcm_pnp_channel_t channel;
     opal_list_t recvs;
+    /* lock-free lookup index for the recvs, and the
+     * superseded versions of it
+     */
+    struct orcm_pnp_recv_index_t * volatile index;
+    struct orcm_pnp_recv_index_t *retired;
 } orcm_pnp_channel_obj_t;
 ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_channel_obj_t);
 
@@ -106,6 +120,98 @@ typedef void (*orcm_pnp_callback_fn_t)(int status,
                                        opal_buffer_t *buf,
                                        void *cbdata);
 
+/* payload compression statistics */
+typedef struct {
+    /* msgs sent compressed, and their payload bytes before and after */
+    int64_t msgs_compressed;
+    int64_t bytes_in;
+    int64_t bytes_out;
+    /* msgs big enough to compress that did not shrink enough */
+    int64_t msgs_skipped;
+    /* cpu time spent compressing all of the above */
+    int64_t compress_usecs;
+    int64_t msgs_decompressed;
+    int64_t decompress_usecs;
+} orcm_pnp_compress_stats_t;
+
+/* log-linear histogram of usecs - values below 16 are counted
+ * exactly, larger ones in buckets no wider than 1/8 of their value
+ */
+#define ORCM_PNP_HIST_SUB_BITS  3
+#define ORCM_PNP_HIST_BUCKETS   ((32 - ORCM_PNP_HIST_SUB_BITS + 1) << ORCM_PNP_HIST_SUB_BITS)
+
+typedef struct {
+    int64_t count;
+    int64_t sum;
+    int64_t max;
+    int64_t buckets[ORCM_PNP_HIST_BUCKETS];
+} orcm_pnp_histogram_t;
+
+/* traffic on one tag of one channel - direct msgs are counted
+ * against ORCM_PNP_DIRECT_CHANNEL. A batched frame or a fragment
+ * of a streamed msg counts as one msg
+ */
+typedef struct {
+    orcm_pnp_channel_t channel;
+    orcm_pnp_tag_t tag;
+    int64_t msgs_in;
+    int64_t bytes_in;
+    int64_t msgs_out;
+    int64_t bytes_out;
+    /* msgs nobody had registered to recv */
+    int64_t drops_no_recv;
+    /* msgs from a proc that is not the leader of its triplet */
+    int64_t drops_not_leader;
+    /* msgs a recv's executor had no room for */
+    int64_t drops_overflow;
+    /* from the msg being queued for processing to its callback
+     * being called, and how long the callback then ran
+     */
+    orcm_pnp_histogram_t latency;
+    orcm_pnp_histogram_t callback;
+} orcm_pnp_metrics_t;
+
+/*
+ * Called with each piece of a streamed msg as it arrives. Pieces are
+ * delivered in order - offset is where this piece starts in the msg,
+ * total is the size of the whole msg, and last is set on its final
+ * piece. Pieces of different msgs from the same sender are told apart
+ * by the stream id, which is 0 for msgs that were not streamed. The data
+ * is only valid until the callback returns.
+ */
+typedef void (*orcm_pnp_stream_fn_t)(int status,
+                                     orte_process_name_t *sender,
+                                     orcm_pnp_tag_t tag,
+                                     uint32_t stream,
+                                     int64_t offset,
+                                     int64_t total,
+                                     uint8_t *data,
+                                     size_t len,
+                                     bool last,
+                                     void *cbdata);
+
+/* where a recv's callback runs */
+typedef uint8_t orcm_pnp_exec_t;
+/* on the recv processing thread, as the msg is processed */
+#define ORCM_PNP_EXEC_INLINE    0
+/* on a thread of the recv's own, one msg at a time */
+#define ORCM_PNP_EXEC_SERIAL    1
+/* on one of a pool of threads shared by such recvs - msgs from
+ * any one sender still reach the callback in order
+ */
+#define ORCM_PNP_EXEC_POOL      2
+
+/* completion of a non-blocking send issued with output_req - set
+ * once the transport is done with the msg, along with the status
+ * the send completed with
+ */
+typedef struct {
+    opal_object_t super;
+    volatile bool complete;
+    int status;
+} orcm_pnp_send_req_t;
+ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_pnp_send_req_t);
+
 END_C_DECLS
 
 #endif /* ORCM_PNP_TYPES_H */
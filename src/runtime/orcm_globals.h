@@ -27,6 +27,8 @@
 #include "opal/mca/event/event.h"
 #include "opal/class/opal_ring_buffer.h"
 #include "opal/class/opal_pointer_array.h"
+#include "opal/class/opal_hash_table.h"
+#include "opal/threads/mutex.h"
 
 #include "orte/threads/threads.h"
 #include "orte/util/proc_info.h"
@@ -72,6 +74,26 @@ typedef uint8_t orcm_notify_t;
 typedef uint32_t orcm_pnp_channel_t;
 #define ORCM_PNP_CHANNEL_T  OPAL_UINT32
 
+/* compact triplet identifier used on the wire in place of the string_id */
+typedef uint32_t orcm_triplet_handle_t;
+#define ORCM_TRIPLET_HANDLE_T   OPAL_UINT32
+#define ORCM_TRIPLET_HANDLE_INVALID 0
+
+/* pre-parsed form of a stringid so triplets can be compared without
+ * decomposing the strings each time
+ */
+#define ORCM_TRIPLET_NUM_FIELDS 3
+typedef struct {
+    /* case-folded copy of the stringid */
+    char *str;
+    /* offset, length and hash of each field within str */
+    int32_t off[ORCM_TRIPLET_NUM_FIELDS];
+    int32_t len[ORCM_TRIPLET_NUM_FIELDS];
+    uint32_t hash[ORCM_TRIPLET_NUM_FIELDS];
+    /* bit (1 << field) is set for each wildcard field */
+    uint8_t wildcards;
+} orcm_triplet_key_t;
+
 /* callback prototypes required at the global level - these
  * are named according to the framework they are associated with
  */
@@ -85,9 +107,42 @@ typedef void (*orcm_pnp_open_channel_cbfunc_t)(const char *app,
                                                orcm_pnp_channel_t channel);
 
 /* global objects - need to be accessed from multiple frameworks */
+struct orcm_triplet_t;
+struct orcm_triplet_group_t;
+
+/* open-addressed table of all known triplets, keyed by handle. Readers
+ * never lock - the table is only changed with the global array locked,
+ * and replaced tables are retired instead of freed
+ */
+typedef struct orcm_triplet_table_t {
+    struct orcm_triplet_table_t *retired;
+    uint32_t size;
+    uint32_t mask;
+    uint32_t count;
+    struct orcm_triplet_t * volatile *slots;
+} orcm_triplet_table_t;
+
+/* trie over the fields of a set of triplets - one level per field,
+ * with a separate edge for a wildcard field. A leaf holds the triplet
+ * spelled by the path to it. Only changed with the global array locked
+ */
+typedef struct orcm_triplet_node_t {
+    /* this node's field, case-folded, and its hash */
+    char *field;
+    int32_t len;
+    uint32_t hash;
+    /* next sibling whose field has the same hash */
+    struct orcm_triplet_node_t *collision;
+    /* field hash -> child, created on first use */
+    opal_hash_table_t *children;
+    /* child for a wildcard field */
+    struct orcm_triplet_node_t *wild;
+    struct orcm_triplet_t *triplet;
+} orcm_triplet_node_t;
+
 typedef struct {
     opal_object_t super;
-    /* thread protection */
+    /* thread protection - only required to add triplets */
     orte_thread_ctl_t ctl;
     /* storage for wildcard triplets - this is where
      * we "hold" recvs registered against triplets
@@ -96,15 +151,35 @@ typedef struct {
     opal_pointer_array_t wildcards;
     /* storage for triplets */
     opal_pointer_array_t array;
+    /* lookup table for all triplets */
+    orcm_triplet_table_t * volatile table;
+    /* field tries for the triplets without and with wildcards, so
+     * the triplets covered by a wildcard are found without a scan
+     */
+    orcm_triplet_node_t *index;
+    orcm_triplet_node_t *wildcard_index;
+    /* jobid -> chain of groups for that job, so a process
+     * name can be resolved without scanning every triplet.
+     * The lock is only ever held by itself - never take
+     * another lock while holding it
+     */
+    opal_mutex_t jobs_lock;
+    opal_hash_table_t jobs;
 } orcm_triplets_array_t;
 ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_triplets_array_t);
 
-typedef struct {
+typedef struct orcm_triplet_t {
     opal_object_t super;
     /* thread protection */
     orte_thread_ctl_t ctl;
     /* id and groups */
     char *string_id;
+    orcm_triplet_key_t key;
+    orcm_triplet_handle_t handle;
+    /* another triplet hashes to the same handle, so msgs
+     * carrying it have to be resolved by sender instead
+     */
+    bool handle_shared;
     orte_vpid_t num_procs;
     opal_pointer_array_t groups;
     /* pnp support */
@@ -121,7 +196,7 @@ typedef struct {
 } orcm_triplet_t;
 ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_triplet_t);
 
-typedef struct {
+typedef struct orcm_triplet_group_t {
     opal_object_t super;
     /* identification */
     orcm_triplet_t *triplet;
@@ -137,6 +212,8 @@ typedef struct {
     orte_vpid_t leader;
     /* members */
     opal_pointer_array_t members;
+    /* next group with the same jobid */
+    struct orcm_triplet_group_t *next_in_job;
 } orcm_triplet_group_t;
 ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_triplet_group_t);
 
@@ -148,6 +225,14 @@ typedef struct {
     orte_process_name_t name;
     /* state */
     bool alive;
+    /* contact info from its last announcement - kept so
+     * it can be relayed to others in a roster
+     */
+    char *nodename;
+    char *rml_uri;
+    uint32_t uid;
+    pid_t pid;
+    int32_t incarnation;
 } orcm_source_t;
 ORCM_DECLSPEC OBJ_CLASS_DECLARATION(orcm_source_t);
 
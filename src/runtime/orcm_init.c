@@ -34,6 +34,7 @@
 
 #include "runtime/orcm_globals.h"
 #include "runtime/runtime.h"
+#include "util/triplets.h"
 
 const char openrcm_version_string[] = "OPENRCM 0.1";
 bool orcm_initialized = false;
@@ -322,13 +323,31 @@ static void triplets_array_constructor(orcm_triplets_array_t *ptr)
 
     OBJ_CONSTRUCT(&ptr->array, opal_pointer_array_t);
     opal_pointer_array_init(&ptr->array, 8, INT_MAX, 8);
+
+    ptr->table = NULL;
+    ptr->index = NULL;
+    ptr->wildcard_index = NULL;
+
+    OBJ_CONSTRUCT(&ptr->jobs_lock, opal_mutex_t);
+    OBJ_CONSTRUCT(&ptr->jobs, opal_hash_table_t);
+    opal_hash_table_init(&ptr->jobs, 32);
 }
 static void triplets_array_destructor(orcm_triplets_array_t *ptr)
 {
     int i;
     orcm_triplet_t *trp;
+    orcm_triplet_table_t *table;
 
     OBJ_DESTRUCT(&ptr->ctl);
+    /* the groups themselves are released with their triplets */
+    OBJ_DESTRUCT(&ptr->jobs);
+    OBJ_DESTRUCT(&ptr->jobs_lock);
+    while (NULL != (table = ptr->table)) {
+        ptr->table = table->retired;
+        free((void*)table->slots);
+        free(table);
+    }
+    orcm_triplet_release_index(ptr);
     for (i=0; i < ptr->array.size; i++) {
         if (NULL != (trp = (orcm_triplet_t*)opal_pointer_array_get_item(&ptr->array, i))) {
             OBJ_RELEASE(trp);
@@ -348,10 +367,21 @@ static void source_constructor(orcm_source_t *ptr)
     ptr->name.jobid = ORTE_JOBID_INVALID;
     ptr->name.vpid = ORTE_VPID_INVALID;
     ptr->alive = true;
+    ptr->nodename = NULL;
+    ptr->rml_uri = NULL;
+    ptr->uid = 0;
+    ptr->pid = 0;
+    ptr->incarnation = 0;
 }
 static void source_destructor(orcm_source_t *ptr)
 {
     OBJ_DESTRUCT(&ptr->ctl);
+    if (NULL != ptr->nodename) {
+        free(ptr->nodename);
+    }
+    if (NULL != ptr->rml_uri) {
+        free(ptr->rml_uri);
+    }
 }
 OBJ_CLASS_INSTANCE(orcm_source_t,
                    opal_object_t,
@@ -363,6 +393,10 @@ static void triplet_constructor(orcm_triplet_t *ptr)
     OBJ_CONSTRUCT(&ptr->ctl, orte_thread_ctl_t);
 
     ptr->string_id = NULL;
+    ptr->key.str = NULL;
+    ptr->key.wildcards = 0;
+    ptr->handle = ORCM_TRIPLET_HANDLE_INVALID;
+    ptr->handle_shared = false;
     ptr->num_procs = 0;
     OBJ_CONSTRUCT(&ptr->groups, opal_pointer_array_t);
     opal_pointer_array_init(&ptr->groups, 1, INT_MAX, 8);
@@ -391,6 +425,7 @@ static void triplet_destructor(orcm_triplet_t *ptr)
     if (NULL != ptr->string_id) {
         free(ptr->string_id);
     }
+    orcm_triplet_key_release(&ptr->key);
     for (i=0; i < ptr->groups.size; i++) {
         if (NULL != (grp = (orcm_triplet_group_t*)opal_pointer_array_get_item(&ptr->groups, i))) {
             OBJ_RELEASE(grp);
@@ -423,6 +458,7 @@ static void group_constructor(orcm_triplet_group_t *ptr)
     ptr->input = ORTE_RMCAST_INVALID_CHANNEL;
     ptr->pnp_cb_done = false;
     ptr->pnp_cbfunc = NULL;
+    ptr->next_in_job = NULL;
     OBJ_CONSTRUCT(&ptr->members, opal_pointer_array_t);
     opal_pointer_array_init(&ptr->members, 8, INT_MAX, 8);
 }
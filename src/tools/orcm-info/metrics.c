@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2011      Cisco Systems, Inc.  All rights reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+#include "openrcm_config_private.h"
+#include "include/constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "opal/mca/event/event.h"
+#include "opal/dss/dss.h"
+#include "opal/util/output.h"
+#include "opal/util/fd.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "runtime/runtime.h"
+#include "mca/pnp/pnp.h"
+
+#include "orcm-info.h"
+
+/*
+ * Ask a running proc for its pnp metrics and print them. The
+ * target is given as <job>.<vpid>, where the job is local to
+ * the DVM we are connected to.
+ */
+
+static int rel_pipe[2];
+static opal_event_t rel_ev;
+static opal_event_t *timer_ev=NULL;
+static bool answered=false;
+
+static void send_cbfunc(int status,
+                        orte_process_name_t *sender,
+                        orcm_pnp_tag_t tag,
+                        struct iovec *msg,
+                        int count,
+                        opal_buffer_t *buffer,
+                        void *cbdata)
+{
+    OBJ_RELEASE(buffer);
+}
+
+static void release(int fd, short flag, void *data)
+{
+    opal_event_del(&rel_ev);
+    opal_event_base_loopexit(opal_event_base);
+}
+
+static void timeout(int fd, short flag, void *data)
+{
+    opal_output(orte_clean_output, "No metrics received from the target");
+    opal_event_base_loopexit(opal_event_base);
+}
+
+static void print_hist(const char *label, orcm_pnp_histogram_t *hist)
+{
+    if (0 == hist->count) {
+        return;
+    }
+    opal_output(orte_clean_output,
+                "    %-10s (usec): p50 %ld  p90 %ld  p99 %ld  max %ld  mean %ld",
+                label,
+                (long)orcm_pnp_histogram_percentile(hist, 50.0),
+                (long)orcm_pnp_histogram_percentile(hist, 90.0),
+                (long)orcm_pnp_histogram_percentile(hist, 99.0),
+                (long)hist->max,
+                (long)(hist->sum / hist->count));
+}
+
+static void metrics_recv(int status,
+                         orte_process_name_t *sender,
+                         orcm_pnp_tag_t tag,
+                         struct iovec *msg, int count,
+                         opal_buffer_t *buf, void *cbdata)
+{
+    orcm_pnp_metrics_t *metrics=NULL;
+    int32_t i, num, depth, max_depth, exec_depth, exec_max_depth;
+    int rc;
+
+    if (ORCM_SUCCESS != (rc = orcm_pnp_unpack_metrics(buf, &metrics, &num,
+                                                      &depth, &max_depth,
+                                                      &exec_depth, &exec_max_depth))) {
+        ORTE_ERROR_LOG(rc);
+        goto release;
+    }
+
+    opal_output(orte_clean_output, "PNP METRICS FOR %s", ORTE_NAME_PRINT(sender));
+    opal_output(orte_clean_output, "  Recv queue depth: %d (max %d)", depth, max_depth);
+    opal_output(orte_clean_output, "  Executor queue depth: %d (max %d)", exec_depth, exec_max_depth);
+    for (i=0; i < num; i++) {
+        opal_output(orte_clean_output, "  Channel %d tag %d",
+                    (int)metrics[i].channel, (int)metrics[i].tag);
+        opal_output(orte_clean_output,
+                    "    in: %ld msgs %ld bytes  out: %ld msgs %ld bytes",
+                    (long)metrics[i].msgs_in, (long)metrics[i].bytes_in,
+                    (long)metrics[i].msgs_out, (long)metrics[i].bytes_out);
+        if (0 < metrics[i].drops_no_recv || 0 < metrics[i].drops_not_leader ||
+            0 < metrics[i].drops_overflow) {
+            opal_output(orte_clean_output,
+                        "    dropped: %ld no recv  %ld not leader  %ld overflow",
+                        (long)metrics[i].drops_no_recv,
+                        (long)metrics[i].drops_not_leader,
+                        (long)metrics[i].drops_overflow);
+        }
+        print_hist("latency", &metrics[i].latency);
+        print_hist("callback", &metrics[i].callback);
+    }
+
+ release:
+    if (NULL != metrics) {
+        free(metrics);
+    }
+    answered = true;
+    opal_fd_write(rel_pipe[1], sizeof(int), &rc);
+}
+
+void orcm_info_do_metrics(const char *target)
+{
+    orte_process_name_t name;
+    opal_buffer_t *buf;
+    unsigned int job, vpid;
+    struct timeval tv;
+    int rc;
+
+    if (2 != sscanf(target, "%u.%u", &job, &vpid)) {
+        opal_output(orte_clean_output, "Metrics target must be given as <job>.<vpid>");
+        return;
+    }
+
+    if (ORCM_SUCCESS != (rc = orcm_init(ORCM_TOOL))) {
+        ORTE_ERROR_LOG(rc);
+        return;
+    }
+
+    /* register to receive the answer */
+    if (ORCM_SUCCESS != (rc = orcm_pnp.register_receive("orcm-info", "0.1", "alpha",
+                                                        ORCM_PNP_GROUP_INPUT_CHANNEL,
+                                                        ORCM_PNP_TAG_METRICS_REPLY,
+                                                        metrics_recv, NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (rc = orcm_pnp.announce("orcm-info", "0.1", "alpha", NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+
+    /* define an event to signal completion */
+    if (pipe(rel_pipe) < 0) {
+        opal_output(0, "Cannot open release pipe");
+        goto cleanup;
+    }
+    opal_event_set(opal_event_base, &rel_ev, rel_pipe[0],
+                   OPAL_EV_READ, release, NULL);
+    opal_event_add(&rel_ev, 0);
+
+    /* don't wait forever on a proc that isn't there */
+    timer_ev = opal_event_evtimer_new(opal_event_base, timeout, NULL);
+    tv.tv_sec = 10;
+    tv.tv_usec = 0;
+    opal_event_evtimer_add(timer_ev, &tv);
+
+    /* the query carries no payload */
+    name.jobid = ORTE_CONSTRUCT_LOCAL_JOBID(ORTE_PROC_MY_NAME->jobid, job);
+    name.vpid = vpid;
+    buf = OBJ_NEW(opal_buffer_t);
+    if (ORCM_SUCCESS != (rc = orcm_pnp.output_nb(ORCM_PNP_DIRECT_CHANNEL, &name,
+                                                 ORCM_PNP_TAG_METRICS,
+                                                 NULL, 0, buf, send_cbfunc, NULL))) {
+        ORTE_ERROR_LOG(rc);
+        OBJ_RELEASE(buf);
+        opal_event_del(&rel_ev);
+        goto cleanup_pipe;
+    }
+
+    opal_event_dispatch(opal_event_base);
+
+    if (!answered) {
+        opal_event_del(&rel_ev);
+    }
+
+ cleanup_pipe:
+    opal_event_evtimer_del(timer_ev);
+    opal_event_free(timer_ev);
+    close(rel_pipe[0]);
+    close(rel_pipe[1]);
+
+ cleanup:
+    orcm_finalize();
+}
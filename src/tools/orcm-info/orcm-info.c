@@ -99,6 +99,8 @@ int main(int argc, char *argv[])
                             "Show paths that Open MPI was configured with.  Accepts the following parameters: prefix, bindir, libdir, incdir, mandir, pkglibdir, sysconfdir");
     opal_cmd_line_make_opt3(orcm_info_cmd_line, '\0', NULL, "arch", 0, 
                             "Show architecture OpenRCM was compiled on");
+    opal_cmd_line_make_opt3(orcm_info_cmd_line, '\0', NULL, "metrics", 1, 
+                            "Show the pnp traffic metrics of a running process, given as <job>.<vpid>");
     opal_cmd_line_make_opt3(orcm_info_cmd_line, 'c', NULL, "config", 0, 
                             "Show configuration options");
     opal_cmd_line_make_opt3(orcm_info_cmd_line, 'h', NULL, "help", 0, 
@@ -263,6 +265,10 @@ int main(int argc, char *argv[])
         orcm_info_do_params(want_all, opal_cmd_line_is_taken(orcm_info_cmd_line, "internal"));
         acted = true;
     }
+    if (opal_cmd_line_is_taken(orcm_info_cmd_line, "metrics")) {
+        orcm_info_do_metrics(opal_cmd_line_get_param(orcm_info_cmd_line, "metrics", 0, 0));
+        acted = true;
+    }
     
     /* If no command line args are specified, show default set */
     
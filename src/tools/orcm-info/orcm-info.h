@@ -99,6 +99,8 @@ void orcm_info_do_arch(void);
 void orcm_info_do_hostname(void);
 void orcm_info_do_config(bool want_all);
 
+void orcm_info_do_metrics(const char *target);
+
 /*
  * Output-related functions
  */
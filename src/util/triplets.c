@@ -11,6 +11,11 @@
 #include "constants.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "opal/sys/atomic.h"
 
 #include "orte/threads/threads.h"
 #include "orte/util/name_fns.h"
@@ -19,106 +24,394 @@
 #include "runtime/orcm_globals.h"
 #include "util/triplets.h"
 
+static orcm_triplet_t* table_lookup(const char *stringid,
+                                    orcm_triplet_handle_t hash);
+static int table_insert(orcm_triplet_t *triplet);
+static int index_insert(orcm_triplet_t *triplet);
+static void add_group(orcm_triplet_t *trp, orcm_triplet_group_t *grp);
+
 orcm_triplet_t* orcm_get_triplet_process(const orte_process_name_t *name)
 {
-    int i, j;
-    orcm_triplet_t *triplet;
+    orcm_triplet_t *triplet=NULL;
     orcm_triplet_group_t *grp;
-
-    /* lock the global array for our use */
-    ORTE_ACQUIRE_THREAD(&orcm_triplets->ctl);
-
-    for (i=0; i < orcm_triplets->array.size; i++) {
-        if (NULL == (triplet = (orcm_triplet_t*)opal_pointer_array_get_item(&orcm_triplets->array, i))) {
-            continue;
-        }
-        for (j=0; j < triplet->groups.size; j++) {
-            if (NULL == (grp = (orcm_triplet_group_t*)opal_pointer_array_get_item(&triplet->groups, j))) {
-                continue;
-            }
-            if (grp->jobid == name->jobid) {
+    void *head;
+
+    /* find the groups for this job - usually just one */
+    OPAL_THREAD_LOCK(&orcm_triplets->jobs_lock);
+    if (OPAL_SUCCESS == opal_hash_table_get_value_uint32(&orcm_triplets->jobs,
+                                                         name->jobid, &head)) {
+        for (grp = (orcm_triplet_group_t*)head; NULL != grp; grp = grp->next_in_job) {
+            /* check the source for the given rank - if it is present, then
+             * this is the right triplet. If it isn't present, then this triplet
+             * isn't the right one
+             */
+            if (NULL != opal_pointer_array_get_item(&grp->members, name->vpid)) {
                 OPAL_OUTPUT_VERBOSE((2, orcm_debug_output,
                                      "%s pnp:default:get_triplet jobid match found",
                                      ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
-
-                /* check the source for the given rank - if it is present, then
-                 * this is the right triplet. If it isn't present, then this triplet
-                 * isn't the right one
-                 */
-                if (NULL == opal_pointer_array_get_item(&grp->members, name->vpid)) {
-                    /* nope - wrong triplet */
-                    break;
-                }
-                /* lock the triplet for use - the caller is responsible for
-                 * unlocking it!
-                 */
-                ORTE_ACQUIRE_THREAD(&triplet->ctl);
- 
-                /* release the global array */
-                ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
-                return triplet;
+                triplet = grp->triplet;
+                break;
             }
         }
     }
+    OPAL_THREAD_UNLOCK(&orcm_triplets->jobs_lock);
 
-    /* release the global array */
-    ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
-    return NULL;
+    if (NULL != triplet) {
+        /* lock the triplet for use - the caller is responsible for
+         * unlocking it! Triplets and their groups persist until
+         * finalize, so it is safe to do this after dropping the
+         * jobs lock
+         */
+        ORTE_ACQUIRE_THREAD(&triplet->ctl);
+    }
+    return triplet;
 }
 
 orcm_triplet_t* orcm_get_triplet_stringid(const char *stringid)
 {
-    int i;
     orcm_triplet_t *triplet;
-    opal_pointer_array_t *array;
 
-    /* lock the global array for our use */
-    ORTE_ACQUIRE_THREAD(&orcm_triplets->ctl);
+    if (NULL == (triplet = table_lookup(stringid, orcm_triplet_hash(stringid)))) {
+        return NULL;
+    }
+    OPAL_OUTPUT_VERBOSE((2, orcm_debug_output,
+                         "%s pnp:default:get_triplet_stringid match found",
+                         ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
 
-    /* if the string_id contains a wildcard, then we have to look
-     * in the wildcard array
+    /* lock the triplet for use - the caller is responsible for
+     * unlocking it!
      */
-    if (NULL != strchr(stringid, '@')) {
-        array = &orcm_triplets->wildcards;
-    } else {
-        array = &orcm_triplets->array;
+    ORTE_ACQUIRE_THREAD(&triplet->ctl);
+    return triplet;
+}
+
+orcm_triplet_t* orcm_get_triplet_handle(orcm_triplet_handle_t handle)
+{
+    orcm_triplet_table_t *table;
+    orcm_triplet_t *triplet;
+    uint32_t i;
+
+    if (NULL == (table = orcm_triplets->table)) {
+        return NULL;
     }
+    opal_atomic_rmb();
 
-    for (i=0; i < array->size; i++) {
-        if (NULL == (triplet = (orcm_triplet_t*)opal_pointer_array_get_item(array, i))) {
-            continue;
-        }
-        /* require an exact match */
-        if (0 == strcasecmp(stringid, triplet->string_id)) {
-            /* we have a match */
-            OPAL_OUTPUT_VERBOSE((2, orcm_debug_output,
-                                 "%s pnp:default:get_triplet_stringid match found",
-                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
+    /* any triplet with this handle sits in the run of slots
+     * starting at its home slot
+     */
+    for (i=handle & table->mask; NULL != (triplet = table->slots[i]); i=(i+1) & table->mask) {
+        if (handle == triplet->handle) {
             /* lock the triplet for use - the caller is responsible for
              * unlocking it!
              */
             ORTE_ACQUIRE_THREAD(&triplet->ctl);
- 
-            /* release the global array */
-            ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
             return triplet;
         }
     }
+    return NULL;
+}
 
-    /* release the global array */
-    ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
+orcm_triplet_handle_t orcm_triplet_hash(const char *stringid)
+{
+    const unsigned char *c;
+    uint32_t hash = 2166136261U;
+
+    /* FNV-1a */
+    for (c=(const unsigned char*)stringid; '\0' != *c; c++) {
+        hash ^= (uint32_t)tolower(*c);
+        hash *= 16777619U;
+    }
+    /* reserve the invalid value */
+    if (ORCM_TRIPLET_HANDLE_INVALID == hash) {
+        hash = 1;
+    }
+    return hash;
+}
+
+/* lookup a triplet in the registry - readers never lock the
+ * registry. Triplets are only added, and live until finalize, so
+ * anything found here stays valid
+ */
+static orcm_triplet_t* table_lookup(const char *stringid,
+                                    orcm_triplet_handle_t hash)
+{
+    orcm_triplet_table_t *table;
+    orcm_triplet_t *triplet;
+    uint32_t i;
+
+    if (NULL == (table = orcm_triplets->table)) {
+        return NULL;
+    }
+    opal_atomic_rmb();
+
+    for (i=hash & table->mask; NULL != (triplet = table->slots[i]); i=(i+1) & table->mask) {
+        /* require an exact match */
+        if (hash == triplet->handle && 0 == strcasecmp(stringid, triplet->string_id)) {
+            return triplet;
+        }
+    }
     return NULL;
 }
 
+/* put a triplet into a table that nobody else can see yet */
+static void table_place(orcm_triplet_table_t *table, orcm_triplet_t *triplet)
+{
+    uint32_t i;
+
+    for (i=triplet->handle & table->mask; NULL != table->slots[i]; i=(i+1) & table->mask);
+    table->slots[i] = triplet;
+    table->count++;
+}
+
+/* grow the registry table - the old table is retired rather than
+ * freed as readers may still be looking at it
+ */
+static int table_grow(void)
+{
+    orcm_triplet_table_t *table, *old;
+    uint32_t i;
+
+    old = orcm_triplets->table;
+    if (NULL == (table = (orcm_triplet_table_t*)malloc(sizeof(orcm_triplet_table_t)))) {
+        return ORCM_ERR_OUT_OF_RESOURCE;
+    }
+    table->size = (NULL == old) ? 64 : 2 * old->size;
+    table->mask = table->size - 1;
+    table->count = 0;
+    table->retired = old;
+    table->slots = (orcm_triplet_t**)calloc(table->size, sizeof(orcm_triplet_t*));
+    if (NULL == table->slots) {
+        free(table);
+        return ORCM_ERR_OUT_OF_RESOURCE;
+    }
+    if (NULL != old) {
+        for (i=0; i < old->size; i++) {
+            if (NULL != old->slots[i]) {
+                table_place(table, old->slots[i]);
+            }
+        }
+    }
+    /* make sure the table is complete before anyone can see it */
+    opal_atomic_wmb();
+    orcm_triplets->table = table;
+    return ORCM_SUCCESS;
+}
+
+/* enter a new triplet in the registry - the global
+ * array must be locked by the caller
+ */
+static int table_insert(orcm_triplet_t *triplet)
+{
+    orcm_triplet_table_t *table;
+    orcm_triplet_t *other;
+    uint32_t i;
+    int rc;
+
+    /* keep the load factor at or below 1/2 */
+    table = orcm_triplets->table;
+    if (NULL == table || table->size < 2 * (table->count + 1)) {
+        if (ORCM_SUCCESS != (rc = table_grow())) {
+            return rc;
+        }
+        table = orcm_triplets->table;
+    }
+
+    for (i=triplet->handle & table->mask; NULL != (other = table->slots[i]); i=(i+1) & table->mask) {
+        if (triplet->handle == other->handle) {
+            opal_output(0, "%s triplet %s has the same handle as triplet %s - msgs from "
+                        "either will be resolved by sender",
+                        ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                        triplet->string_id, other->string_id);
+            other->handle_shared = true;
+            triplet->handle_shared = true;
+        }
+    }
+    /* make sure the triplet is complete before anyone can see it */
+    opal_atomic_wmb();
+    table->slots[i] = triplet;
+    table->count++;
+    return ORCM_SUCCESS;
+}
+
+static orcm_triplet_node_t* node_new(const char *field, int32_t len, uint32_t hash)
+{
+    orcm_triplet_node_t *node;
+
+    if (NULL == (node = (orcm_triplet_node_t*)calloc(1, sizeof(orcm_triplet_node_t)))) {
+        return NULL;
+    }
+    if (NULL == (node->field = strndup(field, len))) {
+        free(node);
+        return NULL;
+    }
+    node->len = len;
+    node->hash = hash;
+    return node;
+}
+
+static void node_release(orcm_triplet_node_t *node)
+{
+    orcm_triplet_node_t *child, *next;
+    uint32_t hash;
+    void *ptr, *nd, *nxt;
+    int rc;
+
+    if (NULL != node->children) {
+        rc = opal_hash_table_get_first_key_uint32(node->children, &hash, &ptr, &nd);
+        while (OPAL_SUCCESS == rc) {
+            for (child = (orcm_triplet_node_t*)ptr; NULL != child; child = next) {
+                next = child->collision;
+                node_release(child);
+            }
+            rc = opal_hash_table_get_next_key_uint32(node->children, &hash, &ptr, nd, &nxt);
+            nd = nxt;
+        }
+        OBJ_RELEASE(node->children);
+    }
+    if (NULL != node->wild) {
+        node_release(node->wild);
+    }
+    if (NULL != node->field) {
+        free(node->field);
+    }
+    free(node);
+}
+
+/* find the child of a node for a non-wildcard field of a key */
+static orcm_triplet_node_t* node_child(orcm_triplet_node_t *node,
+                                       const orcm_triplet_key_t *key, int f)
+{
+    orcm_triplet_node_t *child;
+    void *ptr;
+
+    if (NULL == node->children ||
+        OPAL_SUCCESS != opal_hash_table_get_value_uint32(node->children, key->hash[f], &ptr)) {
+        return NULL;
+    }
+    for (child = (orcm_triplet_node_t*)ptr; NULL != child; child = child->collision) {
+        if (child->len == key->len[f] &&
+            0 == memcmp(child->field, key->str + key->off[f], key->len[f])) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+/* enter a new triplet in the field trie for its kind - the
+ * global array must be locked by the caller
+ */
+static int index_insert(orcm_triplet_t *triplet)
+{
+    orcm_triplet_node_t **root, *node, *child;
+    const orcm_triplet_key_t *key = &triplet->key;
+    void *ptr;
+    int f;
+
+    root = (0 != key->wildcards) ? &orcm_triplets->wildcard_index : &orcm_triplets->index;
+    if (NULL == *root && NULL == (*root = node_new("", 0, 0))) {
+        return ORCM_ERR_OUT_OF_RESOURCE;
+    }
+
+    node = *root;
+    for (f=0; f < ORCM_TRIPLET_NUM_FIELDS; f++) {
+        if (key->wildcards & (1 << f)) {
+            if (NULL == node->wild &&
+                NULL == (node->wild = node_new(key->str + key->off[f], key->len[f], 0))) {
+                return ORCM_ERR_OUT_OF_RESOURCE;
+            }
+            node = node->wild;
+            continue;
+        }
+        if (NULL == (child = node_child(node, key, f))) {
+            if (NULL == node->children) {
+                node->children = OBJ_NEW(opal_hash_table_t);
+                opal_hash_table_init(node->children, 8);
+            }
+            if (NULL == (child = node_new(key->str + key->off[f], key->len[f], key->hash[f]))) {
+                return ORCM_ERR_OUT_OF_RESOURCE;
+            }
+            /* chain it ahead of any sibling with the same hash */
+            if (OPAL_SUCCESS == opal_hash_table_get_value_uint32(node->children, child->hash, &ptr)) {
+                child->collision = (orcm_triplet_node_t*)ptr;
+            }
+            opal_hash_table_set_value_uint32(node->children, child->hash, child);
+        }
+        node = child;
+    }
+    node->triplet = triplet;
+    return ORCM_SUCCESS;
+}
+
+/* collect the leaves below a node that match the key from field f on */
+static void index_match(orcm_triplet_node_t *node, const orcm_triplet_key_t *key,
+                        int f, opal_pointer_array_t *matches)
+{
+    orcm_triplet_node_t *child;
+    uint32_t hash;
+    void *ptr, *nd, *nxt;
+    int rc;
+
+    if (ORCM_TRIPLET_NUM_FIELDS == f) {
+        if (NULL != node->triplet) {
+            opal_pointer_array_add(matches, node->triplet);
+        }
+        return;
+    }
+
+    if (key->wildcards & (1 << f)) {
+        /* a wildcard in the key spans every child */
+        if (NULL != node->children) {
+            rc = opal_hash_table_get_first_key_uint32(node->children, &hash, &ptr, &nd);
+            while (OPAL_SUCCESS == rc) {
+                for (child = (orcm_triplet_node_t*)ptr; NULL != child; child = child->collision) {
+                    index_match(child, key, f+1, matches);
+                }
+                rc = opal_hash_table_get_next_key_uint32(node->children, &hash, &ptr, nd, &nxt);
+                nd = nxt;
+            }
+        }
+    } else if (NULL != (child = node_child(node, key, f))) {
+        index_match(child, key, f+1, matches);
+    }
+
+    /* a wildcard in the trie spans whatever the key holds */
+    if (NULL != node->wild) {
+        index_match(node->wild, key, f+1, matches);
+    }
+}
+
+void orcm_triplet_get_matches(const orcm_triplet_key_t *key,
+                              bool wildcards,
+                              opal_pointer_array_t *matches)
+{
+    orcm_triplet_node_t *root;
+
+    root = wildcards ? orcm_triplets->wildcard_index : orcm_triplets->index;
+    if (NULL != root) {
+        index_match(root, key, 0, matches);
+    }
+}
+
+void orcm_triplet_release_index(orcm_triplets_array_t *triplets)
+{
+    if (NULL != triplets->index) {
+        node_release(triplets->index);
+        triplets->index = NULL;
+    }
+    if (NULL != triplets->wildcard_index) {
+        node_release(triplets->wildcard_index);
+        triplets->wildcard_index = NULL;
+    }
+}
+
 orcm_triplet_t* orcm_get_triplet(const char *app,
                                  const char *version,
                                  const char *release,
                                  bool create)
 {
-    int i;
     orcm_triplet_t *triplet;
     char *string_id;
-    opal_pointer_array_t *array;
+    orcm_triplet_handle_t hash;
 
     OPAL_OUTPUT_VERBOSE((2, orcm_debug_output,
                          "%s pnp:default:get_triplet app %s version %s release %s",
@@ -128,41 +421,43 @@ orcm_triplet_t* orcm_get_triplet(const char *app,
                          (NULL == release) ? "NULL" : release));
     
     ORCM_CREATE_STRING_ID(&string_id, app, version, release);
+    hash = orcm_triplet_hash(string_id);
 
-    /* lock the global array for our use */
-    ORTE_ACQUIRE_THREAD(&orcm_triplets->ctl);
-
-    /* if the string_id contains a wildcard, then we have to look
-     * in the wildcard array
-     */
-    if (NULL != strchr(string_id, '@')) {
-        array = &orcm_triplets->wildcards;
-    } else {
-        array = &orcm_triplets->array;
+    /* the triplet usually exists, so look without locking */
+    if (NULL != (triplet = table_lookup(string_id, hash)) || !create) {
+        goto process;
     }
 
-    for (i=0; i < array->size; i++) {
-        if (NULL == (triplet = (orcm_triplet_t*)opal_pointer_array_get_item(array, i))) {
-            continue;
-        }
-        /* require an exact match */
-        if (0 == strcasecmp(string_id, triplet->string_id)) {
-            /* we have a match */
-            OPAL_OUTPUT_VERBOSE((2, orcm_debug_output,
-                                 "%s pnp:default:get_triplet_stringid match found",
-                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
-            goto process;
-        }
-    }
+    /* lock the global array so only one thread creates it */
+    ORTE_ACQUIRE_THREAD(&orcm_triplets->ctl);
 
-    /* if we get here, then this triplet doesn't exist - create it if requested */
-    if (create) {
+    /* check that nobody beat us to it */
+    if (NULL == (triplet = table_lookup(string_id, hash))) {
         triplet = OBJ_NEW(orcm_triplet_t);
         triplet->string_id = strdup(string_id);
-        /* add it to the appropriate array */
-        opal_pointer_array_add(array, triplet);
+        orcm_triplet_key_init(&triplet->key, string_id);
+        triplet->handle = hash;
+        /* add it to the appropriate array - if the string_id contains
+         * a wildcard, then it goes in the wildcard array
+         */
+        if (NULL != strchr(string_id, '@')) {
+            opal_pointer_array_add(&orcm_triplets->wildcards, triplet);
+        } else {
+            opal_pointer_array_add(&orcm_triplets->array, triplet);
+        }
+        /* make it visible to lookups */
+        if (ORCM_SUCCESS != table_insert(triplet)) {
+            ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+        }
+        /* and to wildcard matching */
+        if (ORCM_SUCCESS != index_insert(triplet)) {
+            ORTE_ERROR_LOG(ORCM_ERR_OUT_OF_RESOURCE);
+        }
     }
-    
+
+    /* release the global array lock */
+    ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
+
  process:
     free(string_id);
 
@@ -173,9 +468,6 @@ orcm_triplet_t* orcm_get_triplet(const char *app,
         ORTE_ACQUIRE_THREAD(&triplet->ctl);
     }
 
-    /* release the global array lock */
-    ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
-
     OPAL_OUTPUT_VERBOSE((2, orcm_debug_output,
                          "%s pnp:default:get_triplet created triplet %s",
                          ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
@@ -213,14 +505,40 @@ orcm_triplet_group_t* orcm_get_triplet_group(orcm_triplet_t *trp,
 
     /* create the group */
     grp = OBJ_NEW(orcm_triplet_group_t);
-    grp->triplet = trp;
     grp->jobid = jobid;
-    opal_pointer_array_add(&trp->groups, grp);
+    add_group(trp, grp);
 
     /* the group is locked as part of the triplet */
     return grp;
 }
 
+static void add_group(orcm_triplet_t *trp, orcm_triplet_group_t *grp)
+{
+    orcm_triplet_group_t *last;
+    void *head;
+
+    grp->triplet = trp;
+    opal_pointer_array_add(&trp->groups, grp);
+
+    /* wildcard triplets are never returned by a process lookup */
+    if (0 != trp->key.wildcards) {
+        return;
+    }
+
+    /* append it to the chain for its job - groups are only
+     * released at finalize, so the chain never shrinks
+     */
+    OPAL_THREAD_LOCK(&orcm_triplets->jobs_lock);
+    if (OPAL_SUCCESS == opal_hash_table_get_value_uint32(&orcm_triplets->jobs,
+                                                         grp->jobid, &head)) {
+        for (last = (orcm_triplet_group_t*)head; NULL != last->next_in_job; last = last->next_in_job);
+        last->next_in_job = grp;
+    } else {
+        opal_hash_table_set_value_uint32(&orcm_triplets->jobs, grp->jobid, grp);
+    }
+    OPAL_THREAD_UNLOCK(&orcm_triplets->jobs_lock);
+}
+
 orcm_source_t* orcm_get_source_in_group(orcm_triplet_group_t *grp,
                                         const orte_vpid_t vpid,
                                         bool create)
@@ -314,7 +632,7 @@ orcm_source_t* orcm_get_source(orcm_triplet_t *triplet,
     grp->jobid = proc->jobid;
     grp->num_procs = proc->vpid+1;
     triplet->num_procs += grp->num_procs;
-    opal_pointer_array_add(&triplet->groups, grp);
+    add_group(triplet, grp);
     /* create the source */
     src = OBJ_NEW(orcm_source_t);
     src->name.jobid = proc->jobid;
@@ -329,114 +647,140 @@ orcm_source_t* orcm_get_source(orcm_triplet_t *triplet,
     return src;
 }
 
+/* is this span of a stringid a wildcard field? */
+#define ORCM_FIELD_IS_WILDCARD(p, l)   (1 == (l) && '@' == *(p))
+
 bool orcm_triplet_cmp(const char *str1, const char *str2)
 {
-    char *a1, *v1, *r1;
-    char *a2, *v2, *r2;
-    bool ret=false;
+    const char *p1=str1, *p2=str2;
+    const char *e1, *e2;
+    size_t l1, l2;
+    int f;
+
+    for (f=0; f < ORCM_TRIPLET_NUM_FIELDS; f++) {
+        /* the release is everything after the second separator */
+        if (f < ORCM_TRIPLET_NUM_FIELDS-1 && NULL != (e1 = strchr(p1, ':'))) {
+            l1 = e1 - p1;
+        } else {
+            l1 = strlen(p1);
+            e1 = p1 + l1;
+        }
+        if (f < ORCM_TRIPLET_NUM_FIELDS-1 && NULL != (e2 = strchr(p2, ':'))) {
+            l2 = e2 - p2;
+        } else {
+            l2 = strlen(p2);
+            e2 = p2 + l2;
+        }
+        /* we automatically match on a wildcard field */
+        if (!ORCM_FIELD_IS_WILDCARD(p1, l1) && !ORCM_FIELD_IS_WILDCARD(p2, l2)) {
+            if (l1 != l2 || 0 != strncasecmp(p1, p2, l1)) {
+                return false;
+            }
+        }
+        p1 = ('\0' == *e1) ? e1 : e1+1;
+        p2 = ('\0' == *e2) ? e2 : e2+1;
+    }
+    return true;
+}
 
-    ORCM_DECOMPOSE_STRING_ID(str1, a1, v1, r1);
-    ORCM_DECOMPOSE_STRING_ID(str2, a2, v2, r2);
+static char wildcard_str[] = ORCM_WILDCARD_STRING_ID;
+const orcm_triplet_key_t orcm_triplet_wildcard_key = {
+    wildcard_str,
+    {0, 2, 4},
+    {1, 1, 1},
+    {0, 0, 0},
+    0x07
+};
 
-    if (NULL == a1 || NULL == a2) {
-        /* we automatically match on this field */
-        goto check_version;
-    }
-    if (0 != strcasecmp(a1, a2)) {
-        ret = false;
-        goto cleanup;
-    }
-    
- check_version:
-    if (NULL == v1 || NULL == v2) {
-        /* we automatically match on this field */
-        goto check_release;
-    }
-    if (0 != strcasecmp(v1, v2)) {
-        ret = false;
-        goto cleanup;
-    }
-    
- check_release:
-    if (NULL == r1 || NULL == r2) {
-        /* we automatically match on this field */
-        ret = true;
-        goto cleanup;
-    }
-    if (0 == strcasecmp(r1, r2)) {
-        ret = true;
-        goto cleanup;
-    }
-    ret = false;
+int orcm_triplet_key_init(orcm_triplet_key_t *key, const char *stringid)
+{
+    char *c, *end;
+    uint32_t hash;
+    int f;
 
- cleanup:
-    if (NULL != a1) {
-        free(a1);
-    }
-    if (NULL != v1) {
-        free(v1);
+    orcm_triplet_key_release(key);
+    if (NULL == (key->str = strdup(stringid))) {
+        return ORCM_ERR_OUT_OF_RESOURCE;
     }
-    if (NULL != r1) {
-        free(r1);
-    }
-    if (NULL != a2) {
-        free(a2);
+    key->wildcards = 0;
+
+    c = key->str;
+    for (f=0; f < ORCM_TRIPLET_NUM_FIELDS; f++) {
+        /* the release is everything after the second separator */
+        if (f < ORCM_TRIPLET_NUM_FIELDS-1 && NULL != (end = strchr(c, ':'))) {
+            key->len[f] = end - c;
+        } else {
+            key->len[f] = strlen(c);
+            end = c + key->len[f];
+        }
+        key->off[f] = c - key->str;
+        if (ORCM_FIELD_IS_WILDCARD(c, key->len[f])) {
+            key->wildcards |= (1 << f);
+            key->hash[f] = 0;
+        } else {
+            /* FNV-1a over the folded field */
+            hash = 2166136261U;
+            for (; c < end; c++) {
+                *c = tolower(*c);
+                hash ^= (uint32_t)(unsigned char)*c;
+                hash *= 16777619U;
+            }
+            key->hash[f] = hash;
+        }
+        c = ('\0' == *end) ? end : end+1;
     }
-    if (NULL != v2) {
-        free(v2);
+    return ORCM_SUCCESS;
+}
+
+void orcm_triplet_key_release(orcm_triplet_key_t *key)
+{
+    if (NULL != key->str && wildcard_str != key->str) {
+        free(key->str);
     }
-    if (NULL != r2) {
-        free(r2);
+    key->str = NULL;
+    key->wildcards = 0;
+}
+
+bool orcm_triplet_key_cmp(const orcm_triplet_key_t *key1,
+                          const orcm_triplet_key_t *key2)
+{
+    int f;
+    uint8_t wild = key1->wildcards | key2->wildcards;
+
+    for (f=0; f < ORCM_TRIPLET_NUM_FIELDS; f++) {
+        /* we automatically match on a wildcard field */
+        if (wild & (1 << f)) {
+            continue;
+        }
+        if (key1->hash[f] != key2->hash[f] ||
+            key1->len[f] != key2->len[f] ||
+            0 != memcmp(key1->str + key1->off[f], key2->str + key2->off[f], key1->len[f])) {
+            return false;
+        }
     }
-    return ret;
+    return true;
 }
 
 int orcm_triplet_get_process(const char *app, const char *version,
                              const char *release, orte_process_name_t *name)
 {
-    int j;
+    int i, j;
     orcm_source_t *src;
     orcm_triplet_group_t *grp;
-    int i;
     orcm_triplet_t *triplet;
     char *string_id;
-    opal_pointer_array_t *array;
 
     ORCM_CREATE_STRING_ID(&string_id, app, version, release);
+    triplet = orcm_get_triplet_stringid(string_id);
+    free(string_id);
 
-    /* lock the global array for our use */
-    ORTE_ACQUIRE_THREAD(&orcm_triplets->ctl);
-
-    /* if the string_id contains a wildcard, then we have to look
-     * in the wildcard array
-     */
-    if (NULL != strchr(string_id, '@')) {
-        array = &orcm_triplets->wildcards;
-    } else {
-        array = &orcm_triplets->array;
-    }
-
-    for (i=0; i < array->size; i++) {
-        if (NULL == (triplet = (orcm_triplet_t*)opal_pointer_array_get_item(array, i))) {
-            continue;
-        }
-        /* require an exact match */
-        if (0 == strcasecmp(string_id, triplet->string_id)) {
-            /* we have a match */
-            OPAL_OUTPUT_VERBOSE((2, orcm_debug_output,
-                                 "%s pnp:default:get_triplet_stringid match found",
-                                 ORTE_NAME_PRINT(ORTE_PROC_MY_NAME)));
-            goto process;
-        }
+    if (NULL == triplet) {
+        /* get here if triplet not found */
+        name->jobid = ORTE_JOBID_INVALID;
+        name->vpid = ORTE_VPID_INVALID;
+        return ORTE_ERR_NOT_FOUND;
     }
-    /* get here if triplet not found */
-    name->jobid = ORTE_JOBID_INVALID;
-    name->vpid = ORTE_VPID_INVALID;
-    /* release the global array lock */
-    ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
-    return ORTE_ERR_NOT_FOUND;
 
- process:
     /* interate across the groups */
     for (i=0; i < triplet->groups.size; i++) {
         if (NULL == (grp = (orcm_triplet_group_t*)opal_pointer_array_get_item(&triplet->groups, i))) {
@@ -449,8 +793,8 @@ int orcm_triplet_get_process(const char *app, const char *version,
             }
             name->jobid = src->name.jobid;
             name->vpid = src->name.vpid;
-            /* release the global array lock */
-            ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
+            /* release the triplet */
+            ORTE_RELEASE_THREAD(&triplet->ctl);
             return ORCM_SUCCESS;
         }
     }
@@ -458,7 +802,7 @@ int orcm_triplet_get_process(const char *app, const char *version,
     /* get here if nothing is found */
     name->jobid = ORTE_JOBID_INVALID;
     name->vpid = ORTE_VPID_INVALID;
-    /* release the global array lock */
-    ORTE_RELEASE_THREAD(&orcm_triplets->ctl);
+    /* release the triplet */
+    ORTE_RELEASE_THREAD(&triplet->ctl);
     return ORTE_ERR_NOT_FOUND;
 }
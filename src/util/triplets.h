@@ -28,6 +28,20 @@ BEGIN_C_DECLS
  */
 ORCM_DECLSPEC orcm_triplet_t* orcm_get_triplet_stringid(const char *stringid);
 
+/* Lookup a triplet object using the compact handle carried on the
+ * wire. Returns NULL if no known triplet has that handle.
+ *
+ * NOTE: returned non-NULL triplet will have its thread-lock active. The
+ *       caller is responsible for releasing the thread when done!
+ */
+ORCM_DECLSPEC orcm_triplet_t* orcm_get_triplet_handle(orcm_triplet_handle_t handle);
+
+/* Compute the handle for a stringid. Every process derives the same
+ * handle for a given triplet, and the hash ignores case just like
+ * the stringid comparisons do
+ */
+ORCM_DECLSPEC orcm_triplet_handle_t orcm_triplet_hash(const char *stringid);
+
 /* Lookup a triplet object on the global array of known triplets
  * using the triplet. If the triplet isn't found, the function:
  *
@@ -93,6 +107,40 @@ ORCM_DECLSPEC orcm_source_t* orcm_get_source(orcm_triplet_t *triplet,
  */
 ORCM_DECLSPEC bool orcm_triplet_cmp(const char *stringid1, const char *stringid2);
 
+/* Parse a stringid into a key. The key must either be zeroed or
+ * have been initialized before - any storage it already holds is
+ * released first
+ */
+ORCM_DECLSPEC int orcm_triplet_key_init(orcm_triplet_key_t *key, const char *stringid);
+
+/* Release the storage held by a key */
+ORCM_DECLSPEC void orcm_triplet_key_release(orcm_triplet_key_t *key);
+
+/* Compare two keys, properly accounting for any wildcard fields.
+ * Return true if they match and false if they don't
+ */
+ORCM_DECLSPEC bool orcm_triplet_key_cmp(const orcm_triplet_key_t *key1,
+                                        const orcm_triplet_key_t *key2);
+
+/* Collect the known triplets whose keys match the given key into
+ * the matches array. If wildcards is true, only triplets containing
+ * a wildcard field are considered - otherwise only those without one.
+ * Costs time in proportion to the number of matches, not the number
+ * of known triplets.
+ *
+ * NOTE: the caller must hold the global triplet array lock. The
+ *       matches are not locked
+ */
+ORCM_DECLSPEC void orcm_triplet_get_matches(const orcm_triplet_key_t *key,
+                                            bool wildcards,
+                                            opal_pointer_array_t *matches);
+
+/* Release the field tries - only called at finalize */
+ORCM_DECLSPEC void orcm_triplet_release_index(orcm_triplets_array_t *triplets);
+
+/* key for the all-wildcard stringid */
+ORCM_DECLSPEC extern const orcm_triplet_key_t orcm_triplet_wildcard_key;
+
 ORCM_DECLSPEC int orcm_triplet_get_process(const char *app, const char *version,
                                            const char *release, orte_process_name_t *name);
 
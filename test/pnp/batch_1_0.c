@@ -0,0 +1,123 @@
+/* -*- C -*-
+ *
+ * $HEADER$
+ *
+ * Rank 0 sends bursts of small numbered msgs with output_batch - the
+ * other ranks check they are delivered one at a time and in order
+ */
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "opal/dss/dss.h"
+#include "opal/mca/event/event.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "runtime/runtime.h"
+
+#define BATCH_BURST_SIZE    1000
+
+static void recv_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata);
+static void send_data(int fd, short flags, void *arg);
+
+static int32_t counter=0;
+static int32_t num_recvd=0;
+
+int main(int argc, char* argv[])
+{
+    int rc;
+    
+    if (ORCM_SUCCESS != (rc = orcm_init(ORCM_APP))) {
+        fprintf(stderr, "Failed to init: error %d\n", rc);
+        exit(1);
+    }
+    
+    if (ORCM_SUCCESS != (rc = orcm_pnp.register_receive("BATCH", "1.0", "alpha",
+                                                        ORCM_PNP_GROUP_OUTPUT_CHANNEL,
+                                                        ORCM_PNP_TAG_OUTPUT, recv_input, NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (rc = orcm_pnp.announce("BATCH", "1.0", "alpha", NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    
+    if (0 == ORTE_PROC_MY_NAME->vpid) {
+        ORTE_TIMER_EVENT(1, 0, send_data);
+    }
+    opal_event_dispatch(opal_event_base);
+
+cleanup:
+    orcm_finalize();
+    return rc;
+}
+
+static void send_data(int fd, short flags, void *arg)
+{
+    opal_buffer_t buf;
+    int rc, j;
+    opal_event_t *tmp = (opal_event_t*)arg;
+    struct timeval now;
+
+    /* each msg is copied into the frame, so the buffer
+     * can be reused as soon as output_batch returns
+     */
+    for (j=0; j < BATCH_BURST_SIZE; j++) {
+        OBJ_CONSTRUCT(&buf, opal_buffer_t);
+        opal_dss.pack(&buf, &counter, 1, OPAL_INT32);
+        if (ORCM_SUCCESS != (rc = orcm_pnp.output_batch(ORCM_PNP_GROUP_OUTPUT_CHANNEL, NULL,
+                                                        ORCM_PNP_TAG_OUTPUT, NULL, 0, &buf,
+                                                        NULL, NULL))) {
+            ORTE_ERROR_LOG(rc);
+        }
+        OBJ_DESTRUCT(&buf);
+        counter++;
+    }
+    /* push out the partial frame rather than wait for the timeout */
+    if (ORCM_SUCCESS != (rc = orcm_pnp.flush(ORCM_PNP_GROUP_OUTPUT_CHANNEL))) {
+        ORTE_ERROR_LOG(rc);
+    }
+    
+    now.tv_sec = 1;
+    now.tv_usec = 0;
+    opal_event_evtimer_add(tmp, &now);
+}
+
+static void recv_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata)
+{
+    int32_t n=1, val;
+    int rc;
+    
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &val, &n, OPAL_INT32))) {
+        ORTE_ERROR_LOG(rc);
+        return;
+    }
+    /* we may have started part way through */
+    if (0 < num_recvd && val != counter) {
+        opal_output(0, "%s msg %d out of sequence - expected %d",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), val, counter);
+    }
+    counter = val + 1;
+    if (0 == (++num_recvd % BATCH_BURST_SIZE)) {
+        opal_output(0, "%s recvd %d batched msgs",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), num_recvd);
+    }
+}
@@ -0,0 +1,151 @@
+/* -*- C -*-
+ *
+ * $HEADER$
+ *
+ * Rank 0 sends buffers that compress well alternating with ones that
+ * do not - the other ranks check the payloads arrive intact. Run with
+ * pnp_base_compress_threshold set (e.g., to 1024)
+ */
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "opal/dss/dss.h"
+#include "opal/mca/event/event.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "runtime/runtime.h"
+
+#define COMPRESS_MSG_SIZE   (32 * 1024)
+
+static void recv_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata);
+static void send_data(int fd, short flags, void *arg);
+static void report(void);
+
+static int32_t counter=0;
+static uint8_t data[COMPRESS_MSG_SIZE];
+
+int main(int argc, char* argv[])
+{
+    int rc;
+    
+    if (ORCM_SUCCESS != (rc = orcm_init(ORCM_APP))) {
+        fprintf(stderr, "Failed to init: error %d\n", rc);
+        exit(1);
+    }
+    
+    if (ORCM_SUCCESS != (rc = orcm_pnp.register_receive("COMPRESS", "1.0", "alpha",
+                                                        ORCM_PNP_GROUP_OUTPUT_CHANNEL,
+                                                        ORCM_PNP_TAG_OUTPUT, recv_input, NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (rc = orcm_pnp.announce("COMPRESS", "1.0", "alpha", NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    
+    if (0 == ORTE_PROC_MY_NAME->vpid) {
+        ORTE_TIMER_EVENT(1, 0, send_data);
+    }
+    opal_event_dispatch(opal_event_base);
+
+cleanup:
+    orcm_finalize();
+    return rc;
+}
+
+static void cbfunc(int status, orte_process_name_t *name,
+                   orcm_pnp_tag_t tag,
+                   struct iovec *msg, int count,
+                   opal_buffer_t *buf, void *cbdata)
+{
+    OBJ_RELEASE(buf);
+}
+
+static void send_data(int fd, short flags, void *arg)
+{
+    opal_buffer_t *buf;
+    int rc, j;
+    opal_event_t *tmp = (opal_event_t*)arg;
+    struct timeval now;
+
+    /* even msgs repeat a short pattern, odd ones are noise */
+    for (j=0; j < COMPRESS_MSG_SIZE; j++) {
+        data[j] = (0 == (counter % 2)) ? (uint8_t)(j % 16) : (uint8_t)rand();
+    }
+    buf = OBJ_NEW(opal_buffer_t);
+    opal_dss.pack(buf, &counter, 1, OPAL_INT32);
+    opal_dss.pack(buf, data, COMPRESS_MSG_SIZE, OPAL_UINT8);
+    if (ORCM_SUCCESS != (rc = orcm_pnp.output_nb(ORCM_PNP_GROUP_OUTPUT_CHANNEL, NULL,
+                                                 ORCM_PNP_TAG_OUTPUT, NULL, 0, buf, cbfunc, NULL))) {
+        ORTE_ERROR_LOG(rc);
+        OBJ_RELEASE(buf);
+    }
+    if (0 == (++counter % 10)) {
+        report();
+    }
+    
+    now.tv_sec = 1;
+    now.tv_usec = 0;
+    opal_event_evtimer_add(tmp, &now);
+}
+
+static void recv_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata)
+{
+    int32_t n, num;
+    int rc, j;
+    
+    n = 1;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, &num, &n, OPAL_INT32))) {
+        ORTE_ERROR_LOG(rc);
+        return;
+    }
+    n = COMPRESS_MSG_SIZE;
+    if (ORCM_SUCCESS != (rc = opal_dss.unpack(buf, data, &n, OPAL_UINT8)) ||
+        COMPRESS_MSG_SIZE != n) {
+        opal_output(0, "%s msg %d truncated to %d bytes",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), num, n);
+        return;
+    }
+    /* only the even msgs carry a pattern we can check */
+    for (j=0; 0 == (num % 2) && j < COMPRESS_MSG_SIZE; j++) {
+        if (data[j] != (uint8_t)(j % 16)) {
+            opal_output(0, "%s msg %d corrupt at byte %d",
+                        ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), num, j);
+            break;
+        }
+    }
+    if (0 == (++counter % 10)) {
+        report();
+    }
+}
+
+static void report(void)
+{
+    orcm_pnp_compress_stats_t stats;
+
+    orcm_pnp_get_compress_stats(&stats);
+    opal_output(0, "%s compressed %ld msgs from %ld to %ld bytes, skipped %ld, decompressed %ld",
+                ORTE_NAME_PRINT(ORTE_PROC_MY_NAME),
+                (long)stats.msgs_compressed, (long)stats.bytes_in,
+                (long)stats.bytes_out, (long)stats.msgs_skipped,
+                (long)stats.msgs_decompressed);
+}
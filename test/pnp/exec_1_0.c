@@ -0,0 +1,127 @@
+/* -*- C -*-
+ *
+ * $HEADER$
+ *
+ * Consumes the output of talker twice over - slowly on an executor
+ * and quickly inline - reporting how the fast consumer keeps up while
+ * msgs back up on the executor. Pass "pool" to run the slow consumer
+ * on the shared pool instead of a thread of its own
+ */
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "opal/mca/event/event.h"
+#include "opal/sys/atomic.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "runtime/runtime.h"
+
+static void slow_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata);
+static void fast_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata);
+static void report(int fd, short flags, void *arg);
+
+static volatile int32_t num_slow=0;
+static int32_t num_fast=0;
+
+int main(int argc, char* argv[])
+{
+    orcm_pnp_exec_t exec=ORCM_PNP_EXEC_SERIAL;
+    int rc;
+    
+    if (1 < argc && 0 == strcmp(argv[1], "pool")) {
+        exec = ORCM_PNP_EXEC_POOL;
+    }
+
+    if (ORCM_SUCCESS != (rc = orcm_init(ORCM_APP))) {
+        fprintf(stderr, "Failed to init: error %d\n", rc);
+        exit(1);
+    }
+    
+    if (ORCM_SUCCESS != (rc = orcm_pnp.announce("EXEC", "1.0", "alpha", NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (rc = orcm_pnp.register_receive_exec("TALKER", "1.0", "alpha",
+                                                             ORCM_PNP_GROUP_OUTPUT_CHANNEL,
+                                                             ORCM_PNP_TAG_OUTPUT, exec,
+                                                             slow_input, NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (rc = orcm_pnp.register_receive("TALKER", "1.0", "alpha",
+                                                        ORCM_PNP_GROUP_OUTPUT_CHANNEL,
+                                                        ORCM_PNP_TAG_WILDCARD, fast_input, NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    
+    ORTE_TIMER_EVENT(5, 0, report);
+    opal_event_dispatch(opal_event_base);
+
+cleanup:
+    orcm_finalize();
+    return rc;
+}
+
+static void slow_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata)
+{
+    /* stand in for a callback that blocks on something */
+    sleep(3);
+    opal_atomic_add_32(&num_slow, 1);
+}
+
+static void fast_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata)
+{
+    num_fast++;
+}
+
+static void report(int fd, short flags, void *arg)
+{
+    orcm_pnp_metrics_t *metrics=NULL;
+    int32_t num, depth, max_depth, exec_depth, exec_max_depth;
+    opal_event_t *tmp = (opal_event_t*)arg;
+    struct timeval now;
+
+    orcm_pnp_get_metrics(&metrics, &num, &depth, &max_depth,
+                         &exec_depth, &exec_max_depth);
+    if (NULL != metrics) {
+        free(metrics);
+    }
+    opal_output(0, "%s consumed %d fast and %d slow - %d waiting on the executor",
+                ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), (int)num_fast,
+                (int)num_slow, (int)exec_depth);
+
+    now.tv_sec = 5;
+    now.tv_usec = 0;
+    opal_event_evtimer_add(tmp, &now);
+}
@@ -0,0 +1,107 @@
+/* -*- C -*-
+ *
+ * $HEADER$
+ *
+ * Consumes the output of talker from the app's own event loop
+ * instead of a pnp recv thread. Run with pnp_base_recv_progress set
+ */
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "opal/mca/event/event.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "runtime/runtime.h"
+
+static void recv_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata);
+static void drive_pnp(int fd, short flags, void *arg);
+static void find_fd(int fd, short flags, void *arg);
+
+static int num_recvd=0;
+static opal_event_t pnp_ev;
+
+int main(int argc, char* argv[])
+{
+    int rc;
+    
+    if (ORCM_SUCCESS != (rc = orcm_init(ORCM_APP))) {
+        fprintf(stderr, "Failed to init: error %d\n", rc);
+        exit(1);
+    }
+    
+    if (ORCM_ERR_NOT_SUPPORTED == orcm_pnp.progress(0)) {
+        fprintf(stderr, "Run with pnp_base_recv_progress set\n");
+        rc = ORCM_ERR_NOT_SUPPORTED;
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (rc = orcm_pnp.announce("PROGRESS", "1.0", "alpha", NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (rc = orcm_pnp.register_receive("TALKER", "1.0", "alpha",
+                                                        ORCM_PNP_GROUP_OUTPUT_CHANNEL,
+                                                        ORCM_PNP_TAG_OUTPUT, recv_input, NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    
+    find_fd(0, 0, NULL);
+    opal_event_dispatch(opal_event_base);
+
+cleanup:
+    orcm_finalize();
+    return rc;
+}
+
+static void find_fd(int fd, short flags, void *arg)
+{
+    int pnp_fd;
+
+    drive_pnp(0, 0, NULL);
+
+    /* there is no fd until pnp is ready to recv */
+    if (0 > (pnp_fd = orcm_pnp.get_fd())) {
+        ORTE_TIMER_EVENT(0, 10000, find_fd);
+        return;
+    }
+    opal_event_set(opal_event_base, &pnp_ev, pnp_fd,
+                   OPAL_EV_READ|OPAL_EV_PERSIST, drive_pnp, NULL);
+    opal_event_add(&pnp_ev, 0);
+}
+
+static void drive_pnp(int fd, short flags, void *arg)
+{
+    int n;
+
+    /* the fd is only certain to wake us again once nothing is left */
+    while (0 < (n = orcm_pnp.progress(0))) {
+        continue;
+    }
+    if (0 > n) {
+        ORTE_ERROR_LOG(n);
+    }
+}
+
+static void recv_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata)
+{
+    opal_output(0, "%s recvd msg %d from %s",
+                ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), ++num_recvd,
+                ORTE_NAME_PRINT(sender));
+}
@@ -0,0 +1,101 @@
+/* -*- C -*-
+ *
+ * $HEADER$
+ *
+ * Sends windows of msgs with output_req, waiting for each window to
+ * complete before sending the next. The waits would block the event
+ * library, so the sends are made from a thread of their own
+ */
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "opal/dss/dss.h"
+#include "opal/mca/event/event.h"
+#include "opal/threads/threads.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "runtime/runtime.h"
+
+#define REQ_WINDOW  16
+
+static void* send_data(opal_object_t *obj);
+
+static opal_thread_t sender;
+
+int main(int argc, char* argv[])
+{
+    int rc;
+    
+    if (ORCM_SUCCESS != (rc = orcm_init(ORCM_APP))) {
+        fprintf(stderr, "Failed to init: error %d\n", rc);
+        exit(1);
+    }
+    
+    if (ORCM_SUCCESS != (rc = orcm_pnp.announce("REQ", "1.0", "alpha", NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    
+    OBJ_CONSTRUCT(&sender, opal_thread_t);
+    sender.t_run = send_data;
+    if (ORTE_SUCCESS != (rc = opal_thread_start(&sender))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    opal_event_dispatch(opal_event_base);
+
+cleanup:
+    orcm_finalize();
+    return rc;
+}
+
+static void* send_data(opal_object_t *obj)
+{
+    opal_buffer_t bufs[REQ_WINDOW];
+    orcm_pnp_send_req_t *reqs[REQ_WINDOW];
+    int32_t counter=0;
+    int rc, i, idx;
+
+    while (!orte_abnormal_term_ordered) {
+        /* each buffer has to be left alone until its request completes */
+        for (i=0; i < REQ_WINDOW; i++) {
+            OBJ_CONSTRUCT(&bufs[i], opal_buffer_t);
+            opal_dss.pack(&bufs[i], &counter, 1, OPAL_INT32);
+            reqs[i] = NULL;
+            if (ORCM_SUCCESS != (rc = orcm_pnp.output_req(ORCM_PNP_GROUP_OUTPUT_CHANNEL, NULL,
+                                                          ORCM_PNP_TAG_OUTPUT, NULL, 0,
+                                                          &bufs[i], &reqs[i]))) {
+                ORTE_ERROR_LOG(rc);
+            }
+            counter++;
+        }
+
+        if (ORCM_SUCCESS != (rc = orcm_pnp_wait_any(REQ_WINDOW, reqs, &idx))) {
+            ORTE_ERROR_LOG(rc);
+        }
+        if (ORCM_SUCCESS != (rc = orcm_pnp_wait_all(REQ_WINDOW, reqs))) {
+            ORTE_ERROR_LOG(rc);
+        }
+        /* the waits release every request they report */
+        for (i=0; i < REQ_WINDOW; i++) {
+            if (NULL != reqs[i]) {
+                opal_output(0, "%s request %d was not released",
+                            ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), i);
+            }
+            OBJ_DESTRUCT(&bufs[i]);
+        }
+        opal_output(0, "%s completed sends through msg %d - msg %d finished first",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), counter - 1,
+                    counter - REQ_WINDOW + idx);
+        sleep(1);
+    }
+    return NULL;
+}
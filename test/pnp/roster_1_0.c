@@ -0,0 +1,78 @@
+/* -*- C -*-
+ *
+ * $HEADER$
+ *
+ * Reports how long it takes to hear of every other rank in the job.
+ * Start many with pnp_base_announce_roster set - each newcomer should
+ * learn of its peers from one roster instead of a reply per peer
+ */
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "opal/mca/event/event.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/util/proc_info.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "runtime/runtime.h"
+
+static void responses(orcm_info_t *info);
+
+static bool *heard=NULL;
+static orte_vpid_t num_heard=0;
+static int num_callbacks=0;
+static struct timeval starttime;
+
+int main(int argc, char* argv[])
+{
+    int rc;
+    
+    if (ORCM_SUCCESS != (rc = orcm_init(ORCM_APP))) {
+        fprintf(stderr, "Failed to init: error %d\n", rc);
+        exit(1);
+    }
+    
+    heard = (bool*)calloc(orte_process_info.num_procs, sizeof(bool));
+    gettimeofday(&starttime, NULL);
+    if (ORCM_SUCCESS != (rc = orcm_pnp.announce("ROSTER", "1.0", "alpha", responses))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    opal_event_dispatch(opal_event_base);
+
+cleanup:
+    free(heard);
+    orcm_finalize();
+    return rc;
+}
+
+static void responses(orcm_info_t *info)
+{
+    struct timeval now;
+    long secs, usecs;
+
+    num_callbacks++;
+    if (info->name->jobid != ORTE_PROC_MY_NAME->jobid ||
+        info->name->vpid == ORTE_PROC_MY_NAME->vpid ||
+        orte_process_info.num_procs <= info->name->vpid ||
+        heard[info->name->vpid]) {
+        return;
+    }
+    heard[info->name->vpid] = true;
+
+    if (++num_heard == orte_process_info.num_procs - 1) {
+        gettimeofday(&now, NULL);
+        ORTE_COMPUTE_TIME_DIFF(secs, usecs, starttime.tv_sec, starttime.tv_usec,
+                               now.tv_sec, now.tv_usec);
+        opal_output(0, "%s heard from all %d peers in %ld.%06ld secs through %d callbacks",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), (int)num_heard,
+                    secs, usecs, num_callbacks);
+    }
+}
@@ -0,0 +1,162 @@
+/* -*- C -*-
+ *
+ * $HEADER$
+ *
+ * Rank 0 sends bursts of numbered direct msgs to rank 1 on the same
+ * node, every tenth one larger than the shared memory ring - rank 1
+ * checks they arrive in order and acks each burst. Run two of them
+ * with pnp_base_shm set
+ */
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "opal/mca/event/event.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "runtime/runtime.h"
+
+#define SHM_TEST_TAG        111
+#define SHM_BURST_SIZE      100
+#define SHM_MSG_SIZE        100
+#define SHM_LARGE_SIZE      (4 * 1024 * 1024)
+
+static void signal_trap(int signal, short flags, void *arg)
+{
+    /* finalize so the shared memory is cleaned up */
+    orte_abnormal_term_ordered = true;
+    ORTE_UPDATE_EXIT_STATUS(128+signal);
+    ORTE_TIMER_EVENT(0, 0, orcm_just_quit);
+}
+
+static void recv_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata);
+static void send_data(int fd, short flags, void *arg);
+
+static int32_t counter=0;
+static int num_recvd=0;
+static int num_bursts=0;
+static opal_event_t sigterm_handler, sigint_handler;
+
+int main(int argc, char* argv[])
+{
+    int rc;
+
+    if (ORCM_SUCCESS != (rc = orcm_init(ORCM_APP))) {
+        fprintf(stderr, "Failed to init: error %d\n", rc);
+        exit(1);
+    }
+    
+    opal_event_signal_set(opal_event_base, &sigterm_handler, SIGTERM,
+                          signal_trap, &sigterm_handler);
+    opal_event_signal_add(&sigterm_handler, NULL);
+    opal_event_signal_set(opal_event_base, &sigint_handler, SIGINT,
+                          signal_trap, &sigint_handler);
+    opal_event_signal_add(&sigint_handler, NULL);
+
+    if (ORCM_SUCCESS != (rc = orcm_pnp.register_receive("SHM", "1.0", "alpha",
+                                                        ORCM_PNP_GROUP_INPUT_CHANNEL,
+                                                        SHM_TEST_TAG, recv_input, NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (rc = orcm_pnp.announce("SHM", "1.0", "alpha", NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    
+    /* give rank 1 time to come up - after the first burst,
+     * each one is driven by the ack of the one before
+     */
+    if (0 == ORTE_PROC_MY_NAME->vpid) {
+        ORTE_TIMER_EVENT(2, 0, send_data);
+    }
+    opal_event_dispatch(opal_event_base);
+    
+ cleanup:
+    orcm_finalize();
+    return rc;
+}
+
+static void cbfunc(int status, orte_process_name_t *name,
+                   orcm_pnp_tag_t tag,
+                   struct iovec *msg, int count,
+                   opal_buffer_t *buf, void *cbdata)
+{
+    if (ORCM_SUCCESS != status) {
+        ORTE_ERROR_LOG(status);
+    }
+    free(msg->iov_base);
+    free(msg);
+}
+
+static void send_msg(orte_process_name_t *peer, size_t len, int32_t num)
+{
+    struct iovec *msg;
+    int rc;
+
+    msg = (struct iovec*)malloc(sizeof(struct iovec));
+    msg->iov_len = len;
+    msg->iov_base = (void*)calloc(1, len);
+    memcpy(msg->iov_base, &num, sizeof(int32_t));
+    if (ORCM_SUCCESS != (rc = orcm_pnp.output_nb(ORCM_PNP_GROUP_INPUT_CHANNEL, peer,
+                                                 SHM_TEST_TAG, msg, 1, NULL, cbfunc, NULL))) {
+        ORTE_ERROR_LOG(rc);
+    }
+}
+
+static void send_data(int fd, short flags, void *arg)
+{
+    orte_process_name_t peer;
+    int i;
+
+    peer.jobid = ORTE_PROC_MY_NAME->jobid;
+    peer.vpid = 1;
+    for (i=0; i < SHM_BURST_SIZE; i++) {
+        send_msg(&peer, (9 == (counter % 10)) ? SHM_LARGE_SIZE : SHM_MSG_SIZE, counter);
+        counter++;
+    }
+}
+
+static void recv_input(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       struct iovec *msg, int count,
+                       opal_buffer_t *buf,
+                       void *cbdata)
+{
+    int32_t num;
+    
+    if (0 == ORTE_PROC_MY_NAME->vpid) {
+        /* an ack - send the next burst */
+        send_data(0, 0, NULL);
+        return;
+    }
+
+    memcpy(&num, msg[0].iov_base, sizeof(int32_t));
+    if (num != counter) {
+        opal_output(0, "%s msg %d out of order - expected %d",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), num, counter);
+    }
+    counter = num + 1;
+    if (SHM_BURST_SIZE == ++num_recvd) {
+        if (0 == (++num_bursts % 100)) {
+            opal_output(0, "%s recvd %d bursts in order",
+                        ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), num_bursts);
+        }
+        send_msg(sender, sizeof(int32_t), num_bursts);
+        num_recvd = 0;
+    }
+}
@@ -0,0 +1,162 @@
+/* -*- C -*-
+ *
+ * $HEADER$
+ *
+ * Rank 0 sends msgs far larger than a multicast frame with
+ * output_stream - the other ranks take them piece by piece with
+ * register_stream and check each piece as it arrives
+ */
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "opal/mca/event/event.h"
+#include "opal/util/output.h"
+
+#include "orte/mca/errmgr/errmgr.h"
+#include "orte/util/name_fns.h"
+#include "orte/runtime/orte_globals.h"
+
+#include "mca/pnp/pnp.h"
+#include "runtime/runtime.h"
+
+#define STREAM_MSG_SIZE     (4 * 1024 * 1024)
+
+static void recv_piece(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       uint32_t stream,
+                       int64_t offset,
+                       int64_t total,
+                       uint8_t *data,
+                       size_t len,
+                       bool last,
+                       void *cbdata);
+static void send_data(int fd, short flags, void *arg);
+
+static uint8_t counter=0;
+static bool busy=false;
+static int64_t next_offset=0;
+static bool corrupt=false;
+
+int main(int argc, char* argv[])
+{
+    int rc;
+    
+    if (ORCM_SUCCESS != (rc = orcm_init(ORCM_APP))) {
+        fprintf(stderr, "Failed to init: error %d\n", rc);
+        exit(1);
+    }
+    
+    if (ORCM_SUCCESS != (rc = orcm_pnp.register_stream("STREAM", "1.0", "alpha",
+                                                       ORCM_PNP_GROUP_OUTPUT_CHANNEL,
+                                                       ORCM_PNP_TAG_OUTPUT, recv_piece, NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    if (ORCM_SUCCESS != (rc = orcm_pnp.announce("STREAM", "1.0", "alpha", NULL))) {
+        ORTE_ERROR_LOG(rc);
+        goto cleanup;
+    }
+    
+    if (0 == ORTE_PROC_MY_NAME->vpid) {
+        ORTE_TIMER_EVENT(1, 0, send_data);
+    }
+    opal_event_dispatch(opal_event_base);
+
+cleanup:
+    orcm_finalize();
+    return rc;
+}
+
+static void cbfunc(int status, orte_process_name_t *name,
+                   orcm_pnp_tag_t tag,
+                   struct iovec *msg, int count,
+                   opal_buffer_t *buf, void *cbdata)
+{
+    if (ORCM_SUCCESS != status) {
+        ORTE_ERROR_LOG(status);
+    }
+    free(msg->iov_base);
+    free(msg);
+    busy = false;
+}
+
+static void send_data(int fd, short flags, void *arg)
+{
+    struct iovec *msg;
+    uint8_t *data;
+    size_t j;
+    int rc;
+    opal_event_t *tmp = (opal_event_t*)arg;
+    struct timeval now;
+
+    /* the msg has to be left alone until its last fragment has gone */
+    if (!busy) {
+        data = (uint8_t*)malloc(STREAM_MSG_SIZE);
+        for (j=0; j < STREAM_MSG_SIZE; j++) {
+            data[j] = (uint8_t)(j + counter);
+        }
+        msg = (struct iovec*)malloc(sizeof(struct iovec));
+        msg->iov_base = (void*)data;
+        msg->iov_len = STREAM_MSG_SIZE;
+        busy = true;
+        if (ORCM_SUCCESS != (rc = orcm_pnp.output_stream(ORCM_PNP_GROUP_OUTPUT_CHANNEL, NULL,
+                                                         ORCM_PNP_TAG_OUTPUT, msg, 1, NULL,
+                                                         cbfunc, NULL))) {
+            ORTE_ERROR_LOG(rc);
+        }
+        counter++;
+    }
+
+    now.tv_sec = 2;
+    now.tv_usec = 0;
+    opal_event_evtimer_add(tmp, &now);
+}
+
+static void recv_piece(int status,
+                       orte_process_name_t *sender,
+                       orcm_pnp_tag_t tag,
+                       uint32_t stream,
+                       int64_t offset,
+                       int64_t total,
+                       uint8_t *data,
+                       size_t len,
+                       bool last,
+                       void *cbdata)
+{
+    size_t j;
+    
+    if (ORCM_SUCCESS != status) {
+        ORTE_ERROR_LOG(status);
+        next_offset = 0;
+        corrupt = false;
+        return;
+    }
+    
+    /* every byte holds (index + msg number), so the first
+     * byte of a msg tells us its number
+     */
+    if (0 == offset && 0 < len) {
+        counter = data[0];
+    }
+    if (offset != next_offset) {
+        corrupt = true;
+    }
+    for (j=0; j < len && !corrupt; j++) {
+        if (data[j] != (uint8_t)(offset + j + counter)) {
+            corrupt = true;
+        }
+    }
+    next_offset = offset + len;
+    
+    if (last) {
+        opal_output(0, "%s recvd stream %u of %ld bytes%s",
+                    ORTE_NAME_PRINT(ORTE_PROC_MY_NAME), stream, (long)total,
+                    corrupt ? " - CORRUPT" : "");
+        next_offset = 0;
+        corrupt = false;
+    }
+}